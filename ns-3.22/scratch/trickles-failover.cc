@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Server failover on retransmission timeout.
+ *
+ * Network topology:
+ *
+ *                    +--- Server 0 (primary)
+ *   Client --- Router
+ *                    +--- Server 1..R-1 (replicas)
+ *
+ * The client fetches from server 0 and knows the other servers as
+ * replicas (TricklesSink::AddReplica). At --fail seconds server 0 dies:
+ * every packet on its link is dropped from then on. After --failover
+ * consecutive retransmission timeouts the client re-targets its requests
+ * to the next replica with the same continuation.
+ *
+ * Prints the failover times, the recovery gap (from the last continuation
+ * of the dead server to the first one of the replica) and the goodput
+ * before and after the failure.
+ */
+
+#include <iostream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesFailover");
+
+static Ptr<TricklesSink> g_sink;
+static uint64_t g_rxAtFail = 0;
+
+static void
+Failover (const Address &replica)
+{
+    std::cout << Simulator::Now ().GetSeconds () << " s: failover to " << InetSocketAddress::ConvertFrom (replica).GetIpv4 () << std::endl;
+}
+
+static void
+RecoveryGap (Time gap)
+{
+    std::cout << Simulator::Now ().GetSeconds () << " s: first continuation after " << gap.GetMilliSeconds () << " ms" << std::endl;
+}
+
+static void
+NewSocket (Ptr<Socket> socket)
+{
+    socket->TraceConnectWithoutContext ("Failover", MakeCallback (&Failover));
+    socket->TraceConnectWithoutContext ("RecoveryGap", MakeCallback (&RecoveryGap));
+}
+
+static void
+Fail (std::vector<Ptr<RateErrorModel> > models)
+{
+    std::cout << Simulator::Now ().GetSeconds () << " s: server 0 fails" << std::endl;
+    g_rxAtFail = g_sink->GetTotalRx ();
+    for (uint32_t i = 0; i<models.size (); i++) models[i]->Enable ();
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t replicas = 2;
+    std::string access = "10Mbps";
+    uint32_t delay = 10; // One-way delay of every link (in milliseconds)
+    uint32_t minrto = 200;
+    uint32_t failover = 3;
+    double fail = 5;
+    uint32_t duration = 15;
+
+    CommandLine cmd;
+    cmd.AddValue ("replicas", "Number of servers including the primary one", replicas);
+    cmd.AddValue ("access", "Bandwidth of every link", access);
+    cmd.AddValue ("delay", "Delay of every link in milliseconds", delay);
+    cmd.AddValue ("minrto", "MinRto of the client in milliseconds", minrto);
+    cmd.AddValue ("failover", "Retransmission timeouts before failover (FailoverRetries)", failover);
+    cmd.AddValue ("fail", "Time the primary server fails", fail);
+    cmd.AddValue ("duration", "Duration of the experiment", duration);
+    cmd.Parse (argc, argv);
+
+    NS_ASSERT_MSG (replicas>=2, "At least one replica besides the primary server is needed");
+    Config::SetDefault ("ns3::TricklesSocketBase::MinRto", TimeValue (MilliSeconds (minrto)));
+    Config::SetDefault ("ns3::TricklesSocketBase::FailoverRetries", UintegerValue (failover));
+
+    NodeContainer client, router, servers;
+    client.Create (1);
+    router.Create (1);
+    servers.Create (replicas);
+    InternetStackHelper stack;
+    stack.InstallAll ();
+
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute ("DataRate", StringValue (access));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay)));
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.1.0.0", "255.255.255.0");
+    ipv4.Assign (p2p.Install (client.Get (0), router.Get (0)));
+    ipv4.SetBase ("10.2.0.0", "255.255.255.0");
+    std::vector<Ipv4Address> serverAddr;
+    std::vector<Ptr<RateErrorModel> > models;
+    for (uint32_t i = 0; i<replicas; i++) {
+        NetDeviceContainer link = p2p.Install (servers.Get (i), router.Get (0));
+        serverAddr.push_back (ipv4.Assign (link).GetAddress (0));
+        ipv4.NewNetwork ();
+        if (i) continue;
+        // The primary server link drops everything once enabled
+        for (uint32_t d = 0; d<link.GetN (); d++) {
+            Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+            em->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+            em->SetRate (1.0);
+            em->Disable ();
+            link.Get (d)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+            models.push_back (em);
+        }
+    }
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+    uint16_t port = 49000;
+    TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+    ApplicationContainer servApps = servhelp.Install (servers);
+    Address remote = InetSocketAddress (serverAddr[0], port);
+    TricklesSinkHelper sinkhelp (remote);
+    sinkhelp.SetAttribute ("Remote", AddressValue (remote));
+    sinkhelp.SetAttribute ("Greedy", BooleanValue (true));
+    ApplicationContainer sinkApps = sinkhelp.Install (client);
+    g_sink = DynamicCast<TricklesSink> (sinkApps.Get (0));
+    for (uint32_t i = 1; i<replicas; i++) g_sink->AddReplica (InetSocketAddress (serverAddr[i], port));
+    client.Get (0)->GetObject<TricklesL4Protocol> ()->TraceConnectWithoutContext ("NewSocket", MakeCallback (&NewSocket));
+    servApps.Stop (Seconds (duration));
+    sinkApps.Stop (Seconds (duration));
+
+    Simulator::Schedule (Seconds (fail), &Fail, models);
+    Simulator::Stop (Seconds (duration));
+    Simulator::Run ();
+
+    Ptr<TricklesSocketBase> socket = DynamicCast<TricklesSocketBase> (g_sink->GetSocket ());
+    uint64_t rx = g_sink->GetTotalRx ();
+    std::cout << "Failovers: " << socket->GetFailovers () << std::endl;
+    std::cout << "Recovery gap (ms): mean " << socket->GetMeanRecoveryGap ().GetMilliSeconds ()
+              << ", max " << socket->GetMaxRecoveryGap ().GetMilliSeconds () << std::endl;
+    std::cout << "Goodput before failure (Mbps): " << g_rxAtFail*8.0/fail/1e6 << std::endl;
+    std::cout << "Goodput after failure (Mbps): " << (rx-g_rxAtFail)*8.0/(duration-fail)/1e6 << std::endl;
+
+    g_sink = 0;
+    Simulator::Destroy ();
+    return 0;
+}
@@ -0,0 +1,233 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Fairness and coexistence of Trickles and TCP NewReno on one bottleneck.
+ *
+ * Network topology (dumbbell):
+ *
+ *   Server 0..K+M-1 --- L ===== bottleneck ===== R --- Client 0..K+M-1
+ *
+ * Flows 0..K-1 are Trickles (TricklesServer -> TricklesSink), flows
+ * K..K+M-1 are TCP NewReno (BulkSendApplication -> PacketSink). Flow i
+ * starts at i*stagger seconds.
+ *
+ * Output (CSV):
+ *   <prefix>-flows.csv   time,flow,protocol,bps        throughput time series
+ *   <prefix>-queue.csv   time,packets,drops            bottleneck queue
+ *   <prefix>-summary.csv flow,protocol,start,bps       throughput while all flows run
+ * Jain's fairness index over all flows and per protocol, bottleneck loss
+ * and the share of Trickles are printed at the end.
+ *
+ * There is no ECN option: no queue of ns-3.22 marks CE, so the bottleneck
+ * would never signal congestion that way. The ECN path of Trickles is
+ * covered by the trickles-socket test suite.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/point-to-point-layout-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesFairness");
+
+static ApplicationContainer g_sinks;
+static uint32_t g_trickles = 0;
+static std::vector<uint64_t> g_lastRx;
+static Ptr<Queue> g_queue;
+static uint32_t g_drops = 0;
+static std::ofstream g_flowsOut;
+static std::ofstream g_queueOut;
+
+static uint64_t
+TotalRx (uint32_t flow)
+{
+    if (flow<g_trickles) return DynamicCast<TricklesSink> (g_sinks.Get (flow))->GetTotalRx ();
+    return DynamicCast<PacketSink> (g_sinks.Get (flow))->GetTotalRx ();
+}
+
+static void
+CountDrop (Ptr<const Packet> p)
+{
+    g_drops++;
+}
+
+static void
+Sample (Time interval)
+{
+    double now = Simulator::Now ().GetSeconds ();
+    for (uint32_t i = 0; i<g_sinks.GetN (); i++) {
+        uint64_t rx = TotalRx (i);
+        g_flowsOut << now << "," << i << "," << ((i<g_trickles)?"trickles":"newreno") << ","
+                   << (rx-g_lastRx[i])*8.0/interval.GetSeconds () << std::endl;
+        g_lastRx[i] = rx;
+    }
+    g_queueOut << now << "," << g_queue->GetNPackets () << "," << g_drops << std::endl;
+    Simulator::Schedule (interval, &Sample, interval);
+}
+
+static double
+Jain (const std::vector<double> &x, uint32_t from, uint32_t to)
+{
+    double sum = 0, sumsq = 0;
+    for (uint32_t i = from; i<to; i++) {
+        sum += x[i];
+        sumsq += x[i]*x[i];
+    }
+    return (sumsq>0)?sum*sum/((to-from)*sumsq):0;
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t trickles = 2;
+    uint32_t tcp = 2;
+    std::string variant = "ns3::TricklesShieh";
+    std::string bottleneck = "10Mbps";
+    std::string access = "100Mbps";
+    uint32_t delay = 20; // One-way delay of the bottleneck (in milliseconds)
+    uint32_t queue = 50;
+    uint32_t segment = 1000;
+    double stagger = 5;
+    uint32_t duration = 60;
+    double interval = 0.5;
+    bool greedy = true;
+    bool hystart = true;
+    std::string prefix = "fairness";
+
+    CommandLine cmd;
+    cmd.AddValue ("trickles", "Number of Trickles flows (K)", trickles);
+    cmd.AddValue ("tcp", "Number of TCP NewReno flows (M)", tcp);
+    cmd.AddValue ("variant", "Trickles socket type", variant);
+    cmd.AddValue ("bottleneck", "Bottleneck bandwidth", bottleneck);
+    cmd.AddValue ("access", "Bandwidth of the access links", access);
+    cmd.AddValue ("delay", "Bottleneck delay in milliseconds", delay);
+    cmd.AddValue ("queue", "Bottleneck queue size in packets", queue);
+    cmd.AddValue ("segsize", "Segment size", segment);
+    cmd.AddValue ("stagger", "Seconds between flow starts", stagger);
+    cmd.AddValue ("duration", "Duration of the experiment", duration);
+    cmd.AddValue ("interval", "Sampling interval of the time series in seconds", interval);
+    cmd.AddValue ("greedy", "Trickles clients request as fast as the window allows", greedy);
+    cmd.AddValue ("hystart", "Leave Trickles slow start with HyStart", hystart);
+    cmd.AddValue ("prefix", "Prefix of the CSV files", prefix);
+    cmd.Parse (argc, argv);
+
+    uint32_t flows = trickles+tcp;
+    NS_ABORT_MSG_IF (flows == 0, "No flows");
+    NS_ABORT_MSG_IF ((flows-1)*stagger>=duration, "The last flow starts after the end of the experiment");
+
+    Config::SetDefault ("ns3::DropTailQueue::MaxPackets", UintegerValue (queue));
+    Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TricklesSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpNewReno"));
+    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue (variant));
+    Config::SetDefault ("ns3::TricklesShieh::HyStart", BooleanValue (hystart));
+
+    PointToPointHelper leaf;
+    leaf.SetDeviceAttribute ("DataRate", StringValue (access));
+    leaf.SetChannelAttribute ("Delay", StringValue ("1ms"));
+    PointToPointHelper neck;
+    neck.SetDeviceAttribute ("DataRate", StringValue (bottleneck));
+    neck.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay)));
+    PointToPointDumbbellHelper dumbbell (flows, leaf, flows, leaf, neck);
+
+    InternetStackHelper stack;
+    dumbbell.InstallStack (stack);
+    dumbbell.AssignIpv4Addresses (Ipv4AddressHelper ("10.1.0.0", "255.255.255.0"),
+                                  Ipv4AddressHelper ("10.2.0.0", "255.255.255.0"),
+                                  Ipv4AddressHelper ("10.3.0.0", "255.255.255.0"));
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+    // The bottleneck device is the first device of the left router
+    g_queue = DynamicCast<PointToPointNetDevice> (dumbbell.GetLeft ()->GetDevice (0))->GetQueue ();
+    g_queue->TraceConnectWithoutContext ("Drop", MakeCallback (&CountDrop));
+
+    uint16_t port = 49000;
+    ApplicationContainer servers;
+    for (uint32_t i = 0; i<flows; i++) {
+        Time start = Seconds (i*stagger);
+        if (i<trickles) {
+            TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+            servers.Add (servhelp.Install (dumbbell.GetLeft (i)));
+            Address remote = InetSocketAddress (dumbbell.GetLeftIpv4Address (i), port);
+            TricklesSinkHelper sinkhelp (remote);
+            sinkhelp.SetAttribute ("PacketSize", UintegerValue (5000));
+            sinkhelp.SetAttribute ("Remote", AddressValue (remote));
+            sinkhelp.SetAttribute ("DataRate", StringValue (bottleneck));
+            sinkhelp.SetAttribute ("Greedy", BooleanValue (greedy));
+            sinkhelp.SetAttribute ("StartTime", TimeValue (start));
+            g_sinks.Add (sinkhelp.Install (dumbbell.GetRight (i)));
+        } else {
+            PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+            g_sinks.Add (sink.Install (dumbbell.GetRight (i)));
+            BulkSendHelper bulk ("ns3::TcpSocketFactory", InetSocketAddress (dumbbell.GetRightIpv4Address (i), port));
+            ApplicationContainer app = bulk.Install (dumbbell.GetLeft (i));
+            app.Start (start);
+            servers.Add (app);
+        }
+    }
+    g_sinks.Stop (Seconds (duration));
+    servers.Stop (Seconds (duration));
+    g_trickles = trickles;
+    g_lastRx.assign (flows, 0);
+
+    g_flowsOut.open ((prefix+"-flows.csv").c_str ());
+    g_flowsOut << "time,flow,protocol,bps" << std::endl;
+    g_queueOut.open ((prefix+"-queue.csv").c_str ());
+    g_queueOut << "time,packets,drops" << std::endl;
+    Simulator::Schedule (Seconds (interval), &Sample, Seconds (interval));
+
+    // Fairness is measured while all flows are active
+    double lastStart = (flows-1)*stagger;
+    std::vector<uint64_t> rxAtLastStart (flows, 0);
+    Simulator::Stop (Seconds (lastStart));
+    Simulator::Run ();
+    for (uint32_t i = 0; i<flows; i++) rxAtLastStart[i] = TotalRx (i);
+    Simulator::Stop (Seconds (duration-lastStart));
+    Simulator::Run ();
+
+    std::vector<double> bps (flows);
+    std::ofstream summary ((prefix+"-summary.csv").c_str ());
+    summary << "flow,protocol,start,bps" << std::endl;
+    double tricklesBps = 0, total = 0;
+    for (uint32_t i = 0; i<flows; i++) {
+        bps[i] = (TotalRx (i)-rxAtLastStart[i])*8.0/(duration-lastStart);
+        total += bps[i];
+        if (i<trickles) tricklesBps += bps[i];
+        summary << i << "," << ((i<trickles)?"trickles":"newreno") << "," << i*stagger << "," << bps[i] << std::endl;
+    }
+
+    std::cout << "Trickles flows: " << trickles << " (" << variant << "), TCP NewReno flows: " << tcp << std::endl;
+    std::cout << "Jain index (all flows): " << Jain (bps, 0, flows) << std::endl;
+    if (trickles) std::cout << "Jain index (Trickles): " << Jain (bps, 0, trickles) << std::endl;
+    if (tcp) std::cout << "Jain index (TCP): " << Jain (bps, trickles, flows) << std::endl;
+    std::cout << "Trickles share: " << ((total>0)?tricklesBps/total:0) << " (fair share " << (double)trickles/flows << ")" << std::endl;
+    // The queue counts as received only the packets it accepted, a dropped packet arrived too
+    uint32_t arrived = g_queue->GetTotalReceivedPackets ()+g_queue->GetTotalDroppedPackets ();
+    std::cout << "Bottleneck loss: " << g_queue->GetTotalDroppedPackets () << "/" << arrived << " packets ("
+              << ((arrived>0)?(double)g_queue->GetTotalDroppedPackets ()/arrived:0) << ")" << std::endl;
+
+    Simulator::Destroy ();
+    return 0;
+}
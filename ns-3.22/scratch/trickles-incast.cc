@@ -0,0 +1,279 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Incast (partition-aggregate) workload.
+ *
+ * Network topology:
+ *
+ *   Server 0..M-1 --- Switch --- shallow buffer --- Client
+ *
+ * The client issues a query: a fetch of --size bytes from every server at
+ * the same time. The query completes when the last server's data has
+ * arrived, and the next query starts --think later. The switch port towards
+ * the client holds --buffer packets.
+ *
+ * Trickles: the client has one TricklesSocketBase per server and fetches
+ * with RequestRange; the servers run TricklesServer.
+ * TCP NewReno: the client has one connection per server and sends a one
+ * byte request per query; the server answers with --size bytes.
+ *
+ * Sweepable: --minrto (MinRto of TricklesSocketBase and TcpSocketBase), --pacing
+ * (Trickles continuation pacing), --retx (TCP duplicate ACK threshold).
+ * Trickles servers detect losses from the SACK blocks of every request, so
+ * it has no duplicate ACK threshold.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesIncast");
+
+static std::string g_protocol;
+static uint32_t g_size = 0;
+static uint32_t g_queries = 0;
+static Time g_think;
+static std::vector<Ptr<Socket> > g_sockets;
+static std::map<Ptr<Socket>, uint32_t> g_index;
+static std::vector<uint64_t> g_rx;
+static std::map<Ptr<Socket>, uint32_t> g_owed;
+static uint32_t g_query = 0;
+static uint32_t g_pending = 0;
+static Time g_queryStart;
+static std::vector<double> g_qct;
+
+static void StartQuery (void);
+
+static void
+FinishFetch (void)
+{
+    if (--g_pending) return;
+    g_qct.push_back ((Simulator::Now ()-g_queryStart).GetSeconds ());
+    NS_LOG_INFO ("Query " << g_query << " completed in " << g_qct.back () << " s");
+    if (++g_query<g_queries) Simulator::Schedule (g_think, &StartQuery);
+}
+
+static void
+TricklesFetchDone (Ptr<Socket> socket, uint32_t objectId, uint64_t offset, uint64_t length)
+{
+    FinishFetch ();
+}
+
+static void
+TcpClientRead (Ptr<Socket> socket)
+{
+    Ptr<Packet> p;
+    uint32_t i = g_index[socket];
+    uint64_t target = (uint64_t)(g_query+1)*g_size;
+    while ((p = socket->Recv ())) {
+        bool wasShort = g_rx[i]<target;
+        g_rx[i] += p->GetSize ();
+        if (wasShort && (g_rx[i]>=target)) FinishFetch ();
+    }
+}
+
+static void
+TcpServerSend (Ptr<Socket> socket, uint32_t available)
+{
+    // The answer is sent as the transmit buffer drains
+    std::map<Ptr<Socket>, uint32_t>::iterator owed = g_owed.find (socket);
+    if (owed == g_owed.end ()) return;
+    uint32_t size = std::min (owed->second, socket->GetTxAvailable ());
+    if (size && (socket->Send (Create<Packet> (size)) >= 0)) owed->second -= size;
+}
+
+static void
+TcpServerRead (Ptr<Socket> socket)
+{
+    Ptr<Packet> p;
+    while ((p = socket->Recv ())) g_owed[socket] += p->GetSize ()*g_size;
+    TcpServerSend (socket, socket->GetTxAvailable ());
+}
+
+static void
+TcpServerAccept (Ptr<Socket> socket, const Address &from)
+{
+    g_owed[socket] = 0;
+    socket->SetRecvCallback (MakeCallback (&TcpServerRead));
+    socket->SetSendCallback (MakeCallback (&TcpServerSend));
+}
+
+static void
+StartQuery (void)
+{
+    g_queryStart = Simulator::Now ();
+    g_pending = g_sockets.size ();
+    for (uint32_t i = 0; i<g_sockets.size (); i++) {
+        if (g_protocol == "trickles") {
+            DynamicCast<TricklesSocketBase> (g_sockets[i])->RequestRange (1, (uint64_t)g_query*g_size, g_size, MakeCallback (&TricklesFetchDone));
+        } else {
+            g_sockets[i]->Send (Create<Packet> (1));
+        }
+    }
+}
+
+static double
+Percentile (const std::vector<double> &sorted, double q)
+{
+    if (sorted.empty ()) return 0;
+    return sorted[(size_t)(q*(sorted.size ()-1)+0.5)];
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t servers = 8;
+    std::string protocol = "trickles";
+    std::string variant = "ns3::TricklesShieh";
+    std::string rate = "1Gbps";
+    uint32_t delay = 20; // One-way delay of every link (in microseconds)
+    uint32_t buffer = 32; // Switch port buffer towards the client (in packets)
+    uint32_t segment = 1000;
+    uint32_t size = 64000;
+    uint32_t queries = 100;
+    double think = 0.01;
+    uint32_t minrto = 200; // Minimal RTO (in milliseconds)
+    bool pacing = false;
+    bool hystart = true;
+    uint32_t retx = 3;
+    uint32_t duration = 600;
+    std::string csv = "";
+
+    CommandLine cmd;
+    cmd.AddValue ("servers", "Number of servers (M)", servers);
+    cmd.AddValue ("protocol", "Protocol name (trickles, newreno)", protocol);
+    cmd.AddValue ("variant", "Trickles socket type", variant);
+    cmd.AddValue ("rate", "Bandwidth of every link", rate);
+    cmd.AddValue ("delay", "Delay of every link in microseconds", delay);
+    cmd.AddValue ("buffer", "Switch buffer towards the client in packets", buffer);
+    cmd.AddValue ("segsize", "Segment size", segment);
+    cmd.AddValue ("size", "Bytes fetched from every server per query", size);
+    cmd.AddValue ("queries", "Number of queries", queries);
+    cmd.AddValue ("think", "Seconds between a query completion and the next query", think);
+    cmd.AddValue ("minrto", "Minimal RTO in milliseconds", minrto);
+    cmd.AddValue ("pacing", "Pace Trickles continuations at the servers", pacing);
+    cmd.AddValue ("hystart", "Leave Trickles slow start with HyStart", hystart);
+    cmd.AddValue ("retx", "TCP duplicate ACK threshold", retx);
+    cmd.AddValue ("duration", "Simulation time limit in seconds", duration);
+    cmd.AddValue ("csv", "Append one row per query to this CSV file", csv);
+    cmd.Parse (argc, argv);
+
+    Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (std::max<uint32_t> (131072, size)));
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpNewReno"));
+    Config::SetDefault ("ns3::TcpNewReno::ReTxThreshold", UintegerValue (retx));
+    Config::SetDefault ("ns3::TcpSocketBase::MinRto", TimeValue (MilliSeconds (minrto)));
+    Config::SetDefault ("ns3::TricklesSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue (variant));
+    Config::SetDefault ("ns3::TricklesShieh::HyStart", BooleanValue (hystart));
+    Config::SetDefault ("ns3::TricklesL4Protocol::Pacing", BooleanValue (pacing));
+    Config::SetDefault ("ns3::TricklesSocketBase::MinRto", TimeValue (MilliSeconds (minrto)));
+
+    NodeContainer client, sw, serverNodes;
+    client.Create (1);
+    sw.Create (1);
+    serverNodes.Create (servers);
+    InternetStackHelper stack;
+    stack.Install (client);
+    stack.Install (sw);
+    stack.Install (serverNodes);
+
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute ("DataRate", StringValue (rate));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (delay)));
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.0.0.0", "255.255.255.0");
+
+    p2p.SetQueue ("ns3::DropTailQueue", "MaxPackets", UintegerValue (buffer));
+    ipv4.Assign (p2p.Install (sw.Get (0), client.Get (0)));
+    ipv4.NewNetwork ();
+    p2p.SetQueue ("ns3::DropTailQueue", "MaxPackets", UintegerValue (1000));
+    std::vector<Ipv4Address> serverAddr;
+    for (uint32_t i = 0; i<servers; i++) {
+        Ipv4InterfaceContainer iface = ipv4.Assign (p2p.Install (serverNodes.Get (i), sw.Get (0)));
+        ipv4.NewNetwork ();
+        serverAddr.push_back (iface.GetAddress (0));
+    }
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+    g_protocol = protocol;
+    g_size = size;
+    g_queries = queries;
+    g_think = Seconds (think);
+    uint16_t port = 49000;
+    for (uint32_t i = 0; i<servers; i++) {
+        Ptr<Socket> socket;
+        if (protocol == "trickles") {
+            TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+            servhelp.Install (serverNodes.Get (i));
+            socket = Socket::CreateSocket (client.Get (0), TricklesSocketFactory::GetTypeId ());
+        } else {
+            Ptr<Socket> listener = Socket::CreateSocket (serverNodes.Get (i), TcpSocketFactory::GetTypeId ());
+            listener->Bind (InetSocketAddress (Ipv4Address::GetAny (), port));
+            listener->Listen ();
+            listener->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (), MakeCallback (&TcpServerAccept));
+            socket = Socket::CreateSocket (client.Get (0), TcpSocketFactory::GetTypeId ());
+            socket->SetRecvCallback (MakeCallback (&TcpClientRead));
+        }
+        socket->Bind ();
+        socket->Connect (InetSocketAddress (serverAddr[i], port));
+        g_index[socket] = i;
+        g_sockets.push_back (socket);
+    }
+    g_rx.assign (servers, 0);
+
+    // Let the TCP connections get established
+    Simulator::Schedule (Seconds (1), &StartQuery);
+    Simulator::Stop (Seconds (duration));
+    Simulator::Run ();
+
+    std::vector<double> sorted = g_qct;
+    std::sort (sorted.begin (), sorted.end ());
+    double mean = 0;
+    for (size_t i = 0; i<sorted.size (); i++) mean += sorted[i];
+    if (!sorted.empty ()) mean /= sorted.size ();
+    std::cout << "Protocol: " << protocol << (protocol == "trickles"?" ("+variant+")":"") << ", servers: " << servers
+              << ", " << size << " bytes each, buffer " << buffer << " packets" << std::endl;
+    std::cout << "Queries completed: " << g_qct.size () << "/" << queries << std::endl;
+    std::cout << "QCT (ms): mean " << mean*1e3 << " p50 " << Percentile (sorted, 0.5)*1e3 << " p90 " << Percentile (sorted, 0.9)*1e3
+              << " p99 " << Percentile (sorted, 0.99)*1e3 << " max " << Percentile (sorted, 1)*1e3 << std::endl;
+
+    if (csv != "") {
+        std::ifstream exists (csv.c_str ());
+        bool header = !exists.good ();
+        exists.close ();
+        std::ofstream out (csv.c_str (), std::ios::app);
+        if (header) out << "protocol,variant,servers,size,buffer,minrto_ms,pacing,retx,query,qct_s" << std::endl;
+        for (size_t i = 0; i<g_qct.size (); i++) {
+            out << protocol << "," << variant << "," << servers << "," << size << "," << buffer << "," << minrto << ","
+                << pacing << "," << retx << "," << i << "," << g_qct[i] << std::endl;
+        }
+    }
+
+    Simulator::Destroy ();
+    return 0;
+}
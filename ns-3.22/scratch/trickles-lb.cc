@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Trickles server replicas behind a stateless load balancer.
+ *
+ * Network topology:
+ *
+ *   Client 0..N-1 --- Balancer --- Replica 0..R-1
+ *
+ * The clients fetch from the virtual address of the balancer. The
+ * balancer (TricklesLoadBalancer) forwards every request to one of the
+ * replicas by --policy (Hash, RoundRobin, LeastQueue) and sends the
+ * continuations back to the clients from the virtual address. Every
+ * replica runs a TricklesServer with --service microseconds of CPU time
+ * per request on --cores cores, so the replicas are the bottleneck.
+ *
+ * Prints the requests forwarded to and served by every replica, Jain's
+ * index of the replica load, the total goodput and the mean queueing
+ * delay of the replicas.
+ */
+
+#include <iostream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesLoadBalancing");
+
+int main (int argc, char *argv[])
+{
+    uint32_t clients = 8;
+    uint32_t replicas = 4;
+    std::string policy = "RoundRobin";
+    std::string access = "100Mbps";
+    uint32_t delay = 5; // One-way delay of every link (in milliseconds)
+    uint32_t queue = 100;
+    uint32_t segment = 1000;
+    double service = 100; // Per-request CPU cost of a replica (in microseconds)
+    uint32_t cores = 1;
+    std::string rate = "10Mbps"; // Request rate of every client
+    uint32_t duration = 20;
+
+    CommandLine cmd;
+    cmd.AddValue ("clients", "Number of clients", clients);
+    cmd.AddValue ("replicas", "Number of server replicas", replicas);
+    cmd.AddValue ("policy", "Replica selection (Hash, RoundRobin, LeastQueue)", policy);
+    cmd.AddValue ("access", "Bandwidth of every link", access);
+    cmd.AddValue ("delay", "Delay of every link in milliseconds", delay);
+    cmd.AddValue ("queue", "Queue size of every device", queue);
+    cmd.AddValue ("segsize", "Segment size", segment);
+    cmd.AddValue ("service", "Mean per-request CPU cost of a replica in microseconds", service);
+    cmd.AddValue ("cores", "Number of cores of every replica", cores);
+    cmd.AddValue ("rate", "Request rate of every client", rate);
+    cmd.AddValue ("duration", "Duration of the experiment", duration);
+    cmd.Parse (argc, argv);
+
+    Config::SetDefault ("ns3::DropTailQueue::MaxPackets", UintegerValue (queue));
+    Config::SetDefault ("ns3::TricklesSocket::SegmentSize", UintegerValue (segment));
+
+    NodeContainer balancer, clientNodes, replicaNodes;
+    balancer.Create (1);
+    clientNodes.Create (clients);
+    replicaNodes.Create (replicas);
+    InternetStackHelper stack;
+    stack.InstallAll ();
+
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute ("DataRate", StringValue (access));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay)));
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.1.0.0", "255.255.255.0");
+    std::vector<Ipv4Address> balancerSide;
+    for (uint32_t i = 0; i<clients; i++) {
+        Ipv4InterfaceContainer ifs = ipv4.Assign (p2p.Install (clientNodes.Get (i), balancer.Get (0)));
+        balancerSide.push_back (ifs.GetAddress (1));
+        ipv4.NewNetwork ();
+    }
+    ipv4.SetBase ("10.2.0.0", "255.255.255.0");
+    std::vector<Ipv4Address> replicaAddr;
+    for (uint32_t i = 0; i<replicas; i++) {
+        Ipv4InterfaceContainer ifs = ipv4.Assign (p2p.Install (replicaNodes.Get (i), balancer.Get (0)));
+        replicaAddr.push_back (ifs.GetAddress (0));
+        ipv4.NewNetwork ();
+    }
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+    Ptr<TricklesLoadBalancer> lb = CreateObject<TricklesLoadBalancer> ();
+    lb->SetAttribute ("Policy", StringValue (policy));
+    Ipv4Address vip ("10.255.255.1");
+    lb->SetAttribute ("VirtualAddress", Ipv4AddressValue (vip));
+    lb->Install (balancer.Get (0));
+
+    // The virtual address belongs to no interface: the clients reach it through the balancer
+    Ipv4StaticRoutingHelper routing;
+    for (uint32_t i = 0; i<clients; i++) {
+        routing.GetStaticRouting (clientNodes.Get (i)->GetObject<Ipv4> ())->AddHostRouteTo (vip, balancerSide[i], 1);
+    }
+
+    uint16_t port = 49000;
+    ApplicationContainer servers;
+    for (uint32_t i = 0; i<replicas; i++) {
+        TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+        servhelp.SetAttribute ("Cores", UintegerValue (cores));
+        if (service>0) {
+            std::ostringstream st;
+            st << "ns3::ExponentialRandomVariable[Mean=" << service*1e-6 << "]";
+            servhelp.SetAttribute ("ServiceTime", StringValue (st.str ()));
+        }
+        ApplicationContainer app = servhelp.Install (replicaNodes.Get (i));
+        Ptr<TricklesServer> server = DynamicCast<TricklesServer> (app.Get (0));
+        lb->AddReplica (replicaAddr[i], MakeCallback (&TricklesServer::GetQueueLength, server));
+        servers.Add (app);
+    }
+    ApplicationContainer sinks;
+    Address remote = InetSocketAddress (vip, port);
+    for (uint32_t i = 0; i<clients; i++) {
+        TricklesSinkHelper sinkhelp (remote);
+        sinkhelp.SetAttribute ("PacketSize", UintegerValue (5000));
+        sinkhelp.SetAttribute ("Remote", AddressValue (remote));
+        sinkhelp.SetAttribute ("DataRate", StringValue (rate));
+        sinks.Add (sinkhelp.Install (clientNodes.Get (i)));
+    }
+    servers.Stop (Seconds (duration));
+    sinks.Stop (Seconds (duration));
+
+    Simulator::Stop (Seconds (duration));
+    Simulator::Run ();
+
+    uint64_t rx = 0;
+    for (uint32_t i = 0; i<clients; i++) rx += DynamicCast<TricklesSink> (sinks.Get (i))->GetTotalRx ();
+    double sum = 0, sumsq = 0, wait = 0;
+    std::cout << "Policy: " << policy << ", clients: " << clients << ", replicas: " << replicas << std::endl;
+    for (uint32_t i = 0; i<replicas; i++) {
+        Ptr<TricklesServer> server = DynamicCast<TricklesServer> (servers.Get (i));
+        double served = server->GetServed ();
+        sum += served;
+        sumsq += served*served;
+        wait += server->GetMeanQueueDelay ().GetSeconds ();
+        std::cout << "Replica " << i << " (" << replicaAddr[i] << "): forwarded " << lb->GetForwarded (i)
+                  << ", served " << server->GetServed () << ", dropped " << server->GetDropped () << std::endl;
+    }
+    std::cout << "Jain index (replica load): " << ((sumsq>0)?sum*sum/(replicas*sumsq):0) << std::endl;
+    std::cout << "Mean queue delay (ms): " << wait/replicas*1000 << std::endl;
+    std::cout << "Goodput (Mbps): " << rx*8.0/duration/1e6 << std::endl;
+
+    Simulator::Destroy ();
+    return 0;
+}
@@ -0,0 +1,491 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Loss and reordering stress benchmark.
+ *
+ * Network topology:
+ *
+ *   Server ===== bottleneck (loss, reordering) =====> Client
+ *
+ * One flow per run, Trickles (TricklesServer -> TricklesSink) or TCP
+ * NewReno (BulkSendApplication -> PacketSink). Packets arriving at the
+ * client are first passed to the loss model (RateErrorModel, or
+ * BurstErrorModel with --burst > 1) and then, with probability
+ * --reorder, held back for --reorderdelay and delivered behind the
+ * packets that follow them.
+ *
+ * Every combination of --losses x --reorders x --protocols is run as a
+ * separate simulation. Per run:
+ *   goodput     received bytes over the run
+ *   recovery    mean loss episode length: from the first drop until the
+ *               rate over the last RTT is back to 90% of the rate before it
+ *   spurious    TCP: data segments the client had already received;
+ *               Trickles: trickles the client requested again (fast
+ *               retransmit or RTO) whose original continuation arrived
+ *               later after all, each trickle counted once
+ *   killed      Trickles: requests the server answered with no
+ *               continuation to halve the window in fast recovery
+ *
+ * Output: <prefix>.csv with one row per run and gnuplot scripts
+ * <prefix>-goodput.plt, <prefix>-recovery.plt, <prefix>-spurious.plt and
+ * <prefix>-killed.plt
+ * (one curve per protocol and reordering rate, loss rate on the x axis).
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/gnuplot.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesLoss");
+
+/*
+ * Loss and reordering stage of the bottleneck receiver. Reordered packets
+ * are dropped from the normal path and handed to the device again later;
+ * their uid lets them pass the second time.
+ */
+class ReorderErrorModel : public ErrorModel
+{
+public:
+    static TypeId GetTypeId (void);
+    ReorderErrorModel ();
+    void SetDevice (Ptr<PointToPointNetDevice> device) { m_device = device; }
+    void SetLossModel (Ptr<ErrorModel> loss) { m_loss = loss; }
+    void SetDropCallback (Callback<void> cb) { m_dropCallback = cb; }
+    uint32_t GetReordered (void) const { return m_reordered; }
+    uint32_t GetDropped (void) const { return m_dropped; }
+private:
+    virtual bool DoCorrupt (Ptr<Packet> p);
+    virtual void DoReset (void) {}
+    void Deliver (Ptr<Packet> p);
+
+    Ptr<PointToPointNetDevice> m_device;
+    Ptr<ErrorModel> m_loss;
+    Ptr<UniformRandomVariable> m_random;
+    double m_rate;
+    Time m_delay;
+    std::set<uint64_t> m_held;
+    Callback<void> m_dropCallback;
+    uint32_t m_reordered;
+    uint32_t m_dropped;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ReorderErrorModel);
+
+TypeId
+ReorderErrorModel::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ReorderErrorModel")
+    .SetParent<ErrorModel> ()
+    .AddConstructor<ReorderErrorModel> ()
+    .AddAttribute ("Rate", "Probability that a packet is delayed behind the following ones",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&ReorderErrorModel::m_rate),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("Delay", "Extra delay of a reordered packet",
+                   TimeValue (MilliSeconds (5)),
+                   MakeTimeAccessor (&ReorderErrorModel::m_delay),
+                   MakeTimeChecker ())
+    ;
+    return tid;
+}
+
+ReorderErrorModel::ReorderErrorModel ()
+: m_random (CreateObject<UniformRandomVariable> ()),
+m_rate (0),
+m_reordered (0),
+m_dropped (0)
+{
+}
+
+bool
+ReorderErrorModel::DoCorrupt (Ptr<Packet> p)
+{
+    std::set<uint64_t>::iterator i = m_held.find (p->GetUid ());
+    if (i != m_held.end ()) {
+        m_held.erase (i);
+        return false;
+    }
+    if (m_loss && m_loss->IsCorrupt (p)) {
+        m_dropped++;
+        if (!m_dropCallback.IsNull ()) m_dropCallback ();
+        return true;
+    }
+    if (m_rate>0 && m_random->GetValue ()<m_rate) {
+        m_reordered++;
+        m_held.insert (p->GetUid ());
+        Simulator::Schedule (m_delay, &ReorderErrorModel::Deliver, this, p->Copy ());
+        return true;
+    }
+    return false;
+}
+
+void
+ReorderErrorModel::Deliver (Ptr<Packet> p)
+{
+    m_device->Receive (p);
+}
+
+struct RunResult
+{
+    double goodput;
+    double recovery;
+    uint32_t episodes;
+    uint32_t spurious;
+    uint32_t killed;
+    uint32_t dropped;
+    uint32_t reordered;
+};
+
+// Per-run state
+static Time g_rtt;
+static std::deque<std::pair<Time, uint32_t> > g_window;
+static uint64_t g_windowBytes = 0;
+static bool g_inEpisode = false;
+static double g_episodeRate = 0;
+static Time g_episodeStart;
+static std::vector<double> g_recoveries;
+static uint32_t g_spurious = 0;
+static uint32_t g_killed = 0;
+static std::set<SequenceNumber32> g_retxTrickles;
+static std::map<uint32_t, uint32_t> g_tcpReceived;
+
+static void
+ExpireWindow (void)
+{
+    while (!g_window.empty () && (g_window.front ().first<Simulator::Now ()-g_rtt)) {
+        g_windowBytes -= g_window.front ().second;
+        g_window.pop_front ();
+    }
+}
+
+static void
+OnDrop (void)
+{
+    if (g_inEpisode) return;
+    ExpireWindow ();
+    // Episodes are measured against the rate before them; nothing to compare with at the start
+    if (!g_windowBytes) return;
+    g_inEpisode = true;
+    g_episodeRate = g_windowBytes;
+    g_episodeStart = Simulator::Now ();
+}
+
+static void
+OnData (uint32_t bytes)
+{
+    g_window.push_back (std::make_pair (Simulator::Now (), bytes));
+    g_windowBytes += bytes;
+    ExpireWindow ();
+    if (g_inEpisode && (g_windowBytes>=0.9*g_episodeRate)) {
+        g_inEpisode = false;
+        g_recoveries.push_back ((Simulator::Now ()-g_episodeStart).GetSeconds ());
+    }
+}
+
+// TCP: a segment is spurious if every byte of it was received before
+static bool
+TcpSeen (uint32_t from, uint32_t to)
+{
+    std::map<uint32_t, uint32_t>::iterator i = g_tcpReceived.upper_bound (from);
+    if (i == g_tcpReceived.begin ()) return false;
+    i--;
+    return i->second>=to;
+}
+
+static void
+TcpAdd (uint32_t from, uint32_t to)
+{
+    std::map<uint32_t, uint32_t>::iterator i = g_tcpReceived.upper_bound (from);
+    if (i != g_tcpReceived.begin ()) {
+        std::map<uint32_t, uint32_t>::iterator p = i;
+        p--;
+        if (p->second>=from) {
+            from = p->first;
+            to = std::max (to, p->second);
+            g_tcpReceived.erase (p);
+        }
+    }
+    while ((i != g_tcpReceived.end ()) && (i->first<=to)) {
+        to = std::max (to, i->second);
+        g_tcpReceived.erase (i++);
+    }
+    g_tcpReceived[from] = to;
+}
+
+static void
+ClientDeliver (const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface)
+{
+    Ptr<Packet> cp = p->Copy ();
+    TcpHeader th;
+    cp->RemoveHeader (th);
+    if (h.GetProtocol () == TricklesL4Protocol::PROT_NUMBER) {
+        TricklesHeader trh;
+        TricklesShiehHeader tsh;
+        cp->RemoveHeader (trh);
+        cp->RemoveHeader (tsh);
+        // The original continuation of a trickle the client has already requested again
+        if (trh.IsRecovery () == NO_RECOVERY) {
+            std::set<SequenceNumber32>::iterator i = g_retxTrickles.find (trh.GetTrickleNumber ());
+            if (i != g_retxTrickles.end ()) {
+                g_spurious++;
+                g_retxTrickles.erase (i);
+            }
+        }
+        if (cp->GetSize ()) OnData (cp->GetSize ());
+        return;
+    }
+    uint32_t size = cp->GetSize ();
+    if (!size) return;
+    uint32_t from = th.GetSequenceNumber ().GetValue ();
+    if (TcpSeen (from, from+size)) g_spurious++;
+    else OnData (size);
+    TcpAdd (from, from+size);
+}
+
+static void
+TricklesRetransmitted (SequenceNumber32 from, SequenceNumber32 to)
+{
+    for (SequenceNumber32 k = from; k<to; k++) g_retxTrickles.insert (k);
+}
+
+static void
+TricklesKilled (SequenceNumber32 trickle)
+{
+    g_killed++;
+}
+
+static void
+TricklesClientSocket (Ptr<Socket> socket)
+{
+    socket->TraceConnectWithoutContext ("RetransmittedTrickles", MakeCallback (&TricklesRetransmitted));
+}
+
+static void
+TricklesServerSocket (Ptr<Socket> socket)
+{
+    socket->TraceConnectWithoutContext ("KilledTrickle", MakeCallback (&TricklesKilled));
+}
+
+static RunResult
+Run (std::string protocol, double loss, double reorder, uint32_t burst, Time reorderDelay,
+     std::string bandwidth, uint32_t delay, uint32_t queue, uint32_t duration)
+{
+    g_rtt = MilliSeconds (2*delay);
+    g_window.clear ();
+    g_windowBytes = 0;
+    g_inEpisode = false;
+    g_recoveries.clear ();
+    g_spurious = 0;
+    g_killed = 0;
+    g_retxTrickles.clear ();
+    g_tcpReceived.clear ();
+    // Every run assigns the same addresses
+    Ipv4AddressGenerator::Reset ();
+
+    NodeContainer nodes;
+    nodes.Create (2);
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute ("DataRate", StringValue (bandwidth));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay)));
+    p2p.SetQueue ("ns3::DropTailQueue", "MaxPackets", UintegerValue (queue));
+    NetDeviceContainer devices = p2p.Install (nodes);
+    InternetStackHelper stack;
+    stack.Install (nodes);
+    Ipv4AddressHelper address;
+    address.SetBase ("10.0.0.0", "255.255.255.0");
+    Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+    Ptr<ErrorModel> lossModel;
+    if (burst>1) {
+        Ptr<BurstErrorModel> em = CreateObject<BurstErrorModel> ();
+        std::ostringstream size;
+        size << "ns3::UniformRandomVariable[Min=1|Max=" << 2*burst-1 << "]";
+        em->SetAttribute ("BurstSize", StringValue (size.str ()));
+        // Bursts start with a rate that keeps the packet loss rate at --losses
+        em->SetAttribute ("ErrorRate", DoubleValue (loss/burst));
+        lossModel = em;
+    } else {
+        Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+        em->SetAttribute ("ErrorUnit", StringValue ("ERROR_UNIT_PACKET"));
+        em->SetAttribute ("ErrorRate", DoubleValue (loss));
+        lossModel = em;
+    }
+    lossModel->SetAttribute ("IsEnabled", BooleanValue (loss>0));
+    Ptr<ReorderErrorModel> stage = CreateObject<ReorderErrorModel> ();
+    stage->SetAttribute ("Rate", DoubleValue (reorder));
+    stage->SetAttribute ("Delay", TimeValue (reorderDelay));
+    stage->SetDevice (DynamicCast<PointToPointNetDevice> (devices.Get (1)));
+    stage->SetLossModel (lossModel);
+    stage->SetDropCallback (MakeCallback (&OnDrop));
+    devices.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (stage));
+
+    nodes.Get (1)->GetObject<Ipv4> ()->TraceConnectWithoutContext ("LocalDeliver", MakeCallback (&ClientDeliver));
+
+    uint16_t port = 49000;
+    ApplicationContainer apps;
+    if (protocol == "trickles") {
+        nodes.Get (0)->GetObject<TricklesL4Protocol> ()->TraceConnectWithoutContext ("NewSocket", MakeCallback (&TricklesServerSocket));
+        nodes.Get (1)->GetObject<TricklesL4Protocol> ()->TraceConnectWithoutContext ("NewSocket", MakeCallback (&TricklesClientSocket));
+        TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+        apps.Add (servhelp.Install (nodes.Get (0)));
+        Address remote = InetSocketAddress (interfaces.GetAddress (0), port);
+        TricklesSinkHelper sinkhelp (remote);
+        sinkhelp.SetAttribute ("PacketSize", UintegerValue (5000));
+        sinkhelp.SetAttribute ("Remote", AddressValue (remote));
+        sinkhelp.SetAttribute ("DataRate", StringValue (bandwidth));
+        sinkhelp.SetAttribute ("Greedy", BooleanValue (true));
+        apps.Add (sinkhelp.Install (nodes.Get (1)));
+    } else {
+        PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+        apps.Add (sink.Install (nodes.Get (1)));
+        BulkSendHelper bulk ("ns3::TcpSocketFactory", InetSocketAddress (interfaces.GetAddress (1), port));
+        apps.Add (bulk.Install (nodes.Get (0)));
+    }
+    apps.Stop (Seconds (duration));
+
+    Simulator::Stop (Seconds (duration));
+    Simulator::Run ();
+
+    RunResult r;
+    uint64_t rx = (protocol == "trickles")?DynamicCast<TricklesSink> (apps.Get (1))->GetTotalRx ():DynamicCast<PacketSink> (apps.Get (0))->GetTotalRx ();
+    r.goodput = rx*8.0/duration;
+    r.episodes = g_recoveries.size ();
+    r.recovery = 0;
+    for (uint32_t i = 0; i<g_recoveries.size (); i++) r.recovery += g_recoveries[i];
+    if (r.episodes) r.recovery /= r.episodes;
+    r.spurious = g_spurious;
+    r.killed = g_killed;
+    r.dropped = stage->GetDropped ();
+    r.reordered = stage->GetReordered ();
+    Simulator::Destroy ();
+    return r;
+}
+
+static std::vector<std::string>
+Split (std::string list)
+{
+    std::vector<std::string> items;
+    std::istringstream in (list);
+    std::string item;
+    while (std::getline (in, item, ',')) if (!item.empty ()) items.push_back (item);
+    return items;
+}
+
+static void
+WritePlot (std::string prefix, std::string metric, std::string ylabel, std::map<std::string, Gnuplot2dDataset> &curves)
+{
+    Gnuplot plot (prefix+"-"+metric+".png");
+    plot.SetTerminal ("png");
+    plot.SetLegend ("Loss rate", ylabel);
+    plot.AppendExtra ("set key outside");
+    for (std::map<std::string, Gnuplot2dDataset>::iterator i = curves.begin (); i != curves.end (); i++) {
+        plot.AddDataset (i->second);
+    }
+    std::ofstream out ((prefix+"-"+metric+".plt").c_str ());
+    plot.GenerateOutput (out);
+}
+
+int main (int argc, char *argv[])
+{
+    std::string protocols = "trickles,newreno";
+    std::string losses = "0,0.001,0.005,0.01,0.02,0.05";
+    std::string reorders = "0,0.01";
+    uint32_t burst = 1;
+    double reorderDelay = 5; // Extra delay of reordered packets (in milliseconds)
+    std::string bandwidth = "10Mbps";
+    uint32_t delay = 20; // One-way delay of the bottleneck (in milliseconds)
+    uint32_t queue = 50;
+    uint32_t segment = 1000;
+    uint32_t duration = 60;
+    std::string variant = "ns3::TricklesShieh";
+    bool hystart = true;
+    std::string prefix = "loss";
+
+    CommandLine cmd;
+    cmd.AddValue ("protocols", "Comma-separated protocols (trickles, newreno)", protocols);
+    cmd.AddValue ("losses", "Comma-separated packet loss rates", losses);
+    cmd.AddValue ("reorders", "Comma-separated reordering rates", reorders);
+    cmd.AddValue ("burst", "Mean loss burst length in packets (1 uses RateErrorModel)", burst);
+    cmd.AddValue ("reorderdelay", "Extra delay of a reordered packet in milliseconds", reorderDelay);
+    cmd.AddValue ("bandwidth", "Bottleneck bandwidth", bandwidth);
+    cmd.AddValue ("delay", "Bottleneck delay in milliseconds", delay);
+    cmd.AddValue ("queue", "Bottleneck queue size in packets", queue);
+    cmd.AddValue ("segsize", "Segment size", segment);
+    cmd.AddValue ("duration", "Duration of every run", duration);
+    cmd.AddValue ("variant", "Trickles socket type", variant);
+    cmd.AddValue ("hystart", "Leave Trickles slow start with HyStart", hystart);
+    cmd.AddValue ("prefix", "Prefix of the output files", prefix);
+    cmd.Parse (argc, argv);
+
+    Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TricklesSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpNewReno"));
+    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue (variant));
+    Config::SetDefault ("ns3::TricklesShieh::HyStart", BooleanValue (hystart));
+
+    std::ofstream csv ((prefix+".csv").c_str ());
+    csv << "protocol,loss,reorder,goodput_bps,recovery_s,episodes,spurious,killed,dropped,reordered" << std::endl;
+    std::map<std::string, Gnuplot2dDataset> goodput, recovery, spurious, killed;
+    std::vector<std::string> p = Split (protocols), l = Split (losses), o = Split (reorders);
+    for (uint32_t i = 0; i<p.size (); i++) {
+        for (uint32_t k = 0; k<o.size (); k++) {
+            std::string curve = p[i]+", reordering "+o[k];
+            goodput[curve].SetTitle (curve);
+            recovery[curve].SetTitle (curve);
+            spurious[curve].SetTitle (curve);
+            killed[curve].SetTitle (curve);
+            goodput[curve].SetStyle (Gnuplot2dDataset::LINES_POINTS);
+            recovery[curve].SetStyle (Gnuplot2dDataset::LINES_POINTS);
+            spurious[curve].SetStyle (Gnuplot2dDataset::LINES_POINTS);
+            killed[curve].SetStyle (Gnuplot2dDataset::LINES_POINTS);
+            for (uint32_t j = 0; j<l.size (); j++) {
+                double loss = atof (l[j].c_str ());
+                double reorder = atof (o[k].c_str ());
+                RunResult r = Run (p[i], loss, reorder, burst, MilliSeconds (reorderDelay), bandwidth, delay, queue, duration);
+                csv << p[i] << "," << loss << "," << reorder << "," << r.goodput << "," << r.recovery << ","
+                    << r.episodes << "," << r.spurious << "," << r.killed << "," << r.dropped << "," << r.reordered << std::endl;
+                std::cout << curve << ", loss " << loss << ": goodput " << r.goodput/1e6 << " Mbps, recovery "
+                          << r.recovery*1000 << " ms (" << r.episodes << " episodes), spurious " << r.spurious << ", killed " << r.killed << std::endl;
+                goodput[curve].Add (loss, r.goodput/1e6);
+                recovery[curve].Add (loss, r.recovery*1000);
+                spurious[curve].Add (loss, r.spurious);
+                killed[curve].Add (loss, r.killed);
+            }
+        }
+    }
+    WritePlot (prefix, "goodput", "Goodput (Mbps)", goodput);
+    WritePlot (prefix, "recovery", "Mean recovery time (ms)", recovery);
+    WritePlot (prefix, "spurious", "Spurious retransmissions", spurious);
+    WritePlot (prefix, "killed", "Killed trickles", killed);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * One-to-many delivery of one continuation stream.
+ *
+ * Network topology:
+ *
+ *   Server ---- uplink ---- Router ==== LAN (CSMA) ==== Receiver 0..N-1
+ *
+ * Every receiver fetches from the server. With --group the server and
+ * the receivers use the group mode of TricklesSocketBase: continuations
+ * of the group stream are multicast to --groupaddr, repeated requests of
+ * the same trickle are dropped by the server, and receivers that lost a
+ * continuation are repaired by unicast. Without it every receiver is an
+ * independent unicast client and the uplink carries N copies.
+ *
+ * Receivers join at random times within --join seconds. --loss drops
+ * packets on the LAN side of every receiver.
+ *
+ * Prints the bytes sent through the uplink, the goodput of every
+ * receiver and, in the group mode, the group, aggregated and repair
+ * request counters of the server.
+ */
+
+#include <iostream>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesMulticast");
+
+static uint64_t g_uplinkBytes = 0;
+
+static void
+UplinkTx (Ptr<const Packet> p)
+{
+    g_uplinkBytes += p->GetSize ();
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t receivers = 8;
+    bool group = true;
+    std::string groupaddr = "225.1.2.4";
+    std::string uplink = "10Mbps";
+    std::string lan = "100Mbps";
+    uint32_t delay = 10; // One-way delay of the uplink (in milliseconds)
+    double loss = 0;
+    double join = 1;
+    uint32_t duration = 20;
+
+    CommandLine cmd;
+    cmd.AddValue ("receivers", "Number of receivers", receivers);
+    cmd.AddValue ("group", "Deliver one continuation stream by multicast", group);
+    cmd.AddValue ("groupaddr", "Multicast group address", groupaddr);
+    cmd.AddValue ("uplink", "Bandwidth of the server uplink", uplink);
+    cmd.AddValue ("lan", "Bandwidth of the receiver LAN", lan);
+    cmd.AddValue ("delay", "Delay of the uplink in milliseconds", delay);
+    cmd.AddValue ("loss", "Packet loss rate at every receiver", loss);
+    cmd.AddValue ("join", "Receivers start within this many seconds", join);
+    cmd.AddValue ("duration", "Duration of the experiment", duration);
+    cmd.Parse (argc, argv);
+
+    NodeContainer server, router, clients;
+    server.Create (1);
+    router.Create (1);
+    clients.Create (receivers);
+    InternetStackHelper stack;
+    stack.InstallAll ();
+
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute ("DataRate", StringValue (uplink));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay)));
+    NetDeviceContainer up = p2p.Install (server.Get (0), router.Get (0));
+    CsmaHelper csma;
+    csma.SetChannelAttribute ("DataRate", StringValue (lan));
+    csma.SetChannelAttribute ("Delay", TimeValue (MicroSeconds (50)));
+    NodeContainer lanNodes (router, clients);
+    NetDeviceContainer lanDevs = csma.Install (lanNodes);
+    if (loss>0) {
+        for (uint32_t i = 1; i<lanDevs.GetN (); i++) {
+            Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+            em->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+            em->SetRate (loss);
+            lanDevs.Get (i)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+        }
+    }
+
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+    Ipv4InterfaceContainer upIf = ipv4.Assign (up);
+    ipv4.SetBase ("10.1.2.0", "255.255.255.0");
+    ipv4.Assign (lanDevs);
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+    // Group continuations leave the server through the uplink and are flooded to the LAN by the router
+    Ipv4Address groupIp (groupaddr.c_str ());
+    Ipv4StaticRoutingHelper multicast;
+    multicast.SetDefaultMulticastRoute (server.Get (0), up.Get (0));
+    multicast.AddMulticastRoute (router.Get (0), upIf.GetAddress (0), groupIp, up.Get (1), NetDeviceContainer (lanDevs.Get (0)));
+    up.Get (0)->TraceConnectWithoutContext ("MacTx", MakeCallback (&UplinkTx));
+
+    uint16_t port = 49000;
+    uint16_t groupPort = 49001;
+    Address groupAddress = InetSocketAddress (groupIp, groupPort);
+    TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+    if (group) servhelp.SetAttribute ("Group", AddressValue (groupAddress));
+    ApplicationContainer servApps = servhelp.Install (server.Get (0));
+    Address remote = InetSocketAddress (upIf.GetAddress (0), port);
+    TricklesSinkHelper sinkhelp (remote);
+    sinkhelp.SetAttribute ("Remote", AddressValue (remote));
+    sinkhelp.SetAttribute ("Greedy", BooleanValue (true));
+    if (group) sinkhelp.SetAttribute ("Group", AddressValue (groupAddress));
+    ApplicationContainer sinkApps = sinkhelp.Install (clients);
+    Ptr<UniformRandomVariable> start = CreateObject<UniformRandomVariable> ();
+    for (uint32_t i = 0; i<sinkApps.GetN (); i++) {
+        sinkApps.Get (i)->SetStartTime (Seconds (start->GetValue (0, join)));
+        sinkApps.Get (i)->SetStopTime (Seconds (duration));
+    }
+    servApps.Stop (Seconds (duration));
+
+    Simulator::Stop (Seconds (duration));
+    Simulator::Run ();
+
+    std::cout << (group?"Group":"Unicast") << " mode, " << receivers << " receivers" << std::endl;
+    std::cout << "Uplink (MB): " << g_uplinkBytes/1e6 << std::endl;
+    double total = 0, least = 0;
+    for (uint32_t i = 0; i<receivers; i++) {
+        double goodput = DynamicCast<TricklesSink> (sinkApps.Get (i))->GetTotalRx ()*8.0/duration/1e6;
+        std::cout << "Receiver " << i << " goodput (Mbps): " << goodput << std::endl;
+        total += goodput;
+        if (!i || (goodput<least)) least = goodput;
+    }
+    std::cout << "Mean goodput (Mbps): " << total/receivers << ", lowest " << least << std::endl;
+    if (group) {
+        Ptr<TricklesSocketBase> socket = DynamicCast<TricklesSocketBase> (DynamicCast<TricklesServer> (servApps.Get (0))->GetListeningSocket ());
+        std::cout << "Group requests: " << socket->GetGroupRequests ()
+                  << ", aggregated: " << socket->GetAggregatedRequests ()
+                  << ", repairs: " << socket->GetRepairRequests () << std::endl;
+    }
+
+    Simulator::Destroy ();
+    return 0;
+}
@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Multipath request striping between two multi-homed hosts.
+ *
+ * Network topology:
+ *
+ *            path A (--rateA, --delayA)
+ *          +----------------------------+
+ *   Client                                Server
+ *          +----------------------------+
+ *            path B (--rateB, --delayB, --lossB)
+ *
+ * The client connects to the server address on path A. With --multipath
+ * the server address on path B is added as a second path
+ * (TricklesSink::AddPath): requests are striped by the RTT and loss of
+ * every path, and each continuation comes back on the path of its
+ * request. Without it the transfer uses path A only.
+ *
+ * Prints the goodput and, in the multipath mode, the weight, RTT, loss
+ * estimate and request counts of every path.
+ */
+
+#include <iostream>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesMultipath");
+
+int main (int argc, char *argv[])
+{
+    bool multipath = true;
+    std::string rateA = "10Mbps";
+    std::string rateB = "5Mbps";
+    uint32_t delayA = 10; // One-way delays (in milliseconds)
+    uint32_t delayB = 40;
+    double lossB = 0;
+    uint32_t queue = 100;
+    uint32_t duration = 20;
+
+    CommandLine cmd;
+    cmd.AddValue ("multipath", "Stripe requests over both paths", multipath);
+    cmd.AddValue ("rateA", "Bandwidth of path A", rateA);
+    cmd.AddValue ("rateB", "Bandwidth of path B", rateB);
+    cmd.AddValue ("delayA", "Delay of path A in milliseconds", delayA);
+    cmd.AddValue ("delayB", "Delay of path B in milliseconds", delayB);
+    cmd.AddValue ("lossB", "Packet loss rate of path B", lossB);
+    cmd.AddValue ("queue", "Queue size of every device", queue);
+    cmd.AddValue ("duration", "Duration of the experiment", duration);
+    cmd.Parse (argc, argv);
+
+    Config::SetDefault ("ns3::DropTailQueue::MaxPackets", UintegerValue (queue));
+
+    NodeContainer nodes;
+    nodes.Create (2);
+    InternetStackHelper stack;
+    stack.Install (nodes);
+
+    PointToPointHelper p2p;
+    Ipv4AddressHelper ipv4;
+    p2p.SetDeviceAttribute ("DataRate", StringValue (rateA));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delayA)));
+    ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+    Ipv4InterfaceContainer ifA = ipv4.Assign (p2p.Install (nodes));
+    p2p.SetDeviceAttribute ("DataRate", StringValue (rateB));
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delayB)));
+    ipv4.SetBase ("10.1.2.0", "255.255.255.0");
+    NetDeviceContainer devB = p2p.Install (nodes);
+    Ipv4InterfaceContainer ifB = ipv4.Assign (devB);
+    if (lossB>0) {
+        for (uint32_t i = 0; i<devB.GetN (); i++) {
+            Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+            em->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+            em->SetRate (lossB);
+            devB.Get (i)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+        }
+    }
+
+    uint16_t port = 49000;
+    TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+    ApplicationContainer servApps = servhelp.Install (nodes.Get (1));
+    Address remote = InetSocketAddress (ifA.GetAddress (1), port);
+    TricklesSinkHelper sinkhelp (remote);
+    sinkhelp.SetAttribute ("Remote", AddressValue (remote));
+    sinkhelp.SetAttribute ("Greedy", BooleanValue (true));
+    ApplicationContainer sinkApps = sinkhelp.Install (nodes.Get (0));
+    Ptr<TricklesSink> sink = DynamicCast<TricklesSink> (sinkApps.Get (0));
+    if (multipath) sink->AddPath (InetSocketAddress (ifB.GetAddress (1), port));
+    servApps.Stop (Seconds (duration));
+    sinkApps.Stop (Seconds (duration));
+
+    Simulator::Stop (Seconds (duration));
+    Simulator::Run ();
+
+    std::cout << "Goodput (Mbps): " << sink->GetTotalRx ()*8.0/duration/1e6 << std::endl;
+    Ptr<TricklesSocketBase> socket = DynamicCast<TricklesSocketBase> (sink->GetSocket ());
+    for (uint32_t i = 0; i<socket->GetNPaths (); i++) {
+        std::cout << "Path " << char ('A'+i) << ": weight " << socket->GetPathWeight (i)
+                  << ", RTT " << socket->GetPathRtt (i).GetMilliSeconds () << " ms"
+                  << ", loss " << socket->GetPathLoss (i)
+                  << ", requests " << socket->GetPathSent (i)
+                  << ", continuations " << socket->GetPathReceived (i) << std::endl;
+    }
+
+    Simulator::Destroy ();
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/flow-monitor-module.h"
 #include "ns3/csma-helper.h"
 
 using namespace ns3;
@@ -21,6 +22,18 @@ int main(int argc, char *argv[])
     uint32_t delay = 200; // Delay of the link between nodes (in milliseconds)
     std::string tracename = "trace.tr";
     std::string protocol = "trickles";
+    std::string variant = "ns3::TricklesShieh";
+    bool pacing = false;
+    bool ecn = false;
+    bool hystart = false;
+    bool bytes = false;
+    bool greedy = false;
+    std::string content = "";
+    double service = 0; // Per-request server CPU cost (in microseconds)
+    uint32_t cores = 1;
+    std::string stats = "";
+    std::string flowmon = "";
+    std::string events = "";
     
     CommandLine cmd;
     cmd.AddValue("bandwidth", "Bandwidth between nodes N0 and N1", bandwidth0);
@@ -30,11 +43,24 @@ int main(int argc, char *argv[])
     cmd.AddValue("duration", "Duration of the experiment", duration);
     cmd.AddValue("trace", "Trace file name", tracename);
     cmd.AddValue("protocol", "Protocol name (trickles, reno, new reno)", protocol);
+    cmd.AddValue("variant", "Trickles socket type (ns3::TricklesShieh, ns3::TricklesCubic, ns3::TricklesLedbat)", variant);
+    cmd.AddValue("pacing", "Pace Trickles continuations at the server", pacing);
+    cmd.AddValue("ecn", "Use ECN with Trickles", ecn);
+    cmd.AddValue("hystart", "Leave Trickles slow start with HyStart", hystart);
+    cmd.AddValue("bytes", "Account the Trickles window in bytes", bytes);
+    cmd.AddValue("greedy", "Request as fast as the Trickles window allows instead of at 10Mbps", greedy);
+    cmd.AddValue("content", "Fetch object 1 from this directory of object files ('synthetic' for generated content) and verify it", content);
+    cmd.AddValue("service", "Mean per-segment CPU cost of the server in microseconds (0 answers instantly)", service);
+    cmd.AddValue("cores", "Number of server cores", cores);
+    cmd.AddValue("stats", "Write per-flow Trickles statistics to this CSV file instead of the ASCII trace", stats);
+    cmd.AddValue("flowmon", "Write FlowMonitor statistics to this XML file", flowmon);
+    cmd.AddValue("events", "Dump the Trickles event log to this file at the end (debug builds)", events);
     cmd.Parse(argc, argv);
     
     std::cout << "N0 (Server) --- "<< bandwidth0 << ", " << delay <<" ms --- N1 (Client)" << std::endl;
     std::cout << duration << " seconds" << std::endl;
     std::cout << "Protocol: " << protocol << std::endl;
+    if (protocol == "trickles") std::cout << "Variant: " << variant << std::endl;
     std::cout << "Output file: " << tracename << std::endl;
     
     /* Experiment configuration */
@@ -68,7 +94,11 @@ int main(int argc, char *argv[])
     if (protocol == "newreno") {
         Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpNewReno"));
     }
-    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue ("ns3::TricklesShieh")); // TricklesShieh by default
+    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue (variant)); // TricklesShieh by default
+    Config::SetDefault ("ns3::TricklesL4Protocol::Pacing", BooleanValue (pacing));
+    Config::SetDefault ("ns3::TricklesSocketBase::Ecn", BooleanValue (ecn));
+    Config::SetDefault ("ns3::TricklesShieh::HyStart", BooleanValue (hystart));
+    Config::SetDefault ("ns3::TricklesShieh::ByteCounting", BooleanValue (bytes));
     Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (5000));
     Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue ("10Mbps"));
     InternetStackHelper stack;
@@ -91,11 +121,40 @@ int main(int argc, char *argv[])
         sinkhelp.SetAttribute("PacketSize", StringValue("5000"));
         sinkhelp.SetAttribute("Remote", AddressValue(InetSocketAddress(Ipv4Address("10.0.0.1"), app_port)));
         sinkhelp.SetAttribute("DataRate", StringValue("10Mbps"));
+        sinkhelp.SetAttribute("Greedy", BooleanValue(greedy));
+        Ptr<TricklesObjectStore> store = 0;
+        if (content != "") {
+            store = CreateObject<TricklesObjectStore> ();
+            if (content == "synthetic") store->SetAttribute("SyntheticSize", UintegerValue(uint64_t(1) << 40));
+            else store->SetAttribute("Directory", StringValue(content));
+            sinkhelp.SetAttribute("Fetch", BooleanValue(true));
+            sinkhelp.SetAttribute("ObjectStore", PointerValue(store));
+        }
         sinkhelp.SetAttribute("StartTime", TimeValue(Seconds(0)));
         sinkhelp.SetAttribute("StopTime", TimeValue(Seconds(duration)));
         sinkApps = sinkhelp.Install(p2pNodes.Get(1));
         TricklesServerHelper servhelp = TricklesServerHelper(InetSocketAddress(Ipv4Address::GetAny(), app_port));
+        if (store) servhelp.SetAttribute("ObjectStore", PointerValue(store));
+        if (service>0) {
+            Ptr<ExponentialRandomVariable> cost = CreateObject<ExponentialRandomVariable> ();
+            cost->SetAttribute("Mean", DoubleValue(service*1e-6));
+            servhelp.SetAttribute("ServiceTime", PointerValue(cost));
+            servhelp.SetAttribute("Cores", UintegerValue(cores));
+        }
         servApps = servhelp.Install(p2pNodes.Get(0));
+    } else if (service>0) {
+        PacketSinkHelper sink ("ns3::TcpSocketFactory",
+                               InetSocketAddress (Ipv4Address::GetAny (), app_port));
+        sinkApps = sink.Install(p2pNodes.Get(1));
+        Ptr<ExponentialRandomVariable> cost = CreateObject<ExponentialRandomVariable> ();
+        cost->SetAttribute("Mean", DoubleValue(service*1e-6));
+        Ptr<ServedTcpServer> server = CreateObject<ServedTcpServer> ();
+        server->SetAttribute("Remote", AddressValue(InetSocketAddress(Ipv4Address("10.0.0.2"), app_port)));
+        server->SetAttribute("SegmentSize", UintegerValue(segment));
+        server->SetAttribute("ServiceTime", PointerValue(cost));
+        server->SetAttribute("Cores", UintegerValue(cores));
+        p2pNodes.Get(0)->AddApplication(server);
+        servApps.Add(server);
     } else {
         PacketSinkHelper sink ("ns3::TcpSocketFactory",
                                InetSocketAddress (Ipv4Address::GetAny (), app_port));
@@ -109,24 +168,44 @@ int main(int argc, char *argv[])
     sinkApps.Start(Seconds(0.0));
     
     /* Simulation. */
-    AsciiTraceHelper ascii;
-    Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream (tracename);
-    p2p.EnableAsciiAll (stream);
+    Ptr<TricklesStatsCollector> collector;
+    if ((protocol == "trickles") && (stats != "")) {
+        collector = CreateObject<TricklesStatsCollector> ();
+        collector->SetAttribute ("FileName", StringValue (stats));
+        collector->Install (p2pNodes.Get(1));
+    } else {
+        AsciiTraceHelper ascii;
+        Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream (tracename);
+        p2p.EnableAsciiAll (stream);
+    }
     
     /* Stop the simulation after x seconds. */
     uint32_t stopTime = duration;
     Simulator::Stop (Seconds (stopTime));
     /* Start and clean simulation. */
+    if (events != "") TricklesEventLog::DumpOnDestroy (events);
+    FlowMonitorHelper flowhelp;
+    if (flowmon != "") flowhelp.InstallAll ();
     Simulator::Run ();
+    if (flowmon != "") flowhelp.SerializeToXmlFile (flowmon, true, true);
     
     Simulator::Destroy ();
     
     if (protocol == "trickles") {
         Ptr<TricklesSink> sink1 = DynamicCast<TricklesSink> (sinkApps.Get (0));
         std::cout << "Total Bytes Received: " << sink1->GetTotalRx () << " (" << sink1->GetTotalRq() << " requested)"<< std::endl;
+        if (content != "") std::cout << "Corrupted chunks: " << sink1->GetCorrupted () << std::endl;
+        if (service>0) {
+            Ptr<TricklesServer> serv1 = DynamicCast<TricklesServer> (servApps.Get (0));
+            std::cout << "Server requests served: " << serv1->GetServed () << ", dropped: " << serv1->GetDropped () << ", queue delay mean " << serv1->GetMeanQueueDelay ().GetMicroSeconds () << "us max " << serv1->GetMaxQueueDelay ().GetMicroSeconds () << "us" << std::endl;
+        }
     } else {
         Ptr<PacketSink> sink1 = DynamicCast<PacketSink> (sinkApps.Get (0));
         std::cout << "Total Bytes Received: " << sink1->GetTotalRx () << std::endl;
+        if (service>0) {
+            Ptr<ServedTcpServer> serv1 = DynamicCast<ServedTcpServer> (servApps.Get (0));
+            std::cout << "Server segments served: " << serv1->GetServed () << ", dropped: " << serv1->GetDropped () << ", queue delay mean " << serv1->GetMeanQueueDelay ().GetMicroSeconds () << "us max " << serv1->GetMaxQueueDelay ().GetMicroSeconds () << "us" << std::endl;
+        }
     }
 
 }
@@ -0,0 +1,304 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Many-client scaling benchmark.
+ *
+ * Network topology:
+ *
+ *   Server --- bottleneck --- Router --- access --- Client 0..N-1
+ *  10.0.0.1                                        10.x.y.z
+ *
+ * With --protocol=trickles the server runs one TricklesServer and every
+ * client a TricklesSink. With --protocol=newreno the server runs one
+ * BulkSendApplication per client and every client a PacketSink.
+ *
+ * Server state bytes are the transport state of the server node: the sum of
+ * TricklesSocketBase::GetStateSize() over the Trickles sockets of the node,
+ * or for TCP the socket object plus the bytes held in its send and receive
+ * buffers. Packets in flight, queues and applications are not counted, so
+ * per-flow state shows up directly as growth with the number of clients.
+ * The state is sampled every StateInterval and the last and peak values are
+ * reported.
+ *
+ * The throughput of the simulator is reported as scheduler events (every
+ * event the simulator removes from its scheduler, see CountingScheduler) per
+ * wall-clock second.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <sys/time.h>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/tcp-newreno.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesScale");
+
+namespace {
+    uint64_t g_events = 0;
+    uint64_t g_serverState = 0;
+    uint64_t g_serverStatePeak = 0;
+}
+
+/*
+ * Map scheduler that counts the events removed for execution
+ */
+class CountingScheduler : public MapScheduler
+{
+public:
+    static TypeId GetTypeId (void);
+    virtual Event RemoveNext (void);
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CountingScheduler);
+
+TypeId
+CountingScheduler::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::CountingScheduler")
+    .SetParent<MapScheduler> ()
+    .AddConstructor<CountingScheduler> ()
+    ;
+    return tid;
+}
+
+Scheduler::Event
+CountingScheduler::RemoveNext (void)
+{
+    g_events++;
+    return MapScheduler::RemoveNext ();
+}
+
+namespace {
+    /*
+     * Transport state of node: Trickles sockets report it themselves, a TCP
+     * socket is the object and the data waiting in its buffers
+     */
+    uint64_t TransportState (Ptr<Node> node) {
+        uint64_t size = 0;
+        ObjectVectorValue sockets;
+        Ptr<TricklesL4Protocol> trickles = node->GetObject<TricklesL4Protocol> ();
+        if (trickles) {
+            trickles->GetAttribute ("SocketList", sockets);
+            for (ObjectVectorValue::Iterator i = sockets.Begin (); i != sockets.End (); i++) {
+                size += DynamicCast<TricklesSocketBase> (i->second)->GetStateSize ();
+            }
+        }
+        Ptr<TcpL4Protocol> tcp = node->GetObject<TcpL4Protocol> ();
+        if (tcp) {
+            tcp->GetAttribute ("SocketList", sockets);
+            for (ObjectVectorValue::Iterator i = sockets.Begin (); i != sockets.End (); i++) {
+                Ptr<TcpSocketBase> socket = DynamicCast<TcpSocketBase> (i->second);
+                UintegerValue sndBuf;
+                socket->GetAttribute ("SndBufSize", sndBuf);
+                size += sizeof (TcpNewReno)+(sndBuf.Get ()-socket->GetTxAvailable ())+socket->GetRxAvailable ();
+            }
+        }
+        return size;
+    }
+
+    void SampleState (Ptr<Node> node, Time interval) {
+        g_serverState = TransportState (node);
+        if (g_serverState>g_serverStatePeak) g_serverStatePeak = g_serverState;
+        Simulator::Schedule (interval, &SampleState, node, interval);
+    }
+
+    double WallClock () {
+        struct timeval tv;
+        gettimeofday (&tv, 0);
+        return tv.tv_sec+tv.tv_usec*1e-6;
+    }
+
+    double Percentile (const std::vector<double> &sorted, double q) {
+        if (sorted.empty ()) return 0;
+        size_t i = (size_t)(q*(sorted.size ()-1)+0.5);
+        return sorted[i];
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t clients = 10;
+    std::string protocol = "trickles";
+    std::string variant = "ns3::TricklesShieh";
+    std::string bottleneck = "100Mbps";
+    std::string access = "10Mbps";
+    uint32_t delay = 10; // One-way delay of each link (in milliseconds)
+    uint32_t queue = 100;
+    uint32_t segment = 1000;
+    uint32_t duration = 10;
+    std::string rate = "1Mbps"; // Per-client request rate (Trickles)
+    uint32_t packetSize = 5000; // Bytes a Trickles client requests at a time
+    double stateInterval = 0.1; // Server state sampling interval (in seconds)
+    bool greedy = false;
+    bool hystart = true;
+    std::string csv = "";
+
+    CommandLine cmd;
+    cmd.AddValue ("clients", "Number of clients", clients);
+    cmd.AddValue ("protocol", "Protocol name (trickles, newreno)", protocol);
+    cmd.AddValue ("variant", "Trickles socket type", variant);
+    cmd.AddValue ("bottleneck", "Bandwidth between the server and the router", bottleneck);
+    cmd.AddValue ("access", "Bandwidth of each client link", access);
+    cmd.AddValue ("delay", "Delay of every link in milliseconds", delay);
+    cmd.AddValue ("queue", "Queue size of every device", queue);
+    cmd.AddValue ("segsize", "Segment size", segment);
+    cmd.AddValue ("duration", "Duration of the experiment", duration);
+    cmd.AddValue ("rate", "Request rate of every Trickles client", rate);
+    cmd.AddValue ("packetsize", "Bytes every Trickles client requests at a time", packetSize);
+    cmd.AddValue ("stateinterval", "Server state sampling interval in seconds", stateInterval);
+    cmd.AddValue ("greedy", "Trickles clients request as fast as the window allows", greedy);
+    cmd.AddValue ("hystart", "Leave Trickles slow start with HyStart", hystart);
+    cmd.AddValue ("csv", "Append a result row to this CSV file", csv);
+    cmd.Parse (argc, argv);
+
+    Config::SetDefault ("ns3::DropTailQueue::MaxPackets", UintegerValue (queue));
+    Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TricklesSocket::SegmentSize", UintegerValue (segment));
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", StringValue ("ns3::TcpNewReno"));
+    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue (variant));
+    Config::SetDefault ("ns3::TricklesShieh::HyStart", BooleanValue (hystart));
+
+    ObjectFactory scheduler;
+    scheduler.SetTypeId (CountingScheduler::GetTypeId ());
+    Simulator::SetScheduler (scheduler);
+
+    double wallStart = WallClock ();
+
+    NodeContainer server, router, clientNodes;
+    server.Create (1);
+    router.Create (1);
+    clientNodes.Create (clients);
+
+    InternetStackHelper stack;
+    stack.Install (server);
+    stack.Install (router);
+    stack.Install (clientNodes);
+
+    PointToPointHelper p2p;
+    p2p.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delay)));
+    p2p.SetDeviceAttribute ("DataRate", StringValue (bottleneck));
+    NetDeviceContainer core = p2p.Install (server.Get (0), router.Get (0));
+
+    Ipv4AddressHelper ipv4;
+    ipv4.SetBase ("10.0.0.0", "255.255.255.252");
+    Ipv4InterfaceContainer coreIf = ipv4.Assign (core);
+    ipv4.NewNetwork ();
+
+    // Global routing does not scale to 10^5 nodes: static default routes only
+    Ipv4StaticRoutingHelper routing;
+    routing.GetStaticRouting (server.Get (0)->GetObject<Ipv4> ())->SetDefaultRoute (coreIf.GetAddress (1), 1);
+
+    p2p.SetDeviceAttribute ("DataRate", StringValue (access));
+    std::vector<Ipv4Address> clientAddr;
+    for (uint32_t i = 0; i<clients; i++) {
+        NetDeviceContainer link = p2p.Install (router.Get (0), clientNodes.Get (i));
+        Ipv4InterfaceContainer linkIf = ipv4.Assign (link);
+        ipv4.NewNetwork ();
+        routing.GetStaticRouting (clientNodes.Get (i)->GetObject<Ipv4> ())->SetDefaultRoute (linkIf.GetAddress (0), 1);
+        clientAddr.push_back (linkIf.GetAddress (1));
+    }
+
+    uint16_t port = 49000;
+    ApplicationContainer sinkApps, servApps;
+    if (protocol == "trickles") {
+        TricklesServerHelper servhelp (InetSocketAddress (Ipv4Address::GetAny (), port));
+        servApps = servhelp.Install (server.Get (0));
+        TricklesSinkHelper sinkhelp (InetSocketAddress (coreIf.GetAddress (0), port));
+        sinkhelp.SetAttribute ("PacketSize", UintegerValue (packetSize));
+        sinkhelp.SetAttribute ("Remote", AddressValue (InetSocketAddress (coreIf.GetAddress (0), port)));
+        sinkhelp.SetAttribute ("DataRate", StringValue (rate));
+        sinkhelp.SetAttribute ("Greedy", BooleanValue (greedy));
+        sinkApps = sinkhelp.Install (clientNodes);
+    } else {
+        PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+        sinkApps = sink.Install (clientNodes);
+        for (uint32_t i = 0; i<clients; i++) {
+            BulkSendHelper bulk ("ns3::TcpSocketFactory", InetSocketAddress (clientAddr[i], port));
+            servApps.Add (bulk.Install (server.Get (0)));
+        }
+    }
+    // Spread the starts so that the clients are not synchronized
+    Ptr<UniformRandomVariable> jitter = CreateObject<UniformRandomVariable> ();
+    for (uint32_t i = 0; i<sinkApps.GetN (); i++) {
+        sinkApps.Get (i)->SetStartTime (Seconds (jitter->GetValue (0, 0.1)));
+        sinkApps.Get (i)->SetStopTime (Seconds (duration));
+    }
+    servApps.Start (Seconds (0));
+    servApps.Stop (Seconds (duration));
+
+    Simulator::Schedule (Seconds (0), &SampleState, server.Get (0), Seconds (stateInterval));
+    Simulator::Stop (Seconds (duration));
+
+    double wallRun = WallClock ();
+    uint64_t setupEvents = g_events;
+    Simulator::Run ();
+    double wallEnd = WallClock ();
+    uint64_t events = g_events-setupEvents;
+
+    std::vector<double> goodput;
+    double total = 0;
+    for (uint32_t i = 0; i<sinkApps.GetN (); i++) {
+        double rx;
+        if (protocol == "trickles") rx = DynamicCast<TricklesSink> (sinkApps.Get (i))->GetTotalRx ();
+        else rx = DynamicCast<PacketSink> (sinkApps.Get (i))->GetTotalRx ();
+        goodput.push_back (rx*8.0/duration);
+        total += rx*8.0/duration;
+    }
+    std::sort (goodput.begin (), goodput.end ());
+    double sum = 0, sumsq = 0;
+    for (size_t i = 0; i<goodput.size (); i++) {
+        sum += goodput[i];
+        sumsq += goodput[i]*goodput[i];
+    }
+    double jain = sumsq>0?sum*sum/(goodput.size ()*sumsq):0;
+
+    std::cout << "Protocol: " << protocol << (protocol == "trickles"?" ("+variant+")":"") << std::endl;
+    std::cout << "Clients: " << clients << std::endl;
+    std::cout << "Server state bytes: " << g_serverState << " (peak " << g_serverStatePeak << ")" << std::endl;
+    std::cout << "Wall-clock: setup " << wallRun-wallStart << " s, run " << wallEnd-wallRun << " s" << std::endl;
+    std::cout << "Scheduler events: " << events << " (" << events/std::max (wallEnd-wallRun, 1e-6) << " per second)" << std::endl;
+    std::cout << "Aggregate goodput: " << total << " bps" << std::endl;
+    std::cout << "Per-flow goodput: min " << Percentile (goodput, 0) << " p10 " << Percentile (goodput, 0.1)
+              << " median " << Percentile (goodput, 0.5) << " p90 " << Percentile (goodput, 0.9)
+              << " max " << Percentile (goodput, 1) << " bps, Jain " << jain << std::endl;
+
+    if (csv != "") {
+        std::ifstream exists (csv.c_str ());
+        bool header = !exists.good ();
+        exists.close ();
+        std::ofstream out (csv.c_str (), std::ios::app);
+        if (header) out << "protocol,variant,clients,duration,packet_size,server_state,server_state_peak,setup_s,run_s,events,aggregate_bps,min_bps,p10_bps,median_bps,p90_bps,max_bps,jain" << std::endl;
+        out << protocol << "," << variant << "," << clients << "," << duration << "," << packetSize << ","
+            << g_serverState << "," << g_serverStatePeak << "," << wallRun-wallStart << "," << wallEnd-wallRun << ","
+            << events << "," << total << "," << Percentile (goodput, 0) << "," << Percentile (goodput, 0.1) << ","
+            << Percentile (goodput, 0.5) << "," << Percentile (goodput, 0.9) << "," << Percentile (goodput, 1) << "," << jain << std::endl;
+    }
+
+    Simulator::Destroy ();
+    return 0;
+}
@@ -0,0 +1,271 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include "ns3/address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/pointer.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "served-tcp-server.h"
+#include <algorithm>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("ServedTcpServer");
+NS_OBJECT_ENSURE_REGISTERED (ServedTcpServer);
+
+TypeId
+ServedTcpServer::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::ServedTcpServer")
+    .SetParent<Application> ()
+    .AddConstructor<ServedTcpServer> ()
+    .AddAttribute ("Remote", "The address of the destination (a PacketSink)",
+                   AddressValue (),
+                   MakeAddressAccessor (&ServedTcpServer::m_peer),
+                   MakeAddressChecker ())
+    .AddAttribute ("SegmentSize", "Size of the data written to the socket after one service",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&ServedTcpServer::m_segSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxBytes", "Total number of bytes to send (0 is unlimited)",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&ServedTcpServer::m_maxBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ServiceTime", "Per-segment CPU cost in seconds (segments are written instantly if not set)",
+                   PointerValue (),
+                   MakePointerAccessor (&ServedTcpServer::m_serviceTime),
+                   MakePointerChecker<RandomVariableStream> ())
+    .AddAttribute ("ServiceTimePerByte", "CPU cost added per byte of the segment",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&ServedTcpServer::m_perByte),
+                   MakeTimeChecker ())
+    .AddAttribute ("Cores", "Number of cores serving segments in parallel",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&ServedTcpServer::m_cores),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("QueueLimit", "Maximum number of segments waiting for a core (0 is unlimited)",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&ServedTcpServer::m_queueLimit),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddTraceSource ("QueueDelay", "Time a segment waited for a core",
+                     MakeTraceSourceAccessor (&ServedTcpServer::m_queueDelayTrace),
+                     "ns3::ServedTcpServer::TimeCallback")
+    .AddTraceSource ("Sojourn", "Time from the segment request to writing it to the socket",
+                     MakeTraceSourceAccessor (&ServedTcpServer::m_sojournTrace),
+                     "ns3::ServedTcpServer::TimeCallback")
+    .AddTraceSource ("Drop", "A segment request dropped because the queue is full",
+                     MakeTraceSourceAccessor (&ServedTcpServer::m_dropTrace),
+                     "ns3::Packet::TracedCallback")
+    ;
+    return tid;
+}
+
+ServedTcpServer::ServedTcpServer ()
+: m_socket (0),
+m_segSize (1000),
+m_maxBytes (0),
+m_totalTx (0),
+m_pending (0),
+m_requested (0),
+m_perByte (Seconds (0)),
+m_cores (1),
+m_queueLimit (1000),
+m_busy (0),
+m_served (0),
+m_dropped (0),
+m_totalWait (Seconds (0)),
+m_maxWait (Seconds (0))
+{
+    NS_LOG_FUNCTION (this);
+}
+
+ServedTcpServer::~ServedTcpServer ()
+{
+    NS_LOG_FUNCTION (this);
+}
+
+uint32_t ServedTcpServer::GetTotalTx () const
+{
+    return m_totalTx;
+}
+
+Ptr<Socket>
+ServedTcpServer::GetSocket (void) const
+{
+    return m_socket;
+}
+
+void ServedTcpServer::DoDispose (void)
+{
+    NS_LOG_FUNCTION (this);
+    CancelService ();
+    m_socket = 0;
+    m_serviceTime = 0;
+    Application::DoDispose ();
+}
+
+void ServedTcpServer::StartApplication (void)
+{
+    NS_LOG_FUNCTION (this);
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
+        m_socket->Bind ();
+        m_socket->Connect (m_peer);
+    }
+    m_socket->SetConnectCallback (MakeCallback (&ServedTcpServer::ConnectionSucceeded, this),
+                                  MakeNullCallback<void, Ptr<Socket> > ());
+    m_socket->SetSendCallback (MakeCallback (&ServedTcpServer::HandleSend, this));
+}
+
+void ServedTcpServer::ConnectionSucceeded (Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION (this << socket);
+    Enqueue ();
+}
+
+void ServedTcpServer::StopApplication (void)
+{
+    NS_LOG_FUNCTION (this);
+    // Сегменты, принятые в обработку, после остановки не записываются
+    CancelService ();
+    if (m_socket)
+    {
+        m_socket->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+        m_socket->Close ();
+    }
+}
+
+void ServedTcpServer::HandleSend (Ptr<Socket> socket, uint32_t available)
+{
+    NS_LOG_FUNCTION (this << socket << available);
+    Enqueue ();
+}
+
+void ServedTcpServer::Enqueue (void)
+{
+    while (true) {
+        uint32_t size = m_segSize;
+        if (m_maxBytes) size = std::min (size, m_maxBytes-m_requested);
+        // Место в буфере передачи зарезервировано за сегментами в обработке и в очереди
+        if (!size || (m_socket->GetTxAvailable ()<m_pending+size)) break;
+        if (!m_serviceTime) {
+            m_requested += size;
+            Respond (size);
+            continue;
+        }
+        if (m_queueLimit && (m_queue.size ()>=m_queueLimit)) {
+            NS_LOG_LOGIC ("Segment queue overflow, dropping");
+            m_dropped++;
+            m_dropTrace (Create<Packet> (size));
+            break;
+        }
+        Request r;
+        r.size = size;
+        r.arrival = Simulator::Now ();
+        m_queue.push_back (r);
+        m_pending += size;
+        m_requested += size;
+    }
+    StartService ();
+}
+
+void ServedTcpServer::StartService (void)
+{
+    while ((m_busy<m_cores) && !m_queue.empty ()) {
+        Request r = m_queue.front ();
+        m_queue.pop_front ();
+        Time wait = Simulator::Now ()-r.arrival;
+        m_totalWait += wait;
+        if (wait>m_maxWait) m_maxWait = wait;
+        m_queueDelayTrace (wait);
+        double service = m_serviceTime->GetValue ();
+        if (service<0) service = 0;
+        Time cost = Seconds (service)+m_perByte*r.size;
+        m_busy++;
+        m_inService.push_back (Simulator::Schedule (cost, &ServedTcpServer::FinishService, this, r));
+    }
+}
+
+void ServedTcpServer::FinishService (Request r)
+{
+    for (std::list<EventId>::iterator i = m_inService.begin (); i != m_inService.end (); ) {
+        if (i->IsExpired ()) i = m_inService.erase (i);
+        else i++;
+    }
+    m_busy--;
+    m_served++;
+    m_pending -= r.size;
+    m_sojournTrace (Simulator::Now ()-r.arrival);
+    Respond (r.size);
+    Enqueue ();
+}
+
+void ServedTcpServer::Respond (uint32_t size)
+{
+    int sent = m_socket->Send (Create<Packet> (size));
+    if (sent>0) m_totalTx += sent;
+}
+
+void ServedTcpServer::CancelService (void)
+{
+    for (std::list<EventId>::iterator i = m_inService.begin (); i != m_inService.end (); i++) {
+        i->Cancel ();
+    }
+    m_inService.clear ();
+    m_queue.clear ();
+    // Незаписанные сегменты снова станут запросами при повторном запуске
+    m_requested -= m_pending;
+    m_pending = 0;
+    m_busy = 0;
+}
+
+uint32_t ServedTcpServer::GetServed () const
+{
+    return m_served;
+}
+
+uint32_t ServedTcpServer::GetDropped () const
+{
+    return m_dropped;
+}
+
+Time ServedTcpServer::GetMeanQueueDelay () const
+{
+    uint32_t started = m_served+m_busy;
+    return (started?m_totalWait/started:Time (0));
+}
+
+Time ServedTcpServer::GetMaxQueueDelay () const
+{
+    return m_maxWait;
+}
+
+uint32_t ServedTcpServer::GetQueueLength () const
+{
+    return m_busy+m_queue.size ();
+}
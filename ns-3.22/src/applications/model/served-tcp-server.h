@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef SERVED_TCP_SERVER_H
+#define SERVED_TCP_SERVER_H
+
+#include "ns3/application.h"
+#include "ns3/ptr.h"
+#include "ns3/address.h"
+#include "ns3/nstime.h"
+#include "ns3/socket.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/traced-callback.h"
+#include "ns3/packet.h"
+#include "ns3/event-id.h"
+#include <deque>
+#include <list>
+
+using namespace ns3;
+
+/** \ingroup tricklesapps
+ * \class ServedTcpServer
+ * \brief TCP-сервер с моделью процессора \ref TricklesServer
+ *
+ * Сервер соединяется с Remote (обычно ns3::PacketSink) и передает ему данные сегментами по SegmentSize байтов, пока не передано MaxBytes байтов (0 - без ограничения). Так протоколы Trickles и TCP сравниваются при одинаковой нагрузке на процессор сервера.
+ *
+ * Каждый сегмент - запрос к процессору с теми же атрибутами ServiceTime, ServiceTimePerByte, Cores и QueueLimit, что у \ref TricklesServer: сегмент занимает одно из ядер на время ServiceTime + ServiceTimePerByte * (размер сегмента) и после обслуживания записывается в сокет. Если ServiceTime не задан, сегменты записываются сразу. Запрос на сегмент появляется, когда в буфере передачи есть для него место, поэтому сервер не работает впрок. Если место в буфере есть, а очередь полна, запрос отбрасывается (источник трассировки Drop) и появляется снова при следующем освобождении буфера - так же, как клиент Trickles повторяет запрос, отброшенный \ref TricklesServer.
+ *
+ * Время ожидания, время пребывания и отброшенные запросы доступны через источники трассировки QueueDelay, Sojourn и Drop и методы с теми же именами, что у \ref TricklesServer.
+ */
+class ServedTcpServer : public Application
+{
+public:
+    static TypeId GetTypeId (void);
+    ServedTcpServer ();
+    virtual ~ServedTcpServer ();
+
+    /**
+     * \brief Сигнатура трассировок QueueDelay и Sojourn
+     */
+    typedef void (* TimeCallback)(Time delay);
+
+    /**
+     * \brief Количество байтов, записанных в сокет
+     */
+    uint32_t GetTotalTx () const;
+    Ptr<Socket> GetSocket (void) const;
+    /**
+     * \brief Число обслуженных сегментов
+     */
+    uint32_t GetServed () const;
+    /**
+     * \brief Число запросов на сегменты, отброшенных из-за переполнения очереди
+     */
+    uint32_t GetDropped () const;
+    /**
+     * \brief Среднее время ожидания ядра
+     */
+    Time GetMeanQueueDelay () const;
+    /**
+     * \brief Максимальное время ожидания ядра
+     */
+    Time GetMaxQueueDelay () const;
+    /**
+     * \brief Число сегментов в обработке и в очереди к ядрам
+     */
+    uint32_t GetQueueLength () const;
+protected:
+    virtual void DoDispose (void);
+private:
+    virtual void StartApplication (void);
+    virtual void StopApplication (void);
+    /**
+     * \brief Соединение установлено: запрашиваются первые сегменты
+     */
+    void ConnectionSucceeded (Ptr<Socket> socket);
+    /**
+     * \brief В буфере передачи освободилось место
+     */
+    void HandleSend (Ptr<Socket> socket, uint32_t available);
+    /**
+     * \brief Запрос на сегмент, ожидающий обслуживания
+     */
+    struct Request {
+        uint32_t size;
+        Time arrival;
+    };
+    /**
+     * \brief Постановка в очередь запросов на сегменты, для которых есть место в буфере передачи
+     */
+    void Enqueue (void);
+    /**
+     * \brief Передача запросов из очереди свободным ядрам
+     */
+    void StartService (void);
+    /**
+     * \brief Завершение обслуживания запроса r
+     */
+    void FinishService (Request r);
+    /**
+     * \brief Запись сегмента в сокет
+     */
+    void Respond (uint32_t size);
+    /**
+     * \brief Отмена обслуживания всех сегментов: очередь очищается, занятые ядра освобождаются
+     */
+    void CancelService (void);
+
+    Ptr<Socket> m_socket;
+    Address m_peer;
+    uint32_t m_segSize;
+    uint32_t m_maxBytes;
+    uint32_t m_totalTx;
+    /**
+     * \brief Байты сегментов в обработке и в очереди (еще не записанные в сокет) и всех запрошенных сегментов
+     */
+    uint32_t m_pending;
+    uint32_t m_requested;
+    /**
+     * \brief Распределение времени обработки сегмента, в секундах
+     */
+    Ptr<RandomVariableStream> m_serviceTime;
+    Time m_perByte;
+    uint32_t m_cores;
+    uint32_t m_queueLimit;
+    std::deque<Request> m_queue;
+    uint32_t m_busy;
+    /**
+     * \brief События завершения обслуживания сегментов, занимающих ядра
+     */
+    std::list<EventId> m_inService;
+    uint32_t m_served;
+    uint32_t m_dropped;
+    /**
+     * \brief Суммарное и максимальное время ожидания ядра
+     */
+    Time m_totalWait;
+    Time m_maxWait;
+    TracedCallback<Time> m_queueDelayTrace;
+    TracedCallback<Time> m_sojournTrace;
+    TracedCallback<Ptr<const Packet> > m_dropTrace;
+};
+
+#endif
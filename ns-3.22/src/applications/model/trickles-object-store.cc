@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include <sstream>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ns3/log.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "trickles-object-store.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TricklesObjectStore");
+NS_OBJECT_ENSURE_REGISTERED (TricklesObjectStore);
+
+TypeId
+TricklesObjectStore::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::TricklesObjectStore")
+    .SetParent<Object> ()
+    .AddConstructor<TricklesObjectStore> ()
+    .AddAttribute ("Directory", "Directory with object files named by object id",
+                   StringValue (""),
+                   MakeStringAccessor (&TricklesObjectStore::m_directory),
+                   MakeStringChecker ())
+    .AddAttribute ("SyntheticSize", "Size of generated objects for ids without a file (0 disables generation)",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TricklesObjectStore::m_syntheticSize),
+                   MakeUintegerChecker<uint64_t> ())
+    ;
+    return tid;
+}
+
+TricklesObjectStore::TricklesObjectStore ()
+: m_directory (""),
+m_syntheticSize (0)
+{
+    NS_LOG_FUNCTION (this);
+}
+
+TricklesObjectStore::~TricklesObjectStore ()
+{
+    NS_LOG_FUNCTION (this);
+    // Хранилище, которое не было уничтожено через Dispose
+    Unmap();
+}
+
+void TricklesObjectStore::DoDispose (void)
+{
+    NS_LOG_FUNCTION (this);
+    Unmap();
+    m_scratch.clear();
+    Object::DoDispose ();
+}
+
+void TricklesObjectStore::Unmap (void)
+{
+    for (std::map<uint32_t, Mapping>::iterator i = m_mappings.begin(); i != m_mappings.end(); i++) {
+        if (i->second.data) munmap((void *)i->second.data, i->second.size);
+    }
+    m_mappings.clear();
+}
+
+const TricklesObjectStore::Mapping &TricklesObjectStore::Map (uint32_t id)
+{
+    std::map<uint32_t, Mapping>::iterator i = m_mappings.find(id);
+    if (i != m_mappings.end()) return(i->second);
+    Mapping m;
+    m.data = 0;
+    m.size = 0;
+    if (!m_directory.empty()) {
+        std::ostringstream name;
+        name << m_directory << "/" << id;
+        int fd = open(name.str().c_str(), O_RDONLY);
+        struct stat st;
+        if ((fd>=0) && !fstat(fd, &st) && (st.st_size>0)) {
+            void *data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, st.st_size, MADV_SEQUENTIAL);
+                m.data = (const uint8_t *)data;
+                m.size = st.st_size;
+                NS_LOG_INFO("Mapped " << name.str() << " (" << m.size << " bytes)");
+            }
+        }
+        // Отображение не зависит от дескриптора
+        if (fd>=0) close(fd);
+    }
+    // Отсутствие файла тоже запоминается, чтобы не искать его при каждом запросе
+    return(m_mappings[id] = m);
+}
+
+void TricklesObjectStore::Generate (uint32_t id, uint64_t offset, uint8_t *buffer, uint32_t size)
+{
+    for (uint32_t i = 0; i<size; ) {
+        uint64_t pos = offset+i;
+        // Слово splitmix64 от номера объекта и номера 8-байтового слова
+        uint64_t x = (((uint64_t)id)<<40)^(pos>>3);
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x^(x>>30))*0xbf58476d1ce4e5b9ULL;
+        x = (x^(x>>27))*0x94d049bb133111ebULL;
+        x ^= x>>31;
+        for (uint32_t b = pos & 7; (b<8) && (i<size); b++, i++) {
+            buffer[i] = (uint8_t)(x>>(8*b));
+        }
+    }
+}
+
+uint64_t TricklesObjectStore::GetObjectSize (uint32_t id)
+{
+    const Mapping &m = Map(id);
+    return(m.data?m.size:m_syntheticSize);
+}
+
+const uint8_t *TricklesObjectStore::Locate (uint32_t id, uint64_t offset, uint32_t &size)
+{
+    const Mapping &m = Map(id);
+    uint64_t objectSize = m.data?m.size:m_syntheticSize;
+    if (offset>=objectSize) {
+        size = 0;
+        return(0);
+    }
+    if (size>objectSize-offset) size = objectSize-offset;
+    if (m.data) return(m.data+offset);
+    if (m_scratch.size()<size) m_scratch.resize(size);
+    Generate(id, offset, &m_scratch[0], size);
+    return(&m_scratch[0]);
+}
+
+Ptr<Packet> TricklesObjectStore::GetData (uint32_t id, uint64_t offset, uint32_t size)
+{
+    NS_LOG_FUNCTION (this << id << offset << size);
+    const uint8_t *data = Locate(id, offset, size);
+    if (!data) return(0);
+    // Единственное копирование - из отображенных страниц в буфер пакета
+    return(Create<Packet>(data, size));
+}
+
+bool TricklesObjectStore::Verify (uint32_t id, uint64_t offset, Ptr<const Packet> data)
+{
+    uint32_t size = data->GetSize();
+    if (!size) return(false);
+    uint32_t expected = size;
+    const uint8_t *stored = Locate(id, offset, expected);
+    if (!stored || (expected != size)) return(false);
+    std::vector<uint8_t> received(size);
+    data->CopyData(&received[0], size);
+    return(!memcmp(&received[0], stored, size));
+}
@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef TRICKLES_OBJECT_STORE_H
+#define TRICKLES_OBJECT_STORE_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup tricklesapps
+ * \class TricklesObjectStore
+ * \brief Хранилище объектов, которые отдает \ref TricklesServer
+ *
+ * Объект с идентификатором id - это файл с именем id в каталоге Directory. Файл отображается в память (mmap) при первом обращении и остается отображенным до уничтожения хранилища, поэтому ответ на запрос строится прямо из страниц файла без промежуточного чтения, а размер объекта ограничен только адресным пространством.
+ *
+ * Если файла нет, а SyntheticSize не равен нулю, объект генерируется: каждый его байт - функция идентификатора и смещения. Такие объекты не занимают памяти и файлов и годятся для загрузок любого размера.
+ *
+ * Клиент, имеющий то же хранилище, проверяет полученные данные методом #Verify.
+ */
+class TricklesObjectStore : public Object
+{
+public:
+    static TypeId GetTypeId (void);
+    TricklesObjectStore ();
+    virtual ~TricklesObjectStore ();
+
+    /**
+     * \brief Размер объекта id; 0, если объекта нет
+     */
+    uint64_t GetObjectSize (uint32_t id);
+    /**
+     * \brief Данные объекта id со смещения offset
+     *
+     * Возвращается не больше size байтов: ответ обрезается по концу объекта. Если объекта нет или offset за его концом, возвращается 0.
+     */
+    Ptr<Packet> GetData (uint32_t id, uint64_t offset, uint32_t size);
+    /**
+     * \brief Совпадает ли data с содержимым объекта id со смещения offset
+     *
+     * Полученные данные сравниваются с хранимыми побайтно.
+     */
+    bool Verify (uint32_t id, uint64_t offset, Ptr<const Packet> data);
+protected:
+    virtual void DoDispose (void);
+private:
+    /**
+     * \brief Отображенный в память файл объекта
+     */
+    struct Mapping {
+        const uint8_t *data;
+        uint64_t size;
+    };
+    /**
+     * \brief Снять отображение всех файлов
+     */
+    void Unmap (void);
+    /**
+     * \brief Отобразить файл объекта id; data равно 0, если файла нет
+     */
+    const Mapping &Map (uint32_t id);
+    /**
+     * \brief Заполнить buffer содержимым синтетического объекта id со смещения offset
+     */
+    static void Generate (uint32_t id, uint64_t offset, uint8_t *buffer, uint32_t size);
+    /**
+     * \brief Указатель на size байтов объекта id со смещения offset; 0, если данных нет
+     *
+     * Для синтетических объектов данные генерируются в m_scratch.
+     */
+    const uint8_t *Locate (uint32_t id, uint64_t offset, uint32_t &size);
+
+    /**
+     * \brief Каталог с файлами объектов
+     */
+    std::string m_directory;
+    /**
+     * \brief Размер синтетических объектов; 0 - только файлы
+     */
+    uint64_t m_syntheticSize;
+    /**
+     * \brief Отображенные файлы по идентификатору объекта
+     */
+    std::map<uint32_t, Mapping> m_mappings;
+    /**
+     * \brief Буфер для синтетических данных
+     */
+    std::vector<uint8_t> m_scratch;
+};
+
+#endif
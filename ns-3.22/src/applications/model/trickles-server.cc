@@ -26,6 +26,7 @@
 #include "ns3/node.h"
 #include "ns3/socket.h"
 #include "ns3/trickles-socket.h"
+#include "ns3/trickles-socket-base.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
@@ -34,6 +35,10 @@
 #include "ns3/trickles-header.h"
 #include "trickles-appcont.h"
 #include "trickles-server.h"
+#include "trickles-object-store.h"
+#include "ns3/pointer.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
 #include "ns3/trickles-shieh-header.h"
 
 
@@ -52,6 +57,39 @@ TricklesServer::GetTypeId (void)
                    AddressValue (),
                    MakeAddressAccessor (&TricklesServer::m_local),
                    MakeAddressChecker ())
+    .AddAttribute ("ServiceTime", "Per-request CPU cost in seconds (requests are answered instantly if not set)",
+                   PointerValue (),
+                   MakePointerAccessor (&TricklesServer::m_serviceTime),
+                   MakePointerChecker<RandomVariableStream> ())
+    .AddAttribute ("ServiceTimePerByte", "CPU cost added per requested byte",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&TricklesServer::m_perByte),
+                   MakeTimeChecker ())
+    .AddAttribute ("Cores", "Number of cores serving requests in parallel",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&TricklesServer::m_cores),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("QueueLimit", "Maximum number of requests waiting for a core (0 is unlimited)",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&TricklesServer::m_queueLimit),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddTraceSource ("QueueDelay", "Time a request waited for a core",
+                     MakeTraceSourceAccessor (&TricklesServer::m_queueDelayTrace),
+                     "ns3::TricklesServer::TimeCallback")
+    .AddTraceSource ("Sojourn", "Time from the request arrival to the response",
+                     MakeTraceSourceAccessor (&TricklesServer::m_sojournTrace),
+                     "ns3::TricklesServer::TimeCallback")
+    .AddTraceSource ("Drop", "A request dropped because the queue is full",
+                     MakeTraceSourceAccessor (&TricklesServer::m_dropTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddAttribute ("ObjectStore", "Store the content of RequestRange fetches is served from (zero-filled data if not set)",
+                   PointerValue (),
+                   MakePointerAccessor (&TricklesServer::m_store),
+                   MakePointerChecker<TricklesObjectStore> ())
+    .AddAttribute ("Group", "Multicast address and port continuations of group requests are sent to (group mode is off if not set)",
+                   AddressValue (),
+                   MakeAddressAccessor (&TricklesServer::m_group),
+                   MakeAddressChecker ())
 //    .AddAttribute ("Protocol", "The type id of the protocol to use for the rx socket.",
 //                   TypeIdValue (TricklesSocketFactory::GetTypeId ()),
 //                   MakeTypeIdAccessor (&TricklesServer::m_tid),
@@ -65,6 +103,14 @@ TricklesServer::TricklesServer ()
     NS_LOG_FUNCTION (this);
     m_socket = 0;
     m_totalTx = 0;
+    m_perByte = Seconds(0);
+    m_cores = 1;
+    m_queueLimit = 1000;
+    m_busy = 0;
+    m_served = 0;
+    m_dropped = 0;
+    m_totalWait = Seconds(0);
+    m_maxWait = Seconds(0);
 }
 
 TricklesServer::~TricklesServer()
@@ -97,6 +143,9 @@ void TricklesServer::DoDispose (void)
     NS_LOG_FUNCTION (this);
     m_socket = 0;
     m_socketList.clear ();
+    m_store = 0;
+    CancelService ();
+    m_serviceTime = 0;
     
     // chain up
     Application::DoDispose ();
@@ -113,7 +162,9 @@ void TricklesServer::StartApplication ()    // Called at time specified by Start
         m_socket = Socket::CreateSocket (GetNode (), m_tid);
         m_socket->Bind(m_local);
         m_socket->Listen();
-        
+        if (!m_group.IsInvalid() && (DynamicCast<TricklesSocketBase> (m_socket)->SetGroup(m_group) != 0)) {
+            NS_LOG_WARN("Group mode not enabled: " << m_socket->GetErrno());
+        }
     }
     
     
@@ -137,6 +188,8 @@ void TricklesServer::StopApplication ()     // Called at time specified by Stop
         m_socket->Close ();
         m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
     }
+    // Ответы на принятые запросы после остановки не отправляются
+    CancelService ();
 }
 
 void TricklesServer::HandleRead (Ptr<Socket> socket)
@@ -157,17 +210,123 @@ void TricklesServer::HandleRead (Ptr<Socket> socket)
         NS_LOG_DEBUG(" ");
         // LOG_TRICKLES_HEADER(tricklesHeader); std::clog << "\n";
         if (tricklesHeader.GetPacketType()==CONTINUATION) {
-            Ptr<Packet> data = Create<Packet>(tricklesHeader.GetRequestSize());
-            packet->AddAtEnd(data);
-            NS_LOG_DEBUG("Sending packet of size " << packet->GetSize() << " to " << InetSocketAddress::ConvertFrom (from).GetIpv4 ());
-            //LOG_TRICKLES_PACKET(packet);
-            //std::clog << " ";
-            //LOG_TRICKLES_SHIEH_PACKET_(packet);
-            //std::clog << "\n";
-            socket->SendTo(packet, 0, from);
-            m_totalTx += tricklesHeader.GetRequestSize();
+            if (m_serviceTime) Enqueue(socket, packet, from);
+            else Respond(socket, packet, from);
+        }
+    }
+}
+
+void TricklesServer::Respond (Ptr<Socket> socket, Ptr<Packet> packet, Address from)
+{
+    TricklesHeader tricklesHeader;
+    packet->PeekHeader(tricklesHeader);
+    Ptr<Packet> data = 0;
+    // Для загрузок RequestRange данные берутся из хранилища объектов
+    if (m_store && tricklesHeader.HasObject()) {
+        data = m_store->GetData(tricklesHeader.GetObjectId(), tricklesHeader.GetObjectOffset(), tricklesHeader.GetRequestSize());
+        // Продолжение без данных все равно отправляется: оно несет состояние соединения
+        if (!data) {
+            NS_LOG_WARN("No data for object " << tricklesHeader.GetObjectId() << " at " << tricklesHeader.GetObjectOffset());
+            data = Create<Packet>();
         }
     }
+    if (!data) data = Create<Packet>(tricklesHeader.GetRequestSize());
+    packet->AddAtEnd(data);
+    NS_LOG_DEBUG("Sending packet of size " << packet->GetSize() << " to " << InetSocketAddress::ConvertFrom (from).GetIpv4 ());
+    //LOG_TRICKLES_PACKET(packet);
+    //std::clog << " ";
+    //LOG_TRICKLES_SHIEH_PACKET_(packet);
+    //std::clog << "\n";
+    socket->SendTo(packet, 0, from);
+    m_totalTx += data->GetSize();
+}
+
+void TricklesServer::Enqueue (Ptr<Socket> socket, Ptr<Packet> packet, Address from)
+{
+    if (m_queueLimit && (m_queue.size()>=m_queueLimit)) {
+        // Запрос теряется так же, как потерянный в сети: клиент восстановится по SACK или тайм-ауту
+        NS_LOG_LOGIC("Request queue overflow, dropping");
+        m_dropped++;
+        m_dropTrace(packet);
+        return;
+    }
+    Request r;
+    r.socket = socket;
+    r.packet = packet;
+    r.from = from;
+    r.arrival = Simulator::Now();
+    m_queue.push_back(r);
+    StartService();
+}
+
+void TricklesServer::StartService (void)
+{
+    while ((m_busy<m_cores) && !m_queue.empty()) {
+        Request r = m_queue.front();
+        m_queue.pop_front();
+        Time wait = Simulator::Now()-r.arrival;
+        m_totalWait += wait;
+        if (wait>m_maxWait) m_maxWait = wait;
+        m_queueDelayTrace(wait);
+        TricklesHeader tricklesHeader;
+        r.packet->PeekHeader(tricklesHeader);
+        // Распределение с отрицательными значениями (например, нормальное) не должно планировать событие в прошлом
+        double service = m_serviceTime->GetValue();
+        if (service<0) service = 0;
+        Time cost = Seconds(service)+m_perByte*tricklesHeader.GetRequestSize();
+        m_busy++;
+        m_inService.push_back(Simulator::Schedule(cost, &TricklesServer::FinishService, this, r));
+    }
+}
+
+void TricklesServer::FinishService (Request r)
+{
+    // Текущее событие уже считается истекшим и удаляется вместе с прочими завершенными
+    for (std::list<EventId>::iterator i = m_inService.begin(); i != m_inService.end(); ) {
+        if (i->IsExpired()) i = m_inService.erase(i);
+        else i++;
+    }
+    m_busy--;
+    m_served++;
+    m_sojournTrace(Simulator::Now()-r.arrival);
+    Respond(r.socket, r.packet, r.from);
+    StartService();
+}
+
+void TricklesServer::CancelService (void)
+{
+    for (std::list<EventId>::iterator i = m_inService.begin(); i != m_inService.end(); i++) {
+        i->Cancel();
+    }
+    m_inService.clear();
+    m_queue.clear();
+    m_busy = 0;
+}
+
+uint32_t TricklesServer::GetServed () const
+{
+    return m_served;
+}
+
+uint32_t TricklesServer::GetDropped () const
+{
+    return m_dropped;
+}
+
+Time TricklesServer::GetMeanQueueDelay () const
+{
+    uint32_t started = m_served+m_busy;
+    return (started?m_totalWait/started:Time(0));
+}
+
+Time TricklesServer::GetMaxQueueDelay () const
+{
+    return m_maxWait;
+}
+
+uint32_t TricklesServer::GetQueueLength () const
+{
+    return m_busy+m_queue.size ();
 }
 
 void TricklesServer::HandlePeerError (Ptr<Socket> socket)
@@ -24,6 +24,14 @@
 #include "ns3/application.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/traced-callback.h"
+#include "ns3/packet.h"
+#include "ns3/event-id.h"
+#include <deque>
+#include <list>
+#include "trickles-object-store.h"
 
 using namespace ns3;
 
@@ -44,7 +52,13 @@ using namespace ns3;
  *
  * Сервер не хранит никаких данных о состоянии приложения и обрабатывает запросы по мере их поступления.
  *
+ * Если задано хранилище \ref TricklesObjectStore (атрибут ObjectStore), то на запросы загрузок ns3::TricklesSocketBase::RequestRange сервер отвечает содержимым запрошенного объекта с указанного смещения. Ответ обрезается по концу объекта, а на запрос несуществующего объекта или смещения за его концом приходит продолжение без данных, по которому клиент узнает, что объект кончился. Остальные запросы, как и прежде, получают данные, заполненные нулями.
+ *
  * Существенная часть функциональности сервера реализуется методом #HandleRead.
+ *
+ * Если задан атрибут Group (групповой адрес и порт), сервер работает в групповом режиме (ns3::TricklesSocketBase::SetGroup): продолжения потока группы рассылаются всем клиентам-участникам, повторные запросы отбрасываются протоколом и до приложения не доходят.
+ *
+ * Если задан атрибут ServiceTime, моделируется процессор сервера: каждый запрос занимает одно из Cores ядер на время ServiceTime + ServiceTimePerByte * (размер запроса) (отрицательное значение ServiceTime считается нулем), а запросы, для которых нет свободного ядра, ждут в очереди длиной не более QueueLimit. Запросы, не поместившиеся в очередь, отбрасываются. Время ожидания, время пребывания и отброшенные запросы доступны через источники трассировки QueueDelay, Sojourn и Drop, а также через #GetServed, #GetDropped, #GetMeanQueueDelay и #GetMaxQueueDelay.
  */
 class TricklesServer : public Application
 {
@@ -54,6 +68,11 @@ public:
     
     virtual ~TricklesServer ();
     
+    /**
+     * \brief Сигнатура трассировок QueueDelay и Sojourn
+     */
+    typedef void (* TimeCallback)(Time delay);
+    
     /**
      * \brief Возврат количества переданных байтов
      *
@@ -71,6 +90,26 @@ public:
      * Функция возвращает список активных сокетов
      */
     std::list<Ptr<Socket> > GetAcceptedSockets (void) const;
+    /**
+     * \brief Число обслуженных запросов в модели процессора
+     */
+    uint32_t GetServed () const;
+    /**
+     * \brief Число запросов, отброшенных из-за переполнения очереди
+     */
+    uint32_t GetDropped () const;
+    /**
+     * \brief Среднее время ожидания ядра
+     */
+    Time GetMeanQueueDelay () const;
+    /**
+     * \brief Максимальное время ожидания ядра
+     */
+    Time GetMaxQueueDelay () const;
+    /**
+     * \brief Число запросов в обработке и в очереди к ядрам
+     */
+    uint32_t GetQueueLength () const;
 protected:
     /**
      * \brief Освобождение сокетов
@@ -120,6 +159,36 @@ private:
      */
     void HandlePeerError (Ptr<Socket>);
     
+    /**
+     * \brief Запрос, ожидающий обслуживания
+     */
+    struct Request {
+        Ptr<Socket> socket;
+        Ptr<Packet> packet;
+        Address from;
+        Time arrival;
+    };
+    /**
+     * \brief Ответ на запрос packet: к нему добавляются данные и он отправляется обратно
+     */
+    void Respond (Ptr<Socket> socket, Ptr<Packet> packet, Address from);
+    /**
+     * \brief Постановка запроса в очередь к процессору
+     */
+    void Enqueue (Ptr<Socket> socket, Ptr<Packet> packet, Address from);
+    /**
+     * \brief Передача запросов из очереди свободным ядрам
+     */
+    void StartService (void);
+    /**
+     * \brief Завершение обслуживания запроса r
+     */
+    void FinishService (Request r);
+    /**
+     * \brief Отмена обслуживания всех запросов: очередь очищается, занятые ядра освобождаются
+     */
+    void CancelService (void);
+    
     /**
      * \brief Указатель на слушающий сокет
      */
@@ -138,6 +207,52 @@ private:
      * Повторно переданные данные учитываются повторно.
      */
     uint32_t        m_totalTx;
+    /**
+     * \brief Хранилище объектов для загрузок RequestRange
+     */
+    Ptr<TricklesObjectStore> m_store;
+    /**
+     * \brief Групповой адрес продолжений (см. ns3::TricklesSocketBase::SetGroup)
+     */
+    Address m_group;
+    /**
+     * \brief Распределение времени обработки запроса, в секундах
+     */
+    Ptr<RandomVariableStream> m_serviceTime;
+    /**
+     * \brief Время обработки одного запрошенного байта
+     */
+    Time            m_perByte;
+    /**
+     * \brief Число ядер
+     */
+    uint32_t        m_cores;
+    /**
+     * \brief Предельная длина очереди
+     */
+    uint32_t        m_queueLimit;
+    /**
+     * \brief Очередь запросов к процессору
+     */
+    std::deque<Request> m_queue;
+    /**
+     * \brief Число занятых ядер
+     */
+    uint32_t        m_busy;
+    /**
+     * \brief События завершения обслуживания запросов, занимающих ядра
+     */
+    std::list<EventId> m_inService;
+    uint32_t        m_served;
+    uint32_t        m_dropped;
+    /**
+     * \brief Суммарное и максимальное время ожидания ядра
+     */
+    Time            m_totalWait;
+    Time            m_maxWait;
+    TracedCallback<Time> m_queueDelayTrace;
+    TracedCallback<Time> m_sojournTrace;
+    TracedCallback<Ptr<const Packet> > m_dropTrace;
 };
 
 #endif
\ No newline at end of file
@@ -27,6 +27,7 @@
 #include "ns3/stats-module.h"
 #include "trickles-appcont.h"
 #include "trickles-sink.h"
+#include "trickles-object-store.h"
 
 
 using namespace ns3;
@@ -52,6 +53,30 @@ TricklesSink::GetTypeId (void)
                    DataRateValue(DataRate("100kb/s")),
                    MakeDataRateAccessor (&TricklesSink::m_dataRate),
                    MakeDataRateChecker ())
+    .AddAttribute ("Greedy", "Keep Outstanding bytes requested instead of requesting at DataRate",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TricklesSink::m_greedy),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Outstanding", "Amount of requested but not yet received data in the greedy mode",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&TricklesSink::m_outstanding),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Fetch", "Request consecutive ranges of object ObjectId with RequestRange instead of anonymous data",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TricklesSink::m_fetch),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ObjectId", "Object fetched in the Fetch mode",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&TricklesSink::m_objectId),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ObjectStore", "Store the fetched data is verified against (no verification if not set)",
+                   PointerValue (),
+                   MakePointerAccessor (&TricklesSink::m_store),
+                   MakePointerChecker<TricklesObjectStore> ())
+    .AddAttribute ("Group", "Multicast address and port of the server group stream to join (not a group member if not set)",
+                   AddressValue (),
+                   MakeAddressAccessor (&TricklesSink::m_group),
+                   MakeAddressChecker ())
     //    .AddAttribute ("Protocol", "The type id of the protocol to use for the rx socket.",
     //                   TypeIdValue (TricklesSocketFactory::GetTypeId ()),
     //                   MakeTypeIdAccessor (&TricklesSink::m_tid),
@@ -69,7 +94,13 @@ m_dataRate (0),
 m_sendEvent (),
 m_running (false),
 m_packetsSent (0),
-m_totalRx(0)
+m_totalRx(0),
+m_greedy(false),
+m_outstanding(65536),
+m_fetch(false),
+m_objectId(1),
+m_objectOffset(0),
+m_corrupted(0)
 {
     NS_LOG_FUNCTION (this);
 }
@@ -102,6 +133,11 @@ TricklesSink::StartApplication (void)
         {
             m_socket->Bind6 ();
         }
+        else if (InetSocketAddress::IsMatchingType (m_group))
+        {
+            // Продолжения группы приходят на порт группы
+            m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), InetSocketAddress::ConvertFrom (m_group).GetPort ()));
+        }
         else
         {
             m_socket->Bind ();
@@ -109,6 +145,28 @@ TricklesSink::StartApplication (void)
         m_socket->Connect (m_peer);
         m_socket->SetRecvCallback (MakeCallback (&TricklesSink::HandleRead, this));
     }
+    if (!m_replicas.empty()) {
+        Ptr<TricklesSocketBase> trickles = DynamicCast<TricklesSocketBase> (m_socket);
+        NS_ASSERT_MSG (trickles, "Replicas require a Trickles socket");
+        for (std::vector<Address>::const_iterator r = m_replicas.begin(); r != m_replicas.end(); r++) trickles->AddReplica (*r);
+    }
+    if (!m_group.IsInvalid()) {
+        Ptr<TricklesSocketBase> trickles = DynamicCast<TricklesSocketBase> (m_socket);
+        NS_ASSERT_MSG (trickles, "Group mode requires a Trickles socket");
+        if (trickles->SetGroup (m_group) != 0) NS_LOG_WARN ("Group " << m_group << " not joined: " << trickles->GetErrno ());
+    }
+    if (!m_paths.empty()) {
+        Ptr<TricklesSocketBase> trickles = DynamicCast<TricklesSocketBase> (m_socket);
+        NS_ASSERT_MSG (trickles, "Multipath mode requires a Trickles socket");
+        for (std::vector<Address>::const_iterator p = m_paths.begin(); p != m_paths.end(); p++) {
+            if (trickles->AddPath (*p) != 0) NS_LOG_WARN ("Path " << *p << " not added: " << trickles->GetErrno ());
+        }
+    }
+    if (m_fetch) {
+        Ptr<TricklesSocketBase> trickles = DynamicCast<TricklesSocketBase> (m_socket);
+        NS_ASSERT_MSG (trickles, "Fetch mode requires a Trickles socket");
+        trickles->SetObjectDataCallback (MakeCallback (&TricklesSink::HandleObjectData, this));
+    }
     GetData ();
 }
 
@@ -136,8 +194,11 @@ TricklesSink::GetData (void)
     NS_LOG_FUNCTION (this);
     
     if (m_socket->GetRxAvailable()>0) HandleRead(m_socket);
-    m_packetsSent += m_packetSize;
-    m_socket->Recv(m_packetSize, TricklesSocketBase::QUEUE_RECV);
+    if (m_greedy) {
+        TopUp ();
+        return;
+    }
+    Request (m_packetSize);
     ScheduleRq ();
 }
 
@@ -168,12 +229,67 @@ void TricklesSink::HandleRead (Ptr<Socket> socket)
         }
         m_totalRx += packet->GetSize ();
     }
+    if (m_greedy && m_running) TopUp ();
+}
+
+void
+TricklesSink::TopUp (void)
+{
+    NS_LOG_FUNCTION (this);
+    // Запросы без таймера: возмещаем прочитанные данные порциями m_packetSize
+    uint64_t requested = (m_packetsSent>m_totalRx)?(m_packetsSent-m_totalRx):0;
+    if (requested+m_packetSize>m_outstanding) return;
+    uint32_t size = (m_outstanding-requested)/m_packetSize*m_packetSize;
+    Request (size);
+}
+
+void
+TricklesSink::Request (uint32_t size)
+{
+    NS_LOG_FUNCTION (this << size);
+    m_packetsSent += size;
+    if (!m_fetch) {
+        m_socket->Recv(size, TricklesSocketBase::QUEUE_RECV);
+        return;
+    }
+    DynamicCast<TricklesSocketBase> (m_socket)->RequestRange(m_objectId, m_objectOffset, size, TricklesSocketBase::FetchCallback ());
+    m_objectOffset += size;
+}
+
+void
+TricklesSink::HandleObjectData (Ptr<Socket> socket, uint32_t objectId, uint64_t offset, Ptr<const Packet> data)
+{
+    NS_LOG_FUNCTION (this << objectId << offset << data->GetSize ());
+    m_totalRx += data->GetSize ();
+    if (m_store && !m_store->Verify(objectId, offset, data)) {
+        NS_LOG_WARN ("Object " << objectId << " data at " << offset << " does not match the store");
+        m_corrupted++;
+    }
+    if (m_greedy && m_running) TopUp ();
 }
 
-uint32_t TricklesSink::GetTotalRx() {
+uint64_t TricklesSink::GetTotalRx() {
     return m_totalRx;
 }
 
-uint32_t TricklesSink::GetTotalRq() {
+uint64_t TricklesSink::GetTotalRq() {
     return m_packetsSent;
 }
+
+uint32_t TricklesSink::GetCorrupted() {
+    return m_corrupted;
+}
+
+void TricklesSink::AddReplica (Address address) {
+    NS_LOG_FUNCTION (this << address);
+    m_replicas.push_back (address);
+}
+
+void TricklesSink::AddPath (Address address) {
+    NS_LOG_FUNCTION (this << address);
+    m_paths.push_back (address);
+}
+
+Ptr<Socket> TricklesSink::GetSocket (void) const {
+    return m_socket;
+}
@@ -28,6 +28,8 @@
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
 #include "ns3/socket.h"
+#include <vector>
+#include "trickles-object-store.h"
 
 using namespace ns3;
 
@@ -40,6 +42,12 @@ using namespace ns3;
  * Затребование каждой порции данных осуществляется при помощи вызова функции сокета Recv. При этом сокет является ответственным за постановку этого требования в очередь и передачу его серверу.
  *
  * Как только очередная порция данных получена от сервера, она автоматически читается из сокета (при помощи того же самого вызова Recv).
+ *
+ * В жадном режиме (атрибут Greedy) таймер не используется: приложение поддерживает объем запрошенных, но еще не полученных данных равным Outstanding и дозапрашивает данные при каждом чтении. Скорость тогда ограничена только протоколом.
+ *
+ * Если задан атрибут Group, клиент привязывается к порту группы и участвует в потоке продолжений, который сервер рассылает группе (ns3::TricklesSocketBase::SetGroup).
+ *
+ * В режиме загрузки объекта (атрибут Fetch) порции запрашиваются методом ns3::TricklesSocketBase::RequestRange как последовательные диапазоны объекта ObjectId. Если задано хранилище ObjectStore, каждая полученная порция побайтно сверяется с ним, а несовпадения подсчитываются (#GetCorrupted).
  */
 class TricklesSink : public Application
 {
@@ -60,8 +68,28 @@ public:
      */
     void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, DataRate dataRate);
     
-    uint32_t GetTotalRx();
-    uint32_t GetTotalRq();
+    uint64_t GetTotalRx();
+    uint64_t GetTotalRq();
+    /**
+     * \brief Число порций объекта, не совпавших с хранилищем
+     */
+    uint32_t GetCorrupted();
+    /**
+     * \brief Добавить резервный сервер, на который клиент переключится, если основной перестанет отвечать
+     *
+     * Вызывается до старта приложения; адреса передаются сокету (см. ns3::TricklesSocketBase::AddReplica) после Connect.
+     */
+    void AddReplica (Address address);
+    /**
+     * \brief Добавить путь многопутевого режима: запросы распределяются между адресом Remote и всеми добавленными адресами
+     *
+     * Вызывается до старта приложения (см. ns3::TricklesSocketBase::AddPath).
+     */
+    void AddPath (Address address);
+    /**
+     * \brief Сокет приложения (0 до старта)
+     */
+    Ptr<Socket> GetSocket (void) const;
     
 private:
     /**
@@ -105,6 +133,20 @@ private:
      * Сокет является ответственным за корректную постановку запроса в очередь.
      */
     void GetData (void);
+    /**
+     * \brief Дозапрос данных в жадном режиме
+     *
+     * Запрашивает данные порциями \ref m_packetSize, пока объем запрошенных, но не полученных данных меньше \ref m_outstanding.
+     */
+    void TopUp (void);
+    /**
+     * \brief Запрос size байтов: через Recv или, в режиме загрузки объекта, через RequestRange
+     */
+    void Request (uint32_t size);
+    /**
+     * \brief Получение порции объекта в режиме загрузки
+     */
+    void HandleObjectData (Ptr<Socket> socket, uint32_t objectId, uint64_t offset, Ptr<const Packet> data);
 
     /**
      * \brief Ассоциированный с приложением сокет
@@ -133,11 +175,51 @@ private:
     /**
      * \brief Счетчик, указывающий на объем запрошенных данных
      */
-    uint32_t        m_packetsSent;
+    uint64_t        m_packetsSent;
     /**
      * \brief Счетчик, указывающий на объем полученных данных
      */
-    uint32_t        m_totalRx;
+    uint64_t        m_totalRx;
+    /**
+     * \brief Жадный режим: запросы формируются по мере получения данных, а не по таймеру
+     */
+    bool            m_greedy;
+    /**
+     * \brief Объем запрошенных, но еще не полученных данных в жадном режиме
+     */
+    uint32_t        m_outstanding;
+    /**
+     * \brief Режим загрузки объекта
+     */
+    bool            m_fetch;
+    /**
+     * \brief Загружаемый объект
+     */
+    uint32_t        m_objectId;
+    /**
+     * \brief Смещение следующей запрашиваемой порции объекта
+     */
+    uint64_t        m_objectOffset;
+    /**
+     * \brief Хранилище для проверки полученных данных
+     */
+    Ptr<TricklesObjectStore> m_store;
+    /**
+     * \brief Число порций, не прошедших проверку
+     */
+    uint32_t        m_corrupted;
+    /**
+     * \brief Резервные серверы в порядке переключения
+     */
+    std::vector<Address> m_replicas;
+    /**
+     * \brief Дополнительные пути многопутевого режима
+     */
+    std::vector<Address> m_paths;
+    /**
+     * \brief Групповой адрес потока продолжений сервера (см. ns3::TricklesSocketBase::SetGroup)
+     */
+    Address         m_group;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Ju. Chalyy (chaly@uniyar.ac.ru)
+ */
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/trickles-header.h"
+#include "ns3/trickles-shieh-header.h"
+#include "ns3/trickles-cubic.h"
+
+NS_LOG_COMPONENT_DEFINE ("TricklesCubic");
+
+namespace ns3 {
+    
+    /**
+     * RTT (в секундах) эпохи, начатой без потерь и без выхода из медленного старта.
+     * Продолжение такой эпохи не содержит OPT_CUBIC, а окно должно зависеть только от k,
+     * поэтому RTT конкретного запроса здесь не используется
+     */
+    static const double CubicEpochRtt = 0.1;
+    
+    NS_OBJECT_ENSURE_REGISTERED (TricklesCubic);
+    
+    TypeId
+    TricklesCubic::GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::TricklesCubic")
+        .SetParent<TricklesShieh> ()
+        .AddConstructor<TricklesCubic> ()
+        .AddAttribute("Beta",
+                      "CUBIC multiplicative window decrease factor",
+                      DoubleValue(0.7),
+                      MakeDoubleAccessor(&TricklesCubic::m_beta),
+                      MakeDoubleChecker<double>(0.0, 1.0))
+        .AddAttribute("C",
+                      "CUBIC scaling constant (trickles/s^3)",
+                      DoubleValue(0.4),
+                      MakeDoubleAccessor(&TricklesCubic::m_c),
+                      MakeDoubleChecker<double>(0.0))
+        .AddAttribute("FastConvergence",
+                      "Release bandwidth faster when Wmax keeps decreasing",
+                      BooleanValue(true),
+                      MakeBooleanAccessor(&TricklesCubic::m_fastConvergence),
+                      MakeBooleanChecker())
+        ;
+        return tid;
+    }
+    
+    TricklesCubic::TricklesCubic ():TricklesShieh(), m_beta(0.7), m_c(0.4), m_fastConvergence(true)
+    {
+        NS_LOG_FUNCTION_NOARGS ();
+    }
+    
+    TricklesCubic::TricklesCubic(const TricklesCubic &sock)
+    : TricklesShieh(sock), m_beta(sock.m_beta), m_c(sock.m_c), m_fastConvergence(sock.m_fastConvergence) {
+        NS_LOG_FUNCTION (this);
+    }
+    
+    TricklesCubic::~TricklesCubic ()
+    {
+        NS_LOG_FUNCTION (this);
+    }
+    
+    double TricklesCubic::EpochTime(double n, double k, double wmax, double rtt, double c) const {
+        if (c<=0) return(n*rtt/std::max(wmax, 1.0));
+        // Интеграл W(t)/RTT от начала эпохи равен n. Для u=t-K это уравнение
+        // u^4+p*u+q=0, которое решается методом Феррари
+        double p = 4.0*wmax/c;
+        double q = 4.0*(wmax*k-n*rtt)/c-pow(k, 4);
+        // Наибольший корень резольвенты m^3-q*m-p^2/8=0 (он положителен)
+        double P = -q;
+        double Q = -p*p/8.0;
+        double D = Q*Q/4.0+P*P*P/27.0;
+        double m;
+        if (D>=0) {
+            // Формула Кардано в виде без вычитания близких чисел
+            double a = cbrt(-Q/2.0+sqrt(D));
+            double b = P/(3.0*a);
+            m = -Q/(a*a+P/3.0+b*b);
+        } else {
+            double r = sqrt(-P/3.0);
+            m = 2.0*r*cos(acos(-Q/(2.0*r*r*r))/3.0);
+        }
+        // u^4+p*u+q=(u^2+m)^2-(s*u-p/(2s))^2, s=sqrt(2m); нужен больший корень u^2+s*u+m-p/(2s)=0
+        double s = sqrt(2.0*m);
+        double u = (p/s-2.0*m)/(s+sqrt(std::max(2.0*p/s-2.0*m, 0.0)));
+        return(std::max(u+k, 0.0));
+    }
+    
+    uint16_t TricklesCubic::CwndAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        uint16_t ssthresh = trh.GetSsthresh();
+        SequenceNumber32 A = SequenceNumber32(trh.GetTcpBase().GetValue()-trh.GetStartCwnd()+ssthresh);
+        // Медленный старт совпадает с оригинальным протоколом
+        if (k<A) return(tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), ssthresh, k, ByteScale(trh)));
+        
+        // Эпоха начинается в точке A с окна ssthresh. Если потерь еще не было, то Wmax=ssthresh
+        double w0 = ssthresh;
+        double wmax = w0;
+        Time epochRtt = Seconds(CubicEpochRtt);
+        if (trh.HasOption(TricklesShiehHeader::OPT_CUBIC)) {
+            wmax = std::max<double>(trh.GetWMax(), w0);
+            epochRtt = trh.GetEpochRtt();
+        }
+        double rtt = std::max(epochRtt, m_tsgranularity).GetSeconds();
+        // При побайтовом учете C задана в сегментах сервера
+        double scale = ByteScale(trh);
+        double c = m_c*scale;
+        double K = (c>0) ? cbrt((wmax-w0)/c) : 0.0;
+        double t = EpochTime(k-A, K, wmax, rtt, c);
+        double w = c*pow(t-K, 3)+wmax;
+        // TCP-friendly region
+        double wtcp = w0+scale*3.0*(1.0-m_beta)/(1.0+m_beta)*t/rtt;
+        // Погрешность решения не должна добавлять к окну лишнюю струйку
+        double result = ceil(std::max(w, wtcp)-1e-6);
+        NS_LOG_FUNCTION (this << "k=" << k << " A=" << A << " Wmax=" << wmax << " RTT=" << rtt << " t=" << t << " cwnd=" << result);
+        return((uint16_t)std::min(std::max(result, 1.0), 65535.0));
+    }
+    
+    void TricklesCubic::ReduceCwnd(Recovery_t reason, const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        TricklesShieh::ReduceCwnd(reason, th, trh, cwnd);
+        uint16_t wmax = cwnd;
+        if (m_fastConvergence && trh.HasOption(TricklesShiehHeader::OPT_CUBIC) && (cwnd<trh.GetWMax())) {
+            wmax = cwnd*(1.0+m_beta)/2.0;
+        }
+        uint16_t reduced = std::max<uint16_t>(1, cwnd*m_beta);
+        if (reason != RTO_TIMEOUT) trh.SetStartCwnd(reduced);
+        trh.SetSsthresh(reduced);
+        trh.SetWMax(wmax);
+        trh.SetEpochRtt(th.GetRTT());
+    }
+    
+    void TricklesCubic::ExitSlowStart(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        TricklesShieh::ExitSlowStart(th, trh, cwnd);
+        // Эпоха CUBIC начинается с окна выхода из медленного старта с фиксированным RTT
+        trh.SetWMax(cwnd);
+        trh.SetEpochRtt(th.GetRTT());
+    }
+    
+} // namespace ns3
@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef TRICKLES_CUBIC_H
+#define TRICKLES_CUBIC_H
+
+#include <stdint.h>
+#include "trickles-shieh.h"
+
+namespace ns3 {
+    
+    /**
+     * \ingroup trickles
+     * \brief Trickles with CUBIC window growth
+     *
+     * The client side is the same as in ns3::TricklesShieh. The server computes
+     * the window after ssthresh with the CUBIC function
+     * W(t) = C(t-K)^3 + Wmax, where Wmax and the RTT of the epoch are carried
+     * in the continuation (see ns3::TricklesShiehHeader::OPT_CUBIC) and the
+     * epoch starts at the point where slow start ends.
+     *
+     * The window must stay a function of the trickle number, so the time t of
+     * trickle k is obtained from the fluid model: k trickles after the epoch
+     * start have been sent when the integral of W(t)/RTT reaches k. An epoch
+     * without OPT_CUBIC (no loss and no HyStart exit yet) uses a fixed RTT of
+     * 100 ms, not the RTT sample of the request.
+     */
+    class TricklesCubic : public TricklesShieh
+    {
+    public:
+        static TypeId GetTypeId (void);
+        TricklesCubic ();
+        TricklesCubic(const TricklesCubic &sock);
+        virtual ~TricklesCubic ();
+        
+    protected:
+        virtual uint16_t CwndAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        virtual void ReduceCwnd(Recovery_t reason, const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
+        virtual void ExitSlowStart(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
+    private:
+        /**
+         * \brief Time (seconds) after the epoch start when n trickles have been sent
+         * \param k the K of the CUBIC function
+         *
+         * Solves integral W(t)/RTT = n for t in closed form (a quartic in t-K).
+         */
+        double EpochTime(double n, double k, double wmax, double rtt, double c) const;
+        double m_beta;
+        double m_c;
+        bool m_fastConvergence;
+    };
+    
+} // namespace ns3
+
+#endif /* TRICKLES_CUBIC_H */
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include <fstream>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "trickles-event-log.h"
+
+NS_LOG_COMPONENT_DEFINE ("TricklesEventLog");
+
+namespace ns3 {
+    
+    static const uint32_t TricklesEventLogVersion = 1;
+    
+    std::map<uint32_t, TricklesEventLog::Ring> &TricklesEventLog::Rings (void)
+    {
+        static std::map<uint32_t, Ring> rings;
+        return(rings);
+    }
+    
+    uint32_t &TricklesEventLog::Capacity (void)
+    {
+        static uint32_t capacity = 4096;
+        return(capacity);
+    }
+    
+    void TricklesEventLog::SetCapacity (uint32_t records)
+    {
+        NS_ASSERT(records>0);
+        Capacity() = records;
+    }
+    
+    void TricklesEventLog::Record (uint32_t node, const TricklesEvent &event)
+    {
+        Ring &r = Rings()[node];
+        if (r.records.empty()) {
+            r.records.resize(Capacity());
+            r.next = 0;
+            r.full = false;
+        }
+        r.records[r.next] = event;
+        if (++r.next == r.records.size()) {
+            r.next = 0;
+            r.full = true;
+        }
+    }
+    
+    bool TricklesEventLog::Dump (std::string fileName)
+    {
+        NS_LOG_FUNCTION (fileName);
+        std::ofstream out(fileName.c_str(), std::ios::binary);
+        if (!out) {
+            NS_LOG_WARN("Cannot open " << fileName);
+            return(false);
+        }
+        uint32_t version = TricklesEventLogVersion;
+        uint32_t size = sizeof(TricklesEvent);
+        out.write("TREV", 4);
+        out.write((const char *)&version, sizeof(version));
+        out.write((const char *)&size, sizeof(size));
+        for (std::map<uint32_t, Ring>::const_iterator i = Rings().begin(); i != Rings().end(); i++) {
+            const Ring &r = i->second;
+            uint32_t count = r.full?r.records.size():r.next;
+            out.write((const char *)&i->first, sizeof(i->first));
+            out.write((const char *)&count, sizeof(count));
+            // Самые старые записи буфера начинаются с r.next
+            if (r.full) out.write((const char *)&r.records[r.next], (r.records.size()-r.next)*size);
+            if (r.next) out.write((const char *)&r.records[0], r.next*size);
+        }
+        return(out.good());
+    }
+    
+    void TricklesEventLog::DoDump (std::string fileName)
+    {
+        Dump(fileName);
+    }
+    
+    void TricklesEventLog::DumpOnDestroy (std::string fileName)
+    {
+        Simulator::ScheduleDestroy(&TricklesEventLog::DoDump, fileName);
+    }
+    
+    void TricklesEventLog::Clear (void)
+    {
+        Rings().clear();
+    }
+}
@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef TRICKLES_EVENT_LOG_H
+#define TRICKLES_EVENT_LOG_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace ns3 {
+    
+    /**
+     * \ingroup tricklestp
+     * \brief Запись журнала событий Trickles (32 байта)
+     *
+     * Формат записи фиксирован: журнал сбрасывается в файл как есть и разбирается программой utils/trickles-events.py.
+     */
+    struct TricklesEvent {
+        /**
+         * \brief Тип записи
+         */
+        typedef enum {
+            /**
+             * Принят пакет: поля заголовков TricklesHeader и TricklesShiehHeader
+             */
+            INCOMING = 1,
+            /**
+             * Состояние клиента после обработки пакета
+             */
+            STATE = 2 } Type_t;
+        int64_t time;           //!< Время события (нс)
+        uint32_t trickle;       //!< Номер струйки / m_tcpBase (STATE)
+        uint32_t parent;        //!< Номер родительской струйки / начало первого блока SACK (STATE)
+        uint32_t tcpBase;       //!< Начало эпохи
+        uint32_t size;          //!< Размер запроса / запрошенные данные (STATE)
+        uint16_t cwnd;          //!< Окно эпохи
+        uint16_t ssthresh;      //!< Порог медленного старта эпохи
+        uint16_t blocks;        //!< Количество блоков SACK
+        uint8_t type;           //!< Type_t
+        uint8_t flags;          //!< Тип пакета и режим восстановления / количество тайм-аутов (STATE)
+    };
+    
+    /**
+     * \ingroup tricklestp
+     * \class TricklesEventLog
+     *
+     * \brief Журнал событий Trickles в кольцевых буферах узлов
+     *
+     * Заменяет текстовый вывод в std::clog на пути обработки пакета: для каждого узла хранятся последние Capacity записей TricklesEvent, которые можно сбросить в двоичный файл (например, после аварийного завершения в отладчике или при Simulator::Destroy) и разобрать отдельно.
+     *
+     * Запись выполняется макросом TRICKLES_EVENT, который в оптимизированной сборке (без NS3_LOG_ENABLE) ничего не делает.
+     *
+     * Формат файла: "TREV", версия (uint32), размер записи (uint32), затем для каждого узла номер узла (uint32), количество записей (uint32) и записи в порядке времени. Числа записываются в порядке байтов машины.
+     */
+    class TricklesEventLog
+    {
+    public:
+        /**
+         * \brief Добавить запись в буфер узла
+         */
+        static void Record (uint32_t node, const TricklesEvent &event);
+        /**
+         * \brief Количество записей в буфере каждого узла (по умолчанию 4096)
+         *
+         * Должно задаваться до первой записи.
+         */
+        static void SetCapacity (uint32_t records);
+        /**
+         * \brief Записать буферы всех узлов в файл
+         */
+        static bool Dump (std::string fileName);
+        /**
+         * \brief Записать буферы в файл при Simulator::Destroy
+         */
+        static void DumpOnDestroy (std::string fileName);
+        /**
+         * \brief Очистить буферы
+         */
+        static void Clear (void);
+        
+    private:
+        struct Ring {
+            std::vector<TricklesEvent> records;
+            uint32_t next;
+            bool full;
+        };
+        static std::map<uint32_t, Ring> &Rings (void);
+        static uint32_t &Capacity (void);
+        static void DoDump (std::string fileName);
+    };
+}
+
+#ifdef NS3_LOG_ENABLE
+#define TRICKLES_EVENT(node, event) ns3::TricklesEventLog::Record (node, event)
+#else
+#define TRICKLES_EVENT(node, event)
+#endif /* NS3_LOG_ENABLE */
+
+#endif /* TRICKLES_EVENT_LOG_H */
@@ -36,7 +36,7 @@ namespace ns3 {
     uint8_t TricklesHeader::m_magic = 145;
     
     TricklesHeader::TricklesHeader ()
-    : m_packetType(REQUEST), m_requestSize(0), m_trickleNo(SequenceNumber32(1)), m_parentNo(SequenceNumber32(0)), m_recovery(NO_RECOVERY), m_firstLoss(SequenceNumber32(0))
+    : m_packetType(REQUEST), m_requestSize(0), m_trickleNo(SequenceNumber32(1)), m_parentNo(SequenceNumber32(0)), m_recovery(NO_RECOVERY), m_ece(false), m_firstLoss(SequenceNumber32(0)), m_hasObject(false), m_objectId(0), m_objectOffset(0)
     {
         NS_LOG_FUNCTION (this);
     }
@@ -97,6 +97,14 @@ namespace ns3 {
         m_recovery = rec;
     }
     
+    bool TricklesHeader::GetEce() const {
+        return(m_ece);
+    }
+    
+    void TricklesHeader::SetEce(bool ece) {
+        m_ece = ece;
+    }
+    
     SequenceNumber32 TricklesHeader::GetTSVal() const {
         return(m_tsval);
     }
@@ -138,9 +146,33 @@ namespace ns3 {
     }
 
     
+    bool TricklesHeader::HasObject() const {
+        return(m_hasObject);
+    }
+    
+    uint32_t TricklesHeader::GetObjectId() const {
+        return(m_objectId);
+    }
+    
+    uint64_t TricklesHeader::GetObjectOffset() const {
+        return(m_objectOffset);
+    }
+    
+    void TricklesHeader::SetObject(uint32_t id, uint64_t offset) {
+        m_hasObject = true;
+        m_objectId = id;
+        m_objectOffset = offset;
+    }
+    
+    void TricklesHeader::ClearObject() {
+        m_hasObject = false;
+        m_objectId = 0;
+        m_objectOffset = 0;
+    }
+    
     uint32_t TricklesHeader::GetSerializedSize (void)  const
     {
-        return 1+24+m_sacks.numBlocks()*8;
+        return 1+24+m_sacks.numBlocks()*8+(m_hasObject?12:0);
     }
     void TricklesHeader::Serialize (Buffer::Iterator start)  const
     {
@@ -149,12 +181,12 @@ namespace ns3 {
         i.WriteHtonU16 (m_requestSize);
         i.WriteHtonU32 (m_trickleNo.GetValue());
         i.WriteHtonU32 (m_parentNo.GetValue());
-        uint16_t t = 0; // The variable contains m_packetType and m_Recovery;
-        t = ((m_packetType + (m_recovery << 1)) << 8)+m_sacks.numBlocks();
+        uint16_t t = 0; // The variable contains m_packetType, m_Recovery and m_ece;
+        t = ((m_packetType + (m_recovery << 1) + (m_ece << 3) + (m_hasObject << 4)) << 8)+m_sacks.numBlocks();
         i.WriteHtonU16(t);
         i.WriteHtonU32(m_tsval.GetValue());
         i.WriteHtonU32(m_tsecr.GetValue());
-        uint32_t tv = m_rtt.GetMilliSeconds();
+        uint32_t tv = m_rtt.GetMicroSeconds();
         i.WriteHtonU32(tv);
         //NS_LOG_FUNCTION(this << tv);
         SackConstIterator s = m_sacks.firstBlock();
@@ -162,6 +194,10 @@ namespace ns3 {
             i.WriteHtonU32(s->first.GetValue());
             i.WriteHtonU32(s->second.GetValue());
         }
+        if (m_hasObject) {
+            i.WriteHtonU32(m_objectId);
+            i.WriteHtonU64(m_objectOffset);
+        }
     }
     uint32_t TricklesHeader::Deserialize (Buffer::Iterator start)
     {
@@ -174,14 +210,16 @@ namespace ns3 {
         m_parentNo = i.ReadNtohU32();
         uint16_t t = i.ReadNtohU16();
         m_packetType = static_cast<Trickle_t>((t >> 8) & 0x1);
-        m_recovery = static_cast<Recovery_t>(t >> 9);
+        m_recovery = static_cast<Recovery_t>((t >> 9) & 0x3);
+        m_ece = ((t >> 11) & 0x1) != 0;
+        m_hasObject = ((t >> 12) & 0x1) != 0;
         uint32_t ts;
         ts = i.ReadNtohU32();
         m_tsval = SequenceNumber32(ts);
         ts = i.ReadNtohU32();
         m_tsecr = SequenceNumber32(ts);
         ts = i.ReadNtohU32();
-        m_rtt = MilliSeconds(ts);
+        m_rtt = MicroSeconds(ts);
         //NS_LOG_FUNCTION(this << ts);
         t = t & 0x00FF;
         for (;t;t--) {
@@ -190,6 +228,10 @@ namespace ns3 {
             s = i.ReadNtohU32();
             m_sacks.AddBlock(SequenceNumber32(f), SequenceNumber32(s));
         }
+        if (m_hasObject) {
+            m_objectId = i.ReadNtohU32();
+            m_objectOffset = i.ReadNtohU64();
+        }
         return GetSerializedSize ();
     }
     
@@ -232,6 +274,8 @@ namespace ns3 {
             default:
                 break;
         }
+        if (m_ece) os << " ECE";
+        if (m_hasObject) os << " Object=" << m_objectId << "@" << m_objectOffset;
         os << " tsval=" << m_tsval << " tsecr=" << m_tsecr;
         os << " RTT=" << m_rtt.GetMilliSeconds() << " ";
     }
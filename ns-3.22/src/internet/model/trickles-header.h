@@ -108,6 +108,8 @@ namespace ns3 {
         void SetParentNumber(uint32_t i);
         Recovery_t IsRecovery() const;
         void SetRecovery(Recovery_t rec);
+        bool GetEce() const;
+        void SetEce(bool ece);
         SequenceNumber32 GetTSVal() const;
         void SetTSVal(SequenceNumber32 tsval);
         SequenceNumber32 GetTSEcr() const;
@@ -118,6 +120,17 @@ namespace ns3 {
         void SetSacks(TricklesSack newsack);
         SequenceNumber32 GetFirstLoss() const;
         void SetFirstLoss(SequenceNumber32 firstLoss);
+        /**
+         * \brief Истина, если запрос относится к объекту (см. ns3::TricklesSocketBase::RequestRange)
+         */
+        bool HasObject() const;
+        uint32_t GetObjectId() const;
+        uint64_t GetObjectOffset() const;
+        /**
+         * \brief Запрашивать данные объекта id, начиная со смещения offset
+         */
+        void SetObject(uint32_t id, uint64_t offset);
+        void ClearObject();
     private:
         /**
          * \brief Тип передаваемого пакета
@@ -139,6 +152,10 @@ namespace ns3 {
          * \brief Флаг, является ли пакет recovery-пакетом (т.е. таким, который передается на стадии восстановления после потерь)
          */
         Recovery_t m_recovery;
+        /**
+         * \brief ECN-Echo: в запросе - продолжение, из которого он получен, пришло с отметкой CE
+         */
+        bool m_ece;
         /**
          * \brief Параметр tsval для функционирования временных меток (см. rfc 1323)
          */
@@ -148,7 +165,7 @@ namespace ns3 {
          */
         SequenceNumber32 m_tsecr;
         /**
-         * \brief Рассчитанное сервером значение RTT (в миллисекундах), что делается на основе временных меток
+         * \brief Рассчитанное сервером значение RTT (передается в микросекундах), что делается на основе временных меток
          */
         Time m_rtt;
         /**
@@ -159,6 +176,18 @@ namespace ns3 {
          * \brief Первый потерянный пакет
          */
         SequenceNumber32 m_firstLoss;
+        /**
+         * \brief Заданы ли идентификатор объекта и смещение
+         */
+        bool m_hasObject;
+        /**
+         * \brief Идентификатор запрашиваемого объекта
+         */
+        uint32_t m_objectId;
+        /**
+         * \brief Смещение запрашиваемых данных в объекте
+         */
+        uint64_t m_objectOffset;
     };
 
 #undef LOG_TRICKLES_PACKET
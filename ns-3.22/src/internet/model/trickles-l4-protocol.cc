@@ -22,6 +22,7 @@
 #include "ns3/log.h"
 #include "ns3/nstime.h"
 #include "ns3/boolean.h"
+#include "ns3/uinteger.h"
 #include "ns3/object-vector.h"
 
 #include "ns3/packet.h"
@@ -53,6 +54,45 @@ NS_LOG_COMPONENT_DEFINE ("TricklesL4Protocol");
 namespace ns3 {
 
 NS_OBJECT_ENSURE_REGISTERED (TricklesL4Protocol);
+NS_OBJECT_ENSURE_REGISTERED (TricklesPacingTag);
+
+TricklesPacingTag::TricklesPacingTag() : m_delay(Time(0)) {
+}
+
+void TricklesPacingTag::SetDelay(Time delay) {
+    m_delay = delay;
+}
+
+Time TricklesPacingTag::GetDelay() const {
+    return m_delay;
+}
+
+TypeId TricklesPacingTag::GetTypeId() {
+    static TypeId tid = TypeId("ns3::TricklesPacingTag")
+    .SetParent<Tag>()
+    .AddConstructor<TricklesPacingTag>();
+    return tid;
+}
+
+TypeId TricklesPacingTag::GetInstanceTypeId() const {
+    return GetTypeId();
+}
+
+uint32_t TricklesPacingTag::GetSerializedSize() const {
+    return 8;
+}
+
+void TricklesPacingTag::Serialize(TagBuffer i) const {
+    i.WriteU64(m_delay.GetNanoSeconds());
+}
+
+void TricklesPacingTag::Deserialize(TagBuffer i) {
+    m_delay = NanoSeconds(i.ReadU64());
+}
+
+void TricklesPacingTag::Print(std::ostream &os) const {
+    os << "TricklesPacingDelay=" << m_delay;
+}
 
 //TcpL4Protocol stuff----------------------------------------------------------
 
@@ -84,12 +124,53 @@ TricklesL4Protocol::GetTypeId (void)
                    ObjectVectorValue (),
                    MakeObjectVectorAccessor (&TricklesL4Protocol::m_sockets),
                    MakeObjectVectorChecker<TricklesSocketBase> ())
+    .AddTraceSource ("NewSocket", "A socket was created by this protocol.",
+                     MakeTraceSourceAccessor (&TricklesL4Protocol::m_newSocketTrace),
+                     "ns3::TricklesL4Protocol::NewSocketCallback")
+    .AddAttribute ("Pacing",
+                   "Spread the continuations one request releases over the RTT instead of sending them back to back.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TricklesL4Protocol::m_pacing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PacingGranularity",
+                   "Slot length of the pacing timer wheel.",
+                   TimeValue (MicroSeconds (100)),
+                   MakeTimeAccessor (&TricklesL4Protocol::m_wheelTick),
+                   MakeTimeChecker ())
+    .AddAttribute ("PacingSlots",
+                   "Number of slots of the pacing timer wheel.",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&TricklesL4Protocol::m_wheelSlots),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("PathCache",
+                   "Seed new connections with the RTT, window and ssthresh last seen to the same host.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TricklesL4Protocol::m_pathCache),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PathCacheTimeout",
+                   "Age after which a path cache entry is discarded.",
+                   TimeValue (Seconds (600)),
+                   MakeTimeAccessor (&TricklesL4Protocol::m_pathTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("PathCacheHalfLife",
+                   "The cached window is halved for every such interval since it was saved.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&TricklesL4Protocol::m_pathHalfLife),
+                   MakeTimeChecker ())
+    .AddAttribute ("PathCacheSize",
+                   "Maximal number of hosts in the path cache.",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&TricklesL4Protocol::m_pathMaxEntries),
+                   MakeUintegerChecker<uint32_t> (1))
   ;
   return tid;
 }
 
 TricklesL4Protocol::TricklesL4Protocol ()
-  : m_endPoints (new Ipv4EndPointDemux ()), m_endPoints6 (new Ipv6EndPointDemux ())
+  : m_endPoints (new Ipv4EndPointDemux ()), m_endPoints6 (new Ipv6EndPointDemux ()),
+    m_pacing (false), m_wheelTick (MicroSeconds (100)), m_wheelSlots (1024),
+    m_wheelPos (0), m_wheelCount (0),
+    m_pathCache (false), m_pathTimeout (Seconds (600)), m_pathHalfLife (Seconds (1)), m_pathMaxEntries (1024)
 {
   NS_LOG_FUNCTION_NOARGS ();
   NS_LOG_LOGIC ("Made a TricklesL4Protocol "<<this);
@@ -163,6 +244,10 @@ TricklesL4Protocol::DoDispose (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
   m_sockets.clear ();
+  m_wheelEvent.Cancel ();
+  m_wheel.clear ();
+  m_wheelCount = 0;
+  m_paths.clear ();
 
   if (m_endPoints != 0)
     {
@@ -182,6 +267,66 @@ TricklesL4Protocol::DoDispose (void)
   IpL4Protocol::DoDispose ();
 }
 
+void
+TricklesL4Protocol::SavePathState (const Address &peer, Time srtt, uint32_t cwnd, uint32_t ssthresh)
+{
+  NS_LOG_FUNCTION (this << peer << srtt << cwnd << ssthresh);
+  if (!m_pathCache)
+    {
+      return;
+    }
+  Time now = Simulator::Now ();
+  if (m_paths.size () >= m_pathMaxEntries && m_paths.find (peer) == m_paths.end ())
+    {
+      // Вытесняем самую старую запись
+      std::map<Address, PathState>::iterator oldest = m_paths.begin ();
+      for (std::map<Address, PathState>::iterator it = m_paths.begin (); it != m_paths.end (); ++it)
+        {
+          if (it->second.stamp < oldest->second.stamp)
+            {
+              oldest = it;
+            }
+        }
+      m_paths.erase (oldest);
+    }
+  PathState &ps = m_paths[peer];
+  ps.srtt = srtt;
+  ps.cwnd = cwnd;
+  ps.ssthresh = ssthresh;
+  ps.stamp = now;
+}
+
+bool
+TricklesL4Protocol::LookupPathState (const Address &peer, Time &srtt, uint32_t &cwnd, uint32_t &ssthresh)
+{
+  NS_LOG_FUNCTION (this << peer);
+  if (!m_pathCache)
+    {
+      return false;
+    }
+  std::map<Address, PathState>::iterator it = m_paths.find (peer);
+  if (it == m_paths.end ())
+    {
+      return false;
+    }
+  Time age = Simulator::Now () - it->second.stamp;
+  if (age > m_pathTimeout)
+    {
+      m_paths.erase (it);
+      return false;
+    }
+  srtt = it->second.srtt;
+  ssthresh = it->second.ssthresh;
+  cwnd = it->second.cwnd;
+  if (m_pathHalfLife.IsStrictlyPositive ())
+    {
+      // Окно, не подтвержденное передачей, устаревает (RFC 2861)
+      int64_t halvings = age.GetNanoSeconds () / m_pathHalfLife.GetNanoSeconds ();
+      cwnd = (halvings >= 32) ? 0 : (cwnd >> halvings);
+    }
+  return true;
+}
+
 Ptr<Socket>
 TricklesL4Protocol::CreateSocket (TypeId socketTypeId)
 {
@@ -196,6 +341,7 @@ TricklesL4Protocol::CreateSocket (TypeId socketTypeId)
   socket->SetTrickles (this);
   socket->SetRtt (rtt);
   m_sockets.push_back (socket);
+  m_newSocketTrace (socket);
   return socket;
 }
 
@@ -521,6 +667,113 @@ void
 TricklesL4Protocol::Send (Ptr<Packet> packet,
                      Ipv4Address saddr, Ipv4Address daddr,
                      uint16_t sport, uint16_t dport, Ptr<NetDevice> oif)
+{
+  TricklesPacingTag tag;
+  if (packet->RemovePacketTag (tag) && m_pacing)
+    {
+      Time release = Simulator::Now () + tag.GetDelay ();
+      if (release > Simulator::Now ())
+        {
+          PacedPacket pp;
+          pp.packet = packet;
+          pp.v6 = false;
+          pp.saddr = saddr;
+          pp.daddr = daddr;
+          pp.sport = sport;
+          pp.dport = dport;
+          pp.oif = oif;
+          EnqueuePaced (pp, release);
+          return;
+        }
+    }
+  DoSend (packet, saddr, daddr, sport, dport, oif);
+}
+
+void
+TricklesL4Protocol::Send (Ptr<Packet> packet,
+                     Ipv6Address saddr, Ipv6Address daddr,
+                     uint16_t sport, uint16_t dport, Ptr<NetDevice> oif)
+{
+  TricklesPacingTag tag;
+  if (packet->RemovePacketTag (tag) && m_pacing)
+    {
+      Time release = Simulator::Now () + tag.GetDelay ();
+      if (release > Simulator::Now ())
+        {
+          PacedPacket pp;
+          pp.packet = packet;
+          pp.v6 = true;
+          pp.saddr6 = saddr;
+          pp.daddr6 = daddr;
+          pp.sport = sport;
+          pp.dport = dport;
+          pp.oif = oif;
+          EnqueuePaced (pp, release);
+          return;
+        }
+    }
+  DoSend (packet, saddr, daddr, sport, dport, oif);
+}
+
+void
+TricklesL4Protocol::EnqueuePaced (const PacedPacket &pp, Time release)
+{
+  NS_LOG_FUNCTION (this << pp.packet << release);
+  if (m_wheel.size () != m_wheelSlots)
+    {
+      NS_ASSERT (m_wheelCount == 0);
+      m_wheel.assign (m_wheelSlots, std::list<PacedPacket> ());
+      m_wheelPos = 0;
+    }
+  // Ячейка, которая будет обработана через ticks шагов колеса
+  uint64_t ticks = (release - Simulator::Now ()).GetTimeStep () / m_wheelTick.GetTimeStep ();
+  if (ticks == 0) ticks = 1;
+  PacedPacket item = pp;
+  item.rounds = (ticks - 1) / m_wheelSlots;
+  m_wheel[(m_wheelPos + ticks) % m_wheelSlots].push_back (item);
+  m_wheelCount++;
+  if (!m_wheelEvent.IsRunning ())
+    {
+      m_wheelEvent = Simulator::Schedule (m_wheelTick, &TricklesL4Protocol::WheelTick, this);
+    }
+}
+
+void
+TricklesL4Protocol::WheelTick (void)
+{
+  m_wheelPos = (m_wheelPos + 1) % m_wheelSlots;
+  std::list<PacedPacket> &slot = m_wheel[m_wheelPos];
+  std::list<PacedPacket>::iterator it = slot.begin ();
+  while (it != slot.end ())
+    {
+      if (it->rounds)
+        {
+          it->rounds--;
+          it++;
+          continue;
+        }
+      PacedPacket pp = *it;
+      it = slot.erase (it);
+      m_wheelCount--;
+      if (pp.v6)
+        {
+          DoSend (pp.packet, pp.saddr6, pp.daddr6, pp.sport, pp.dport, pp.oif);
+        }
+      else
+        {
+          DoSend (pp.packet, pp.saddr, pp.daddr, pp.sport, pp.dport, pp.oif);
+        }
+    }
+  if (m_wheelCount)
+    {
+      m_wheelEvent = Simulator::Schedule (m_wheelTick, &TricklesL4Protocol::WheelTick, this);
+    }
+}
+
+void
+TricklesL4Protocol::DoSend (Ptr<Packet> packet,
+                     Ipv4Address saddr, Ipv4Address daddr,
+                     uint16_t sport, uint16_t dport, Ptr<NetDevice> oif)
 {
   NS_LOG_FUNCTION (this << packet << saddr << ":" << sport << " >> " << daddr << ":" << dport);
 
@@ -561,7 +814,7 @@ TricklesL4Protocol::Send (Ptr<Packet> packet,
 }
 
 void
-TricklesL4Protocol::Send (Ptr<Packet> packet,
+TricklesL4Protocol::DoSend (Ptr<Packet> packet,
                      Ipv6Address saddr, Ipv6Address daddr,
                      uint16_t sport, uint16_t dport, Ptr<NetDevice> oif)
 {
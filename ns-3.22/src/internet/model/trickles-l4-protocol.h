@@ -22,12 +22,20 @@
 #define TRICKLES_L4_PROTOCOL_H
 
 #include <stdint.h>
+#include <list>
+#include <map>
+#include <vector>
 
 #include "ns3/packet.h"
+#include "ns3/tag.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/address.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv6-address.h"
 #include "ns3/ptr.h"
 #include "ns3/object-factory.h"
+#include "ns3/traced-callback.h"
 #include "ip-l4-protocol.h"
 #include "ns3/net-device.h"
 
@@ -43,6 +51,27 @@ class TricklesSocketBase;
 class Ipv4EndPoint;
 class Ipv6EndPoint;
 
+/**
+ * \ingroup tricklestp
+ * \brief Метка пакета с задержкой его отправки
+ *
+ * Сокет-сервер вычисляет задержку по самому запросу: продолжение с номером j, порожденное запросом, первое продолжение которого имеет номер f, задерживается на (j-f)*RTT/cwnd. ns3::TricklesL4Protocol при включенном выравнивании (Pacing) выпускает продолжение в сеть через эту задержку, поэтому на узле не хранится состояние потоков.
+ */
+class TricklesPacingTag : public Tag {
+public:
+    TricklesPacingTag();
+    void SetDelay(Time delay);
+    Time GetDelay() const;
+    static TypeId GetTypeId(void);
+    virtual TypeId GetInstanceTypeId(void) const;
+    virtual uint32_t GetSerializedSize(void) const;
+    virtual void Serialize(TagBuffer i) const;
+    virtual void Deserialize(TagBuffer i);
+    virtual void Print(std::ostream &os) const;
+private:
+    Time m_delay;
+};
+
 /**
  * \ingroup tricklestp
  * \brief Уровень между протоколом IP и сокетами
@@ -63,6 +92,10 @@ public:
      * После передачи пакета объекту этого класса он дальше его направляет в конкретный сокет.
      */
   static const uint8_t PROT_NUMBER;
+    /**
+     * \brief Сигнатура трассировки NewSocket
+     */
+  typedef void (* NewSocketCallback)(Ptr<Socket> socket);
   /**
    * \brief Конструктор
    */
@@ -133,6 +166,8 @@ public:
    * \param oif интерфейс, через который осуществляется отправка.
    *
    * В процессе отправки формируется заголовок протокола TCP по умолчанию. Предполагается, что заголовок протокола Trickles уже включен в пакет конечной точкой.
+   *
+   * Если включено выравнивание и у пакета есть ns3::TricklesPacingTag, то отправка может быть отложена планировщиком узла.
    */
   void Send (Ptr<Packet> packet,
              Ipv4Address saddr, Ipv4Address daddr, 
@@ -182,6 +217,25 @@ public:
                             Ipv6Address payloadSource,Ipv6Address payloadDestination,
                             const uint8_t payload[8]);
     /**@}*/
+    /**@{*/
+    /**
+     * \brief Запомнить состояние пути к узлу peer
+     * \param peer IP-адрес удаленного узла (порт не учитывается)
+     * \param srtt сглаженное RTT
+     * \param cwnd окно (струйки)
+     * \param ssthresh порог медленного старта (струйки)
+     */
+  void SavePathState (const Address &peer, Time srtt, uint32_t cwnd, uint32_t ssthresh);
+    /**
+     * \brief Найти состояние пути к узлу peer для начала нового соединения
+     * \returns false, если записи нет, она устарела или кэш выключен
+     *
+     * Окно уменьшается вдвое за каждые PathStateHalfLife с момента сохранения, но не ниже минимального окна.
+     * Кэш читается только в начале соединения: соединение, возобновленное после простоя,
+     * продолжает последнюю эпоху, которую несут его отложенные запросы.
+     */
+  bool LookupPathState (const Address &peer, Time &srtt, uint32_t &cwnd, uint32_t &ssthresh);
+    /**@}*/
   // From IpL4Protocol
   virtual void SetDownTarget (IpL4Protocol::DownTargetCallback cb);
   virtual void SetDownTarget6 (IpL4Protocol::DownTargetCallback6 cb);
@@ -225,6 +279,10 @@ private:
      * Нужен для того, чтобы создавать точки, реализующие различные версии протокола Trickles
      */
   TypeId m_socketTypeId;
+    /**
+     * \brief Трассировка создания сокета (см. ns3::TricklesStatsCollector)
+     */
+  TracedCallback<Ptr<Socket> > m_newSocketTrace;
 private:
   friend class TricklesSocketBase;
     /**@{*/
@@ -236,6 +294,91 @@ private:
   void SendPacket (Ptr<Packet>, const TcpHeader &,
                    Ipv6Address, Ipv6Address, Ptr<NetDevice> oif = 0);
     /**@}*/
+    /**@{*/
+    /**
+     * \brief Немедленная передача пакета сетевому уровню
+     */
+  void DoSend (Ptr<Packet> packet,
+               Ipv4Address saddr, Ipv4Address daddr,
+               uint16_t sport, uint16_t dport, Ptr<NetDevice> oif);
+  void DoSend (Ptr<Packet> packet,
+               Ipv6Address saddr, Ipv6Address daddr,
+               uint16_t sport, uint16_t dport, Ptr<NetDevice> oif);
+    /**@}*/
+    /**
+     * \brief Продолжение, ожидающее своего времени в планировщике
+     */
+  struct PacedPacket {
+      Ptr<Packet> packet;
+      bool v6;
+      Ipv4Address saddr;
+      Ipv4Address daddr;
+      Ipv6Address saddr6;
+      Ipv6Address daddr6;
+      uint16_t sport;
+      uint16_t dport;
+      Ptr<NetDevice> oif;
+      /**
+       * Число полных оборотов колеса до отправки
+       */
+      uint32_t rounds;
+  };
+    /**
+     * \brief Поставить продолжение в колесо таймеров
+     */
+  void EnqueuePaced (const PacedPacket &pp, Time release);
+    /**
+     * \brief Очередной шаг колеса таймеров: отправка продолжений текущей ячейки
+     */
+  void WheelTick (void);
+    /**
+     * \brief Выравнивание отправки продолжений включено
+     */
+  bool m_pacing;
+    /**
+     * \brief Длительность одной ячейки колеса таймеров
+     */
+  Time m_wheelTick;
+    /**
+     * \brief Число ячеек колеса таймеров
+     */
+  uint32_t m_wheelSlots;
+  std::vector<std::list<PacedPacket> > m_wheel;
+  uint32_t m_wheelPos;
+    /**
+     * \brief Число продолжений в колесе
+     */
+  uint32_t m_wheelCount;
+  EventId m_wheelEvent;
+    /**
+     * \brief Состояние пути к удаленному узлу, общее для всех сокетов узла
+     */
+  struct PathState {
+      Time srtt;
+      uint32_t cwnd;
+      uint32_t ssthresh;
+      /**
+       * Время последнего обновления
+       */
+      Time stamp;
+  };
+    /**
+     * \brief Кэш состояния путей включен
+     */
+  bool m_pathCache;
+    /**
+     * \brief Время жизни записи кэша
+     */
+  Time m_pathTimeout;
+    /**
+     * \brief Время, за которое сохраненное окно уменьшается вдвое
+     */
+  Time m_pathHalfLife;
+    /**
+     * \brief Максимальное число записей кэша
+     */
+  uint32_t m_pathMaxEntries;
+  std::map<Address, PathState> m_paths;
   TricklesL4Protocol (const TricklesL4Protocol &o);
   TricklesL4Protocol &operator = (const TricklesL4Protocol &o);
 
@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/trickles-header.h"
+#include "ns3/trickles-shieh-header.h"
+#include "ns3/trickles-ledbat.h"
+
+NS_LOG_COMPONENT_DEFINE ("TricklesLedbat");
+
+namespace ns3 {
+    
+    NS_OBJECT_ENSURE_REGISTERED (TricklesLedbat);
+    
+    TypeId
+    TricklesLedbat::GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::TricklesLedbat")
+        .SetParent<TricklesShieh> ()
+        .AddConstructor<TricklesLedbat> ()
+        .AddAttribute("Target",
+                      "Queuing delay the window is tuned for",
+                      TimeValue(MilliSeconds(25)),
+                      MakeTimeAccessor(&TricklesLedbat::m_target),
+                      MakeTimeChecker())
+        .AddAttribute("Gain",
+                      "Window change per RTT (trickles) when the queuing delay is zero",
+                      DoubleValue(1.0),
+                      MakeDoubleAccessor(&TricklesLedbat::m_gain),
+                      MakeDoubleChecker<double>(0.0))
+        .AddAttribute("MinCwnd",
+                      "Lower bound of the window set by the delay control",
+                      UintegerValue(2),
+                      MakeUintegerAccessor(&TricklesLedbat::m_minCwnd),
+                      MakeUintegerChecker<uint32_t>(1, 0xffff))
+        ;
+        return tid;
+    }
+    
+    TricklesLedbat::TricklesLedbat ():TricklesShieh(), m_target(MilliSeconds(25)), m_gain(1.0), m_minCwnd(2)
+    {
+        NS_LOG_FUNCTION_NOARGS ();
+    }
+    
+    TricklesLedbat::TricklesLedbat(const TricklesLedbat &sock)
+    : TricklesShieh(sock), m_target(sock.m_target), m_gain(sock.m_gain), m_minCwnd(sock.m_minCwnd) {
+        NS_LOG_FUNCTION (this);
+    }
+    
+    TricklesLedbat::~TricklesLedbat ()
+    {
+        NS_LOG_FUNCTION (this);
+    }
+    
+    uint16_t TricklesLedbat::CwndAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        // До первого замера задержки - медленный старт оригинального протокола
+        if (!trh.HasOption(TricklesShiehHeader::OPT_DELAY)) return(tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), k, ByteScale(trh)));
+    
+        int64_t c0 = std::max<uint16_t>(trh.GetStartCwnd(), 1);
+        int64_t n = k-(trh.GetTcpBase()-1);
+        if (n<=0) return(c0);
+        // Линейное изменение от startCwnd до ssthresh на протяжении одного окна, далее с тем же наклоном
+        int64_t result = c0+(trh.GetSsthresh()-c0)*n/c0;
+        NS_LOG_FUNCTION (this << "k=" << k << " n=" << n << " cwnd=" << result);
+        return((uint16_t)std::min<int64_t>(std::max<int64_t>(result, m_minCwnd), 0xffff));
+    }
+    
+    bool TricklesLedbat::IsEpochMarker(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        // Во время снижения окна по ECN отсчет ведется от конца снижения
+        TricklesShiehHeader law = LawEpoch(trh);
+        SequenceNumber32 first = law.GetTcpBase()+SequenceNumber32(std::max<uint16_t>(law.GetStartCwnd(), 1)-1);
+        // Окно уменьшается не быстрее, чем на 1 за 2 струйки, поэтому маркер находится не дальше first+1
+        if ((k<first) || (k-first>2)) return(false);
+        for (SequenceNumber32 i = first; i<k; i++) {
+            if (WindowAt(th, trh, i)>=WindowAt(th, trh, i-1)) return(false);
+        }
+        return(true);
+    }
+    
+    void TricklesLedbat::UpdateEpoch(const TricklesHeader &th, TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        if (!IsEpochMarker(th, trh, k)) return;
+    
+        SequenceNumber32 m = th.GetTrickleNumber();
+        double c0 = WindowAt(th, trh, m-1);
+        bool hasDelay = trh.HasOption(TricklesShiehHeader::OPT_DELAY);
+        bool ssDone = hasDelay && trh.IsSlowStartDone();
+        Time base = hasDelay?trh.GetBaseRtt():Time(0);
+        Time rtt = th.GetRTT();
+        if (!rtt.IsZero() && (base.IsZero() || (rtt<base))) base = rtt;
+    
+        // Без замера задержки продолжаем в текущем режиме
+        double w1 = ssDone?c0:2.0*c0;
+        if (!rtt.IsZero() && !base.IsZero()) {
+            double offTarget = (m_target-(rtt-base)).GetSeconds()/m_target.GetSeconds();
+            if (offTarget<0.25) ssDone = true;
+            if (ssDone) {
+                // Gain задан в сегментах сервера
+                double delta = m_gain*offTarget*ByteScale(trh);
+                w1 = c0+((delta>0)?ceil(delta):floor(delta));
+            }
+        }
+        w1 = std::min(std::max(w1, c0/2.0), 2.0*c0);
+        w1 = std::min(std::max(w1, (double)m_minCwnd), 65535.0);
+        NS_LOG_DEBUG("New delay epoch at " << m << " RTT=" << rtt << " baseRTT=" << base << " cwnd " << c0 << "->" << w1);
+    
+        trh.ClearOption(TricklesShiehHeader::OPT_DRAIN);
+        trh.SetTcpBase(m);
+        trh.SetStartCwnd((uint16_t)c0);
+        trh.SetSsthresh((uint16_t)w1);
+        trh.SetBaseRtt(base);
+        trh.SetSlowStartDone(ssDone);
+        trh.SetOption(TricklesShiehHeader::OPT_REBASE);
+    }
+    
+    bool TricklesLedbat::InSlowStart(const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        // Медленный старт завершается по задержке в UpdateEpoch
+        return(false);
+    }
+    
+    void TricklesLedbat::ReduceCwnd(Recovery_t reason, const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        TricklesShieh::ReduceCwnd(reason, th, trh, cwnd);
+        if (trh.HasOption(TricklesShiehHeader::OPT_DELAY)) {
+            // В эпохе без наклона окно постоянно до следующего замера задержки
+            trh.SetSsthresh(trh.GetStartCwnd());
+            if (reason == RTO_TIMEOUT) trh.SetSlowStartDone(false);
+        }
+    }
+
+} // namespace ns3
@@ -0,0 +1,76 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef TRICKLES_LEDBAT_H
+#define TRICKLES_LEDBAT_H
+
+#include <stdint.h>
+#include "ns3/nstime.h"
+#include "trickles-shieh.h"
+
+namespace ns3 {
+    
+    /**
+     * \ingroup trickles
+     * \brief Trickles with delay-based (LEDBAT-like) window control
+     *
+     * The server compares the RTT carried in the request with the minimal RTT
+     * carried in the continuation (see ns3::TricklesShiehHeader::OPT_DELAY) and
+     * moves the window towards the point where the queuing delay equals Target:
+     * by Gain*(Target-delay)/Target trickles per RTT, at most doubling or
+     * halving it. Slow start doubles the window until the queuing delay reaches
+     * 3/4 of Target.
+     *
+     * Within an epoch the window changes linearly with the trickle number: it
+     * equals startCwnd at tcpBase-1 and ssthresh startCwnd trickles later. One
+     * request per epoch (the first one emitting continuations one window after
+     * tcpBase) measures the delay and starts the next epoch with OPT_REBASE.
+     * Losses are handled as in ns3::TricklesShieh.
+     *
+     * The base RTT is carried in microseconds, but the RTT samples are as
+     * fine as the TimestampGranularity of the sockets (5 ms by default), so a
+     * sub-millisecond Target needs a finer timestamp clock at both ends.
+     */
+    class TricklesLedbat : public TricklesShieh
+    {
+    public:
+        static TypeId GetTypeId (void);
+        TricklesLedbat ();
+        TricklesLedbat(const TricklesLedbat &sock);
+        virtual ~TricklesLedbat ();
+    
+    protected:
+        virtual uint16_t CwndAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        virtual void ReduceCwnd(Recovery_t reason, const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
+        virtual void UpdateEpoch(const TricklesHeader &th, TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        virtual bool InSlowStart(const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+    private:
+        /**
+         * \brief Is request k the one that starts the next epoch
+         */
+        bool IsEpochMarker(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        Time m_target;
+        double m_gain;
+        uint32_t m_minCwnd;
+    };
+
+} // namespace ns3
+
+#endif /* TRICKLES_LEDBAT_H */
@@ -0,0 +1,252 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include "ns3/log.h"
+#include "ns3/enum.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/trace-source-accessor.h"
+#include "ipv4-list-routing.h"
+#include "tcp-header.h"
+#include "trickles-header.h"
+#include "trickles-l4-protocol.h"
+#include "trickles-load-balancer.h"
+
+NS_LOG_COMPONENT_DEFINE ("TricklesLoadBalancer");
+
+namespace ns3 {
+
+    NS_OBJECT_ENSURE_REGISTERED (TricklesLoadBalancer);
+
+    TypeId
+    TricklesLoadBalancer::GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::TricklesLoadBalancer")
+        .SetParent<Ipv4RoutingProtocol> ()
+        .AddConstructor<TricklesLoadBalancer> ()
+        .AddAttribute ("VirtualAddress", "Address the clients send their requests to.",
+                       Ipv4AddressValue (Ipv4Address ("10.255.255.1")),
+                       MakeIpv4AddressAccessor (&TricklesLoadBalancer::m_vip),
+                       MakeIpv4AddressChecker ())
+        .AddAttribute ("Policy", "How a replica is chosen for a request.",
+                       EnumValue (TricklesLoadBalancer::HASH),
+                       MakeEnumAccessor (&TricklesLoadBalancer::m_policy),
+                       MakeEnumChecker (TricklesLoadBalancer::HASH, "Hash",
+                                        TricklesLoadBalancer::ROUND_ROBIN, "RoundRobin",
+                                        TricklesLoadBalancer::LEAST_QUEUE, "LeastQueue"))
+        .AddTraceSource ("Forward", "A request was forwarded to a replica.",
+                         MakeTraceSourceAccessor (&TricklesLoadBalancer::m_forwardTrace),
+                         "ns3::TricklesLoadBalancer::ForwardCallback")
+        ;
+        return tid;
+    }
+
+    TricklesLoadBalancer::TricklesLoadBalancer ()
+    : m_policy (HASH),
+    m_next (0)
+    {
+        NS_LOG_FUNCTION (this);
+    }
+
+    TricklesLoadBalancer::~TricklesLoadBalancer ()
+    {
+        NS_LOG_FUNCTION (this);
+    }
+
+    void TricklesLoadBalancer::DoDispose (void)
+    {
+        NS_LOG_FUNCTION (this);
+        m_ipv4 = 0;
+        m_replicas.clear();
+        Ipv4RoutingProtocol::DoDispose ();
+    }
+
+    void TricklesLoadBalancer::Install (Ptr<Node> node, int16_t priority)
+    {
+        NS_LOG_FUNCTION (this << node << priority);
+        Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+        NS_ASSERT_MSG (ipv4, "No IPv4 on node " << node->GetId());
+        Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(ipv4->GetRoutingProtocol());
+        NS_ASSERT_MSG (list, "Node " << node->GetId() << " does not use Ipv4ListRouting");
+        list->AddRoutingProtocol(this, priority);
+        SetIpv4(ipv4);
+    }
+
+    void TricklesLoadBalancer::AddReplica (Ipv4Address address, LoadCallback load)
+    {
+        NS_LOG_FUNCTION (this << address);
+        Replica r;
+        r.address = address;
+        r.load = load;
+        r.forwarded = 0;
+        r.returned = 0;
+        m_replicas.push_back(r);
+    }
+
+    uint32_t TricklesLoadBalancer::GetNReplicas (void) const
+    {
+        return(m_replicas.size());
+    }
+
+    uint32_t TricklesLoadBalancer::GetForwarded (uint32_t replica) const
+    {
+        NS_ASSERT(replica<m_replicas.size());
+        return(m_replicas[replica].forwarded);
+    }
+
+    uint32_t TricklesLoadBalancer::Load (const Replica &r) const
+    {
+        // Число переданных запросов без числа продолжений ничего не говорит о нагрузке: запрос может породить несколько продолжений или ни одного
+        if (!r.load.IsNull()) return(r.load());
+        return(0);
+    }
+
+    uint32_t TricklesLoadBalancer::Select (uint32_t trickle)
+    {
+        uint32_t n = m_replicas.size();
+        switch (m_policy) {
+            case HASH: {
+                // Перемешивание, чтобы соседние номера струек не попадали на соседние реплики
+                uint32_t h = trickle*2654435761U;
+                return((h^(h>>16))%n);
+            }
+            case ROUND_ROBIN:
+                return(m_next++%n);
+            case LEAST_QUEUE: {
+                // При равной нагрузке реплики выбираются по очереди
+                uint32_t best = m_next++%n;
+                uint32_t bestLoad = Load(m_replicas[best]);
+                for (uint32_t i = 1; i<n; i++) {
+                    uint32_t c = (best+i)%n;
+                    uint32_t l = Load(m_replicas[c]);
+                    if (l<bestLoad) {
+                        bestLoad = l;
+                        best = c;
+                    }
+                }
+                return(best);
+            }
+        }
+        return(0);
+    }
+
+    Ptr<Packet> TricklesLoadBalancer::Rewrite (Ptr<const Packet> p, const Ipv4Header &header) const
+    {
+        Ptr<Packet> copy = p->Copy();
+        if (!Node::ChecksumEnabled()) return(copy);
+        // Заголовок сериализуется заново и получает сумму по новым адресам и прежним данным
+        TcpHeader tcph;
+        copy->RemoveHeader(tcph);
+        tcph.EnableChecksums();
+        tcph.InitializeChecksum(header.GetSource(), header.GetDestination(), TricklesL4Protocol::PROT_NUMBER);
+        copy->AddHeader(tcph);
+        return(copy);
+    }
+
+    bool TricklesLoadBalancer::Forward (Ptr<Packet> p, const Ipv4Header &header, UnicastForwardCallback ucb, ErrorCallback ecb)
+    {
+        Socket::SocketErrno err;
+        Ptr<Ipv4Route> route = m_ipv4->GetRoutingProtocol()->RouteOutput(p, header, 0, err);
+        if (!route) {
+            NS_LOG_LOGIC("No route to " << header.GetDestination());
+            ecb(p, header, err);
+            return(true);
+        }
+        ucb(route, p, header);
+        return(true);
+    }
+
+    bool TricklesLoadBalancer::RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+                                           UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                                           LocalDeliverCallback lcb, ErrorCallback ecb)
+    {
+        if ((header.GetProtocol() != TricklesL4Protocol::PROT_NUMBER) || m_replicas.empty()) return(false);
+        if (header.GetDestination() == m_vip) {
+            // Запрос клиента: номер струйки нужен только политике HASH
+            uint32_t trickle = 0;
+            if (m_policy == HASH) {
+                Ptr<Packet> copy = p->Copy();
+                TcpHeader tcph;
+                TricklesHeader th;
+                if (copy->RemoveHeader(tcph) && copy->PeekHeader(th)) trickle = th.GetTrickleNumber().GetValue();
+            }
+            Replica &r = m_replicas[Select(trickle)];
+            r.forwarded++;
+            m_forwardTrace(r.address, trickle);
+            Ipv4Header h = header;
+            h.SetDestination(r.address);
+            NS_LOG_LOGIC("Request from " << header.GetSource() << " to replica " << r.address);
+            return(Forward(Rewrite(p, h), h, ucb, ecb));
+        }
+        for (std::vector<Replica>::iterator r = m_replicas.begin(); r != m_replicas.end(); r++) {
+            if (header.GetSource() == r->address) {
+                // Продолжение реплики уходит клиенту от имени виртуального адреса
+                r->returned++;
+                Ipv4Header h = header;
+                h.SetSource(m_vip);
+                return(Forward(Rewrite(p, h), h, ucb, ecb));
+            }
+        }
+        return(false);
+    }
+
+    Ptr<Ipv4Route> TricklesLoadBalancer::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
+    {
+        // Собственные пакеты узла маршрутизируются другими протоколами
+        sockerr = Socket::ERROR_NOROUTETOHOST;
+        return(0);
+    }
+
+    void TricklesLoadBalancer::NotifyInterfaceUp (uint32_t interface)
+    {
+    }
+
+    void TricklesLoadBalancer::NotifyInterfaceDown (uint32_t interface)
+    {
+    }
+
+    void TricklesLoadBalancer::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
+    {
+    }
+
+    void TricklesLoadBalancer::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
+    {
+    }
+
+    void TricklesLoadBalancer::SetIpv4 (Ptr<Ipv4> ipv4)
+    {
+        NS_LOG_FUNCTION (this << ipv4);
+        m_ipv4 = ipv4;
+    }
+
+    void TricklesLoadBalancer::PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const
+    {
+        std::ostream *os = stream->GetStream();
+        *os << "Trickles load balancer " << m_vip << ", " << m_replicas.size() << " replicas\n";
+        for (std::vector<Replica>::const_iterator r = m_replicas.begin(); r != m_replicas.end(); r++) {
+            *os << "  " << r->address << " forwarded " << r->forwarded << " returned " << r->returned << " load " << Load(*r) << "\n";
+        }
+    }
+}
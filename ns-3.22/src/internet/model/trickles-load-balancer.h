@@ -0,0 +1,142 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef TRICKLES_LOAD_BALANCER_H
+#define TRICKLES_LOAD_BALANCER_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ptr.h"
+#include "ns3/callback.h"
+#include "ns3/traced-callback.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv4-routing-protocol.h"
+
+namespace ns3 {
+    class Node;
+    class Packet;
+    class Ipv4Header;
+
+    /**
+     * \ingroup tricklestp
+     * \class TricklesLoadBalancer
+     *
+     * \brief Балансировщик запросов Trickles между репликами сервера без таблицы соединений
+     *
+     * Продолжение содержит все состояние сервера, поэтому любой запрос может обработать любая реплика. Балансировщик устанавливается как протокол маршрутизации узла-маршрутизатора (::Install) и обрабатывает только пакеты Trickles:
+     * - пакет, адресованный виртуальному адресу (VirtualAddress), передается выбранной реплике: адрес назначения заменяется адресом реплики, адрес клиента сохраняется;
+     * - пакет от реплики клиенту (реплики должны отвечать через этот узел) передается с адресом источника VirtualAddress, так что клиент видит один сервер.
+     *
+     * Остальные пакеты обрабатываются следующими протоколами маршрутизации узла. Хранится только список реплик и счетчики на реплику.
+     *
+     * Политики выбора реплики (Policy):
+     * - HASH - хеш номера струйки (одна и та же струйка всегда попадает на одну реплику);
+     * - ROUND_ROBIN - по очереди;
+     * - LEAST_QUEUE - реплика с наименьшей нагрузкой, которую возвращает обработчик, переданный в ::AddReplica (например, TricklesServer::GetQueueLength). Балансировщик сам нагрузку не оценивает: реплика без обработчика считается свободной, а при равной нагрузке реплики выбираются по очереди.
+     *
+     * Контрольная сумма Trickles (как и TCP) вычисляется по псевдозаголовку с адресами IP, поэтому при замене адреса она пересчитывается, если контрольные суммы включены (Node::ChecksumEnabled).
+     *
+     * Виртуальный адрес не должен принадлежать интерфейсам узла: маршрут к нему у клиентов должен вести на балансировщик. Поддерживается только IPv4.
+     */
+    class TricklesLoadBalancer : public Ipv4RoutingProtocol
+    {
+    public:
+        static TypeId GetTypeId (void);
+        TricklesLoadBalancer ();
+        virtual ~TricklesLoadBalancer ();
+
+        /**
+         * \brief Политика выбора реплики
+         */
+        typedef enum {
+            HASH = 0,
+            ROUND_ROBIN = 1,
+            LEAST_QUEUE = 2 } Policy_t;
+        /**
+         * \brief Обработчик, возвращающий нагрузку реплики
+         */
+        typedef Callback<uint32_t> LoadCallback;
+        /**
+         * \brief Сигнатура трассировки Forward: адрес реплики и номер струйки
+         */
+        typedef void (* ForwardCallback)(Ipv4Address replica, uint32_t trickle);
+
+        /**
+         * \brief Добавить балансировщик в список протоколов маршрутизации узла
+         *
+         * Узел должен использовать Ipv4ListRouting (как при установке InternetStackHelper).
+         */
+        void Install (Ptr<Node> node, int16_t priority = 100);
+        /**
+         * \brief Добавить реплику
+         * \param load нагрузка реплики для политики LEAST_QUEUE (без него реплика считается свободной)
+         */
+        void AddReplica (Ipv4Address address, LoadCallback load = LoadCallback ());
+        uint32_t GetNReplicas (void) const;
+        /**
+         * \brief Число запросов, переданных реплике
+         */
+        uint32_t GetForwarded (uint32_t replica) const;
+
+        virtual Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr);
+        virtual bool RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
+                                 UnicastForwardCallback ucb, MulticastForwardCallback mcb,
+                                 LocalDeliverCallback lcb, ErrorCallback ecb);
+        virtual void NotifyInterfaceUp (uint32_t interface);
+        virtual void NotifyInterfaceDown (uint32_t interface);
+        virtual void NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address);
+        virtual void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address);
+        virtual void SetIpv4 (Ptr<Ipv4> ipv4);
+        virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const;
+
+    protected:
+        virtual void DoDispose (void);
+
+    private:
+        struct Replica {
+            Ipv4Address address;
+            LoadCallback load;
+            uint32_t forwarded;
+            uint32_t returned;
+        };
+        /**
+         * \brief Выбрать реплику для струйки trickle
+         */
+        uint32_t Select (uint32_t trickle);
+        uint32_t Load (const Replica &r) const;
+        /**
+         * \brief Копия пакета p с контрольной суммой Trickles для адресов нового заголовка header
+         */
+        Ptr<Packet> Rewrite (Ptr<const Packet> p, const Ipv4Header &header) const;
+        /**
+         * \brief Передать пакет с заголовком header по маршруту узла
+         */
+        bool Forward (Ptr<Packet> p, const Ipv4Header &header, UnicastForwardCallback ucb, ErrorCallback ecb);
+
+        Ptr<Ipv4> m_ipv4;
+        Ipv4Address m_vip;
+        Policy_t m_policy;
+        std::vector<Replica> m_replicas;
+        uint32_t m_next;
+        TracedCallback<Ipv4Address, uint32_t> m_forwardTrace;
+    };
+}
+
+#endif /* TRICKLES_LOAD_BALANCER_H */
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <algorithm>
 #include "ns3/trickles-shieh-header.h"
 #include "ns3/buffer.h"
 #include "ns3/address-utils.h"
@@ -29,9 +30,10 @@ namespace ns3 {
     NS_OBJECT_ENSURE_REGISTERED (TricklesShiehHeader);
     
     uint8_t TricklesShiehHeader::m_magic = 139;
+    uint8_t TricklesShiehHeader::m_magicExt = 140;
     
     TricklesShiehHeader::TricklesShiehHeader ()
-    : m_tcpbase(0), m_startCwnd(0), m_ssthresh(0)
+    : m_tcpbase(0), m_startCwnd(0), m_ssthresh(0), m_options(0), m_wMax(0), m_epochRtt(0), m_baseRtt(0), m_delayFlags(0), m_drainFrom(0), m_hyStartCwnd(0), m_requestBytes(0), m_unitBytes(0)
     {
     }
     
@@ -63,27 +65,164 @@ namespace ns3 {
         m_ssthresh = ssthresh;
     }
     
+    bool TricklesShiehHeader::HasOption(Option_t opt) const {
+        return((m_options & opt) != 0);
+    }
+    
+    void TricklesShiehHeader::SetOption(Option_t opt) {
+        m_options |= opt;
+    }
+    
+    void TricklesShiehHeader::ClearOption(Option_t opt) {
+        m_options &= ~opt;
+    }
+    
+    uint16_t TricklesShiehHeader::GetWMax() const {
+        return(m_wMax);
+    }
+    
+    void TricklesShiehHeader::SetWMax(uint16_t wmax) {
+        m_options |= OPT_CUBIC;
+        m_wMax = wmax;
+    }
+    
+    Time TricklesShiehHeader::GetEpochRtt() const {
+        return(MilliSeconds(m_epochRtt));
+    }
+    
+    void TricklesShiehHeader::SetEpochRtt(Time rtt) {
+        m_options |= OPT_CUBIC;
+        m_epochRtt = std::min<int64_t>(rtt.GetMilliSeconds(), 0xffff);
+    }
+    
+    Time TricklesShiehHeader::GetBaseRtt() const {
+        return(MicroSeconds(m_baseRtt));
+    }
+    
+    void TricklesShiehHeader::SetBaseRtt(Time rtt) {
+        m_options |= OPT_DELAY;
+        m_baseRtt = std::min<int64_t>(rtt.GetMicroSeconds(), 0xffffffff);
+    }
+    
+    bool TricklesShiehHeader::IsSlowStartDone() const {
+        return((m_delayFlags & 0x01) != 0);
+    }
+    
+    void TricklesShiehHeader::SetSlowStartDone(bool done) {
+        m_options |= OPT_DELAY;
+        m_delayFlags = done?(m_delayFlags | 0x01):(m_delayFlags & ~0x01);
+    }
+    
+    uint16_t TricklesShiehHeader::GetDrainFrom() const {
+        return(m_drainFrom);
+    }
+    
+    void TricklesShiehHeader::SetDrainFrom(uint16_t cwnd) {
+        m_options |= OPT_DRAIN;
+        m_drainFrom = cwnd;
+    }
+    
+    uint16_t TricklesShiehHeader::GetHyStartCwnd() const {
+        return(m_hyStartCwnd);
+    }
+    
+    void TricklesShiehHeader::SetHyStartCwnd(uint16_t cwnd) {
+        m_options |= OPT_HYSTART;
+        m_hyStartCwnd = cwnd;
+    }
+    
+    uint16_t TricklesShiehHeader::GetRequestBytes() const {
+        return(m_requestBytes);
+    }
+    
+    void TricklesShiehHeader::SetRequestBytes(uint16_t bytes) {
+        m_options |= OPT_BYTES;
+        m_requestBytes = bytes;
+    }
+    
+    uint16_t TricklesShiehHeader::GetUnitBytes() const {
+        return(m_unitBytes);
+    }
+    
+    void TricklesShiehHeader::SetUnitBytes(uint16_t bytes) {
+        m_options |= OPT_BYTES;
+        m_unitBytes = bytes;
+    }
+    
     uint32_t TricklesShiehHeader::GetSerializedSize (void)  const
     {
-        return (8+1);
+        uint32_t size = 8+1;
+        if (m_options) {
+            size += 1;
+            if (m_options & OPT_CUBIC) size += 4;
+            if (m_options & OPT_DELAY) size += 5;
+            if (m_options & OPT_DRAIN) size += 2;
+            if (m_options & OPT_HYSTART) size += 2;
+            if (m_options & OPT_BYTES) size += 4;
+        }
+        return size;
     }
     void TricklesShiehHeader::Serialize (Buffer::Iterator start)  const
     {
         Buffer::Iterator i = start;
-        i.WriteU8(m_magic);
+        i.WriteU8(m_options?m_magicExt:m_magic);
         i.WriteHtonU32 (m_tcpbase.GetValue());
         i.WriteHtonU16 (m_startCwnd);
         i.WriteHtonU16 (m_ssthresh);
+        if (m_options) {
+            i.WriteU8(m_options);
+            if (m_options & OPT_CUBIC) {
+                i.WriteHtonU16(m_wMax);
+                i.WriteHtonU16(m_epochRtt);
+            }
+            if (m_options & OPT_DELAY) {
+                i.WriteHtonU32(m_baseRtt);
+                i.WriteU8(m_delayFlags);
+            }
+            if (m_options & OPT_DRAIN) {
+                i.WriteHtonU16(m_drainFrom);
+            }
+            if (m_options & OPT_HYSTART) {
+                i.WriteHtonU16(m_hyStartCwnd);
+            }
+            if (m_options & OPT_BYTES) {
+                i.WriteHtonU16(m_requestBytes);
+                i.WriteHtonU16(m_unitBytes);
+            }
+        }
     }
     uint32_t TricklesShiehHeader::Deserialize (Buffer::Iterator start)
     {
         Buffer::Iterator i = start;
-        if (i.ReadU8() != m_magic) {
+        uint8_t magic = i.ReadU8();
+        if ((magic != m_magic) && (magic != m_magicExt)) {
             return 0;
         }
         m_tcpbase = i.ReadNtohU32();
         m_startCwnd = i.ReadNtohU16();
         m_ssthresh = i.ReadNtohU16();
+        m_options = 0;
+        if (magic == m_magicExt) {
+            m_options = i.ReadU8();
+            if (m_options & OPT_CUBIC) {
+                m_wMax = i.ReadNtohU16();
+                m_epochRtt = i.ReadNtohU16();
+            }
+            if (m_options & OPT_DELAY) {
+                m_baseRtt = i.ReadNtohU32();
+                m_delayFlags = i.ReadU8();
+            }
+            if (m_options & OPT_DRAIN) {
+                m_drainFrom = i.ReadNtohU16();
+            }
+            if (m_options & OPT_HYSTART) {
+                m_hyStartCwnd = i.ReadNtohU16();
+            }
+            if (m_options & OPT_BYTES) {
+                m_requestBytes = i.ReadNtohU16();
+                m_unitBytes = i.ReadNtohU16();
+            }
+        }
         return GetSerializedSize ();
     }
     
@@ -102,6 +241,24 @@ namespace ns3 {
     void TricklesShiehHeader::Print (std::ostream &os)  const
     {
         os << "TCPBase=" << m_tcpbase << " startCwnd=" << m_startCwnd << " ssthresh=" << m_ssthresh;
+        if (m_options & OPT_CUBIC) {
+            os << " Wmax=" << m_wMax << " epochRTT=" << m_epochRtt;
+        }
+        if (m_options & OPT_DELAY) {
+            os << " baseRTT=" << m_baseRtt << " ssDone=" << IsSlowStartDone();
+        }
+        if (m_options & OPT_DRAIN) {
+            os << " drainFrom=" << m_drainFrom;
+        }
+        if (m_options & OPT_HYSTART) {
+            os << " hystart=" << m_hyStartCwnd;
+        }
+        if (m_options & OPT_BYTES) {
+            os << " reqBytes=" << m_requestBytes << " unitBytes=" << m_unitBytes;
+        }
+        if (m_options & OPT_REBASE) {
+            os << " rebase";
+        }
     }
 
 } // namespace ns3
@@ -27,6 +27,7 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv6-address.h"
 #include "ns3/sequence-number.h"
+#include "ns3/nstime.h"
 
 namespace ns3 {
     /**
@@ -43,7 +44,44 @@ namespace ns3 {
     {
     private:
         static uint8_t m_magic;
+        /**
+         * \brief Сигнатура заголовка, за основными полями которого следуют дополнительные поля
+         *
+         * Если ни одно дополнительное поле не задано, то заголовок сериализуется с сигнатурой ::m_magic и совпадает с заголовком оригинального протокола.
+         */
+        static uint8_t m_magicExt;
     public:
+        /**
+         * \brief Группы дополнительных полей заголовка
+         *
+         * Дополнительные поля используются модификациями протокола Trickles и передаются только если они заданы.
+         */
+        typedef enum Option_t {
+            /**
+             * Параметры эпохи CUBIC: Wmax и RTT в начале эпохи
+             */
+            OPT_CUBIC = 0x01,
+            /**
+             * Сервер начал новую эпоху управления окном без потерь: клиент должен перейти к ней (полей нет)
+             */
+            OPT_REBASE = 0x02,
+            /**
+             * Параметры управления окном по задержке: минимальное RTT (32 бита, в микросекундах) и признак завершения медленного старта
+             */
+            OPT_DELAY = 0x04,
+            /**
+             * Плавное снижение окна без потерь: от DrainFrom до startCwnd на 1 за каждые 2 струйки, начиная с tcpBase-1
+             */
+            OPT_DRAIN = 0x08,
+            /**
+             * Клиент обнаружил по задержкам конец медленного старта (только в запросе): окно в момент обнаружения
+             */
+            OPT_HYSTART = 0x10,
+            /**
+             * Побайтовый учет окна: размер запроса одной струйки и размер сегмента сервера, к которому приводится рост окна
+             */
+            OPT_BYTES = 0x20 } Option_t;
+
         TricklesShiehHeader ();
         virtual ~TricklesShiehHeader ();
         
@@ -59,6 +97,28 @@ namespace ns3 {
         void SetStartCwnd(uint32_t cwnd);
         uint16_t GetSsthresh() const;
         void SetSsthresh(uint16_t ssthresh);
+        /**
+         * \brief Истина, если в заголовке задана группа дополнительных полей opt
+         */
+        bool HasOption(Option_t opt) const;
+        void SetOption(Option_t opt);
+        void ClearOption(Option_t opt);
+        uint16_t GetWMax() const;
+        void SetWMax(uint16_t wmax);
+        Time GetEpochRtt() const;
+        void SetEpochRtt(Time rtt);
+        Time GetBaseRtt() const;
+        void SetBaseRtt(Time rtt);
+        bool IsSlowStartDone() const;
+        void SetSlowStartDone(bool done);
+        uint16_t GetDrainFrom() const;
+        void SetDrainFrom(uint16_t cwnd);
+        uint16_t GetHyStartCwnd() const;
+        void SetHyStartCwnd(uint16_t cwnd);
+        uint16_t GetRequestBytes() const;
+        void SetRequestBytes(uint16_t bytes);
+        uint16_t GetUnitBytes() const;
+        void SetUnitBytes(uint16_t bytes);
     private:
         /**
          * \brief Значение параметра TCPBase
@@ -72,6 +132,42 @@ namespace ns3 {
          * \brief Значение параметра ssthresh
          */
         uint16_t m_ssthresh;
+        /**
+         * \brief Битовая маска заданных групп дополнительных полей (см. ::Option_t)
+         */
+        uint8_t m_options;
+        /**
+         * \brief Значение окна перед последним уменьшением (Wmax протокола CUBIC)
+         */
+        uint16_t m_wMax;
+        /**
+         * \brief Значение RTT (в миллисекундах) в начале эпохи CUBIC
+         */
+        uint16_t m_epochRtt;
+        /**
+         * \brief Минимальное наблюдавшееся RTT (в микросекундах)
+         */
+        uint32_t m_baseRtt;
+        /**
+         * \brief Флаги управления окном по задержке
+         */
+        uint8_t m_delayFlags;
+        /**
+         * \brief Окно в начале плавного снижения
+         */
+        uint16_t m_drainFrom;
+        /**
+         * \brief Окно, при котором клиент обнаружил конец медленного старта
+         */
+        uint16_t m_hyStartCwnd;
+        /**
+         * \brief Размер запроса (в байтах) одной струйки эпохи
+         */
+        uint16_t m_requestBytes;
+        /**
+         * \brief Размер сегмента сервера (в байтах) - единица роста окна
+         */
+        uint16_t m_unitBytes;
     };
     
 #undef LOG_TRICKLES_SHIEH_PACKET
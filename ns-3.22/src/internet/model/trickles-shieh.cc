@@ -22,6 +22,8 @@
 #include <list>
 #include <limits>
 #include "ns3/log.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
 #include "ns3/assert.h"
 #include "ns3/node.h"
 #include "ns3/inet-socket-address.h"
@@ -41,9 +43,12 @@
 #include "ns3/trickles-socket-factory.h"
 #include "ns3/trickles-socket-base.h"
 #include "ns3/trickles-l4-protocol.h"
+#include "ns3/ipv4-end-point.h"
+#include "ns3/ipv6-end-point.h"
 #include "ns3/tcp-rx-buffer.h"
 #include "ns3/rtt-estimator.h"
 #include "ns3/trickles-shieh.h"
+#include "ns3/trickles-event-log.h"
 
 NS_LOG_COMPONENT_DEFINE ("TricklesShieh");
 
@@ -85,17 +90,66 @@ std::clog << "\n";
                       MakeUintegerAccessor(&TricklesShieh::GetStartSsthresh,
                                            &TricklesShieh::SetStartSsthresh),
                       MakeUintegerChecker<uint32_t>())
+        .AddAttribute("ByteCounting",
+                      "Account the window in bytes: the request size is fixed for the connection and carried in continuations",
+                      BooleanValue(false),
+                      MakeBooleanAccessor(&TricklesShieh::m_byteCounting),
+                      MakeBooleanChecker())
+        .AddAttribute("HyStart",
+                      "Leave slow start on delay increase or a long ack train before losses",
+                      BooleanValue(false),
+                      MakeBooleanAccessor(&TricklesShieh::m_hyStart),
+                      MakeBooleanChecker())
+        .AddAttribute("HyStartLowWindow",
+                      "Window below which HyStart is not applied",
+                      UintegerValue(16),
+                      MakeUintegerAccessor(&TricklesShieh::m_hyStartLowWindow),
+                      MakeUintegerChecker<uint32_t>(1, 0xffff))
+        .AddAttribute("HyStartAckDelta",
+                      "Maximal gap between continuations of one ack train",
+                      TimeValue(MilliSeconds(2)),
+                      MakeTimeAccessor(&TricklesShieh::m_hyStartAckDelta),
+                      MakeTimeChecker())
+        .AddAttribute("HyStartMinSamples",
+                      "Number of RTT samples per round compared for the delay increase",
+                      UintegerValue(8),
+                      MakeUintegerAccessor(&TricklesShieh::m_hyStartMinSamples),
+                      MakeUintegerChecker<uint32_t>(1))
+        .AddTraceSource("CongestionWindow",
+                        "Window of the last in-order continuation the client received",
+                        MakeTraceSourceAccessor(&TricklesShieh::m_window),
+                        "ns3::TracedValue::Uint32Callback")
+        .AddTraceSource("EpochCwnd",
+                        "Start window of the client's current epoch",
+                        MakeTraceSourceAccessor(&TricklesShieh::m_cwnd),
+                        "ns3::TracedValue::Uint32Callback")
+        .AddTraceSource("SlowStartThreshold",
+                        "Slow start threshold of the client's current epoch",
+                        MakeTraceSourceAccessor(&TricklesShieh::m_ssthresh),
+                        "ns3::TracedValue::Uint32Callback")
+        .AddTraceSource("TcpBase",
+                        "First trickle of the client's current epoch",
+                        MakeTraceSourceAccessor(&TricklesShieh::m_tcpBase),
+                        "ns3::SequenceNumber32TracedValueCallback")
+        .AddTraceSource("ServerCwnd",
+                        "Window the server computed for a continuation",
+                        MakeTraceSourceAccessor(&TricklesShieh::m_serverCwndTrace),
+                        "ns3::TricklesShieh::WindowCallback")
+        .AddTraceSource("KilledTrickle",
+                        "Request the server answered with no continuation to halve the window in fast recovery",
+                        MakeTraceSourceAccessor(&TricklesShieh::m_killedTrace),
+                        "ns3::TricklesShieh::TrickleCallback")
         ;
         return tid;
     }
     
-    TricklesShieh::TricklesShieh ():TricklesSocketBase(), m_tcpBase(SequenceNumber32(0)), m_cwnd(ShiehInitialCwnd), m_ssthresh(ShiehInitialSsthresh)
+    TricklesShieh::TricklesShieh ():TricklesSocketBase(), m_initialCwnd(ShiehInitialCwnd), m_initialSsthresh(ShiehInitialSsthresh), m_tcpBase(SequenceNumber32(0)), m_cwnd(ShiehInitialCwnd), m_ssthresh(ShiehInitialSsthresh), m_window(ShiehInitialCwnd), m_eceRearm(SequenceNumber32(0)), m_byteCounting(false), m_hyStart(false), m_hyStartLowWindow(16), m_hyStartAckDelta(MilliSeconds(2)), m_hyStartMinSamples(8), m_hsRoundFirst(SequenceNumber32(0)), m_hsSamples(0), m_pathSaveAt(SequenceNumber32(0)), m_groupJoined(false)
     {
         NS_LOG_FUNCTION_NOARGS ();
     }
     
     TricklesShieh::TricklesShieh(const TricklesShieh &sock)
-    : TricklesSocketBase(sock), m_tcpBase(SequenceNumber32(0)), m_cwnd(ShiehInitialCwnd), m_ssthresh(ShiehInitialSsthresh) {
+    : TricklesSocketBase(sock), m_initialCwnd(sock.m_initialCwnd), m_initialSsthresh(sock.m_initialSsthresh), m_tcpBase(SequenceNumber32(0)), m_cwnd(sock.m_initialCwnd), m_ssthresh(sock.m_initialSsthresh), m_window(sock.m_initialCwnd), m_eceRearm(SequenceNumber32(0)), m_byteCounting(sock.m_byteCounting), m_hyStart(sock.m_hyStart), m_hyStartLowWindow(sock.m_hyStartLowWindow), m_hyStartAckDelta(sock.m_hyStartAckDelta), m_hyStartMinSamples(sock.m_hyStartMinSamples), m_hsRoundFirst(SequenceNumber32(0)), m_hsSamples(0), m_pathSaveAt(SequenceNumber32(0)), m_groupJoined(false) {
         NS_LOG_FUNCTION (this);
    }
     
@@ -109,8 +163,12 @@ std::clog << "\n";
         //NS_LOG_FUNCTION (this);
         m_retries = 0;
         if (m_RcvdRequests.numBlocks()==0) {
+            m_cwnd = m_initialCwnd;
+            m_ssthresh = m_initialSsthresh;
+            SeedFromPath();
+            m_window = m_cwnd;
             m_tcpBase = SequenceNumber32(0);
-            uint32_t i = m_tcpBase.GetValue();
+            uint32_t i = m_tcpBase.Get().GetValue();
             while (m_delayed.size()<m_cwnd) {
                 TricklesHeader trh;
                 trh.SetPacketType(REQUEST);
@@ -119,12 +177,10 @@ std::clog << "\n";
                 trh.SetRecovery(NO_RECOVERY);
                 trh.SetTSVal(GetCurTSVal());
                 trh.SetTSEcr(SequenceNumber32(0));
-                trh.SetRTT(GetMinRto());
+                trh.SetRTT(GetInitialRtt());
                 trh.SetFirstLoss(SequenceNumber32(0));
                 TricklesShiehHeader tsh;
-                tsh.SetTcpBase(m_tcpBase);
-                tsh.SetStartCwnd(m_cwnd);
-                tsh.SetSsthresh(m_ssthresh);
+                ApplyEpoch(tsh);
                 m_RcvdRequests.AddBlock(SequenceNumber32(i),SequenceNumber32(i+1));
                 Ptr<Packet> p = Create<Packet>();
                 p->AddHeader(tsh);
@@ -144,18 +200,16 @@ std::clog << "\n";
         ResetMultiplier();
 
         if (packet->RemoveHeader(tsh)) {
-            std::clog << "\nIncoming: ";
-            LOG_TRICKLES_HEADER(th);
-            LOG_TRICKLES_SHIEH_HEADER(tsh);
-            std::clog << "\n";
+            TRICKLES_EVENT(m_node->GetId(), IncomingEvent(th, tsh));
+            if (!FilterGroupRequest(packet, th, tsh.GetTcpBase())) return;
+            if ((th.GetPacketType()==CONTINUATION) && !m_group.IsInvalid() && !m_groupJoined) JoinGroup(th, tsh);
             if (tsh.GetTcpBase()<= th.GetTrickleNumber()) {
-                PrintState();
                 TricklesSocketBase::ProcessTricklesPacket(packet, th);
                 //std::clog << "Shieh processing: "; LOG_TRICKLES_HEADER(th); std::clog << "\n";
                 
                 if (th.GetPacketType()==CONTINUATION) ProcessShiehRequest(packet, th, tsh);
                 else ProcessShiehContinuation(packet, th, tsh);
-                PrintState();
+                TRICKLES_EVENT(m_node->GetId(), StateEvent());
             } else {
                 //std::clog << "Previous epoch packet";
             }
@@ -163,6 +217,20 @@ std::clog << "\n";
         }
     }
     
+    void TricklesShieh::JoinGroup(const TricklesHeader &th, const TricklesShiehHeader &tsh) {
+        m_groupJoined = true;
+        // Первый участник сам начинает поток группы
+        if (m_RcvdRequests.numBlocks() && (th.GetTrickleNumber()<m_RcvdRequests.firstBlock()->second)) return;
+        NS_LOG_LOGIC("Joining the group stream at trickle " << th.GetTrickleNumber());
+        m_RcvdRequests.Clear();
+        m_RcvdRequests.AddBlock(th.GetTrickleNumber(), th.GetTrickleNumber()+1);
+        m_delayed.clear();
+        m_tcpBase = tsh.GetTcpBase();
+        m_cwnd = tsh.GetStartCwnd();
+        m_ssthresh = tsh.GetSsthresh();
+        m_epoch = tsh;
+    }
+    
     void TricklesShieh::ProcessShiehContinuation(Ptr<Packet> packet, TricklesHeader th, TricklesShiehHeader trh) {
         // Класс-предок обновляет TricklesSack и добавляет данные в очередь приложению
         // он же отлавливает дубликаты, соответственно если пакет до сюда добрался, то он не был дубликатом/некорректным пакетом
@@ -190,19 +258,49 @@ std::clog << "\n";
                 i++;
             }
             if (t>=ShiehDupTrickles) {
+                TraceRetransmission(FAST_RETRANSMIT);
                 TrySendDelayed(true);
             }
         } else {
             if ((th.IsRecovery() != NO_RECOVERY) && (m_RcvdRequests.numBlocks()<2)) {
+                m_recoveryTrace(th.IsRecovery());
                 m_tcpBase = th.GetTrickleNumber();
                 m_cwnd = trh.GetStartCwnd();
                 m_ssthresh = trh.GetSsthresh();
+                m_epoch = trh;
+                // Окно уже снижено из-за потерь
+                m_eceRearm = m_tcpBase.Get()+SequenceNumber32(m_cwnd);
+                // После тайм-аута медленный старт начинается заново
+                m_hsSentAt = Time(0);
+            }
+            if (trh.HasOption(TricklesShiehHeader::OPT_REBASE)) {
+                // Сервер начал новую эпоху без потерь - переводим в нее оставшиеся струйки
+                trh.ClearOption(TricklesShiehHeader::OPT_REBASE);
+                if (trh.GetTcpBase() > m_tcpBase) {
+                    m_tcpBase = trh.GetTcpBase();
+                    m_cwnd = trh.GetStartCwnd();
+                    m_ssthresh = trh.GetSsthresh();
+                    m_epoch = trh;
+                    m_eceRearm = EcnRearm(trh);
+                }
             }
             if (trh.GetTcpBase() < m_tcpBase) {
-                trh.SetTcpBase(m_tcpBase);
-                trh.SetStartCwnd(m_cwnd);
-                trh.SetSsthresh(m_ssthresh);
+                ApplyEpoch(trh);
+            }
+            // ECN-Echo передается не чаще одного раза за эпоху и не раньше, чем сервер будет готов на него реагировать
+            if (th.GetEce()) {
+                SequenceNumber32 never = SequenceNumber32(std::numeric_limits<uint32_t>::max());
+                // Если новая эпоха так и не пришла, эхо потерялось - разрешаем повтор
+                bool lost = (m_eceRearm==never) && (Simulator::Now()-m_eceSentAt>m_rtt->GetEstimate()*2);
+                if ((th.GetTrickleNumber()>=m_eceRearm) || lost) {
+                    m_eceRearm = never;
+                    m_eceSentAt = Simulator::Now();
+                } else th.SetEce(false);
             }
+            // Окно эпохи меняется с каждой струйкой, трассируется окно, в котором пришло продолжение
+            m_window = WindowAt(th, trh, th.GetTrickleNumber());
+            if (m_hyStart && InSlowStart(trh, th.GetTrickleNumber())) HyStartSample(th, trh);
+            if (th.GetTrickleNumber()>=m_pathSaveAt) SavePath(th, trh);
             ResetMultiplier();
             packet->AddHeader(trh);
             packet->AddHeader(th);
@@ -218,6 +316,14 @@ std::clog << "\n";
         TricklesSack s = th.GetSacks();
         SequenceNumber32 parent_trickle = th.GetTrickleNumber();
         SackConstIterator i = s.firstBlock();
+        // Запрос на выход из медленного старта не передается в продолжения
+        uint16_t hyStartCwnd = trh.HasOption(TricklesShiehHeader::OPT_HYSTART)?trh.GetHyStartCwnd():0;
+        trh.ClearOption(TricklesShiehHeader::OPT_HYSTART);
+        if (trh.HasOption(TricklesShiehHeader::OPT_BYTES)) {
+            // Рост окна приводится к сегменту сервера; больше, чем учтено в окне, не отдаем
+            trh.SetUnitBytes(m_segSize);
+            if (trh.GetRequestBytes() && (th.GetRequestSize()>trh.GetRequestBytes())) th.SetRequestSize(trh.GetRequestBytes());
+        }
         
         if (s.numBlocks()>1) {
             // Обнаружены потери
@@ -226,7 +332,7 @@ std::clog << "\n";
             if (th.IsRecovery() == NO_RECOVERY) {
                 // Быстрая ретрансляция
                 i++;
-                uint16_t cwndatloss = tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), SequenceNumber32(firstLoss - 1));
+                uint16_t cwndatloss = WindowAt(th, trh, SequenceNumber32(firstLoss - 1));
                 NS_LOG_DEBUG("Fast recovery with cwnd at loss=" << cwndatloss);
                 if (th.GetTrickleNumber()==i->first) {
                     // Первый пакет после серии потерь
@@ -235,8 +341,8 @@ std::clog << "\n";
                     th.SetFirstLoss(firstLoss);
                     th.SetRecovery(FAST_RETRANSMIT);
                     th.SetRequestSize(0);
-                    trh.SetStartCwnd(cwndatloss/2);
-                    trh.SetSsthresh(cwndatloss/2);
+                    th.ClearObject();
+                    ReduceCwnd(FAST_RETRANSMIT, th, trh, cwndatloss);
                     packet->AddHeader(trh);
                     packet->AddHeader(th);
                     // Добавить этот пакет в очередь к приложению
@@ -249,13 +355,15 @@ std::clog << "\n";
                         th.SetParentNumber(parent_trickle);
                         th.SetTrickleNumber(lossOffset+cwndatloss);
                         th.SetRecovery(FAST_RETRANSMIT);
-                        trh.SetStartCwnd(cwndatloss/2);
-                        trh.SetSsthresh(cwndatloss/2);
+                        ReduceCwnd(FAST_RETRANSMIT, th, trh, cwndatloss);
                         packet->AddHeader(trh);
                         packet->AddHeader(th);
                         // Добавить этот пакет в очередь к приложению
                         QueueToServerApp(packet);
-                    } else NS_LOG_DEBUG("Killed trickle!");
+                    } else {
+                        NS_LOG_DEBUG("Killed trickle!");
+                        m_killedTrace(th.GetTrickleNumber());
+                    }
                 }
             }
             if (th.IsRecovery() == RTO_TIMEOUT) {
@@ -278,8 +386,7 @@ std::clog << "\n";
                     th.SetTrickleNumber(f);
                     th.SetFirstLoss(firstLoss);
                     //th.SetRequestSize(1000);
-                    trh.SetStartCwnd(ShiehInitialCwnd);
-                    trh.SetSsthresh(tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), firstLoss-1)/2);
+                    ReduceCwnd(RTO_TIMEOUT, th, trh, WindowAt(th, trh, firstLoss-1));
                     Ptr<Packet> p = Create<Packet>();
                     p->AddHeader(trh);
                     p->AddHeader(th);
@@ -291,16 +398,22 @@ std::clog << "\n";
         } else {
             if (th.IsRecovery() == NO_RECOVERY) {
                 // Нормальное функционирование/выход из режима восстановления по тайм-ауту
-                uint16_t curcwnd = tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), th.GetTrickleNumber());
-                uint16_t prevcwnd = tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), th.GetTrickleNumber()-1);
+                uint16_t curcwnd = WindowAt(th, trh, th.GetTrickleNumber());
+                uint16_t prevcwnd = WindowAt(th, trh, th.GetTrickleNumber()-1);
                 int16_t cwnddelta = curcwnd-prevcwnd;
                 NS_LOG_DEBUG("Normal/RTO recovery exit. TCPCwnd(k=seq)=" << curcwnd << " TCPCwnd(k=seq-1)=" << prevcwnd << " CwndDelta=" << cwnddelta);
+                m_serverCwndTrace(curcwnd);
                 if (cwnddelta>=0) {
                     th.SetRecovery(NO_RECOVERY);
                     th.SetTrickleNumber(th.GetTrickleNumber()+prevcwnd);
                     th.SetParentNumber(parent_trickle);
+                    if (m_ecn && th.GetEce() && (parent_trickle>=EcnRearm(trh))) ReactToEcn(th, trh);
+                    else if (hyStartCwnd && InSlowStart(trh, parent_trickle)) ReactToHyStart(th, trh, hyStartCwnd);
+                    else UpdateEpoch(th, trh, parent_trickle);
+                    th.SetEce(false);
                     packet->AddHeader(trh);
                     packet->AddHeader(th);
+                    TagPacing(packet, th, curcwnd, 0);
                     NS_LOG_DEBUG("Queuing to server app");
                     //MY_LOG_TRICKLES_PACKET(packet);
                     // Добавить пакет packet в очередь к приложению
@@ -312,11 +425,13 @@ std::clog << "\n";
                         pth.SetTrickleNumber(th.GetTrickleNumber()+i);
                         pth.SetParentNumber(parent_trickle);
                         pth.SetRequestSize(0);
+                        pth.ClearObject();
                         p->AddHeader(ptrh);
                         p->AddHeader(pth);
                         //MY_LOG_TRICKLES_PACKET(p);
                         // Добавить этот пакет в очередь к приложению
                         p->AddPacketTag(tag);
+                        TagPacing(p, th, curcwnd, i);
                         QueueToServerApp(p);
                     }
                 }
@@ -326,22 +441,23 @@ std::clog << "\n";
 //                SequenceNumber32 firstLoss = th.GetFirstLoss();
                 th.SetRecovery(NO_RECOVERY);
                 trh.SetTcpBase(i->second-1);
-                trh.SetStartCwnd(ShiehInitialCwnd);
-                trh.SetSsthresh(trh.GetSsthresh()/2);
+                // Окно на момент тайм-аута уже учтено в ssthresh при входе в восстановление
+                ReduceCwnd(RTO_TIMEOUT, th, trh, trh.GetSsthresh());
+                m_serverCwndTrace(trh.GetStartCwnd());
                 packet->AddHeader(trh);
                 packet->AddHeader(th);
                 QueueToServerApp(packet);
             }
             if (th.IsRecovery() == FAST_RETRANSMIT) {
                 SequenceNumber32 firstLoss = th.GetFirstLoss();
-                uint16_t cwndatloss = tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), SequenceNumber32(firstLoss-1));
+                uint16_t cwndatloss = WindowAt(th, trh, SequenceNumber32(firstLoss-1));
                 NS_LOG_DEBUG("Fast retransmit recovery exit");
                 th.SetRecovery(NO_RECOVERY);
                 th.SetTrickleNumber(firstLoss+SequenceNumber32(cwndatloss)+SequenceNumber32(1));
                 th.SetParentNumber(parent_trickle);
-                trh.SetStartCwnd(cwndatloss/2);
-                trh.SetSsthresh(cwndatloss/2);
+                ReduceCwnd(FAST_RETRANSMIT, th, trh, cwndatloss);
                 trh.SetTcpBase(firstLoss+SequenceNumber32(cwndatloss));
+                m_serverCwndTrace(trh.GetStartCwnd());
                 packet->AddHeader(trh);
                 packet->AddHeader(th);
                 // Добавить пакет packet в очередь к приложению
@@ -350,7 +466,188 @@ std::clog << "\n";
         }
     }
     
-    uint16_t TricklesShieh::tcpCwnd(SequenceNumber32 tcpBase, uint16_t cwnd, uint16_t ssthresh, SequenceNumber32 k) const {
+    uint16_t TricklesShieh::CwndAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        return(tcpCwnd(trh.GetTcpBase(), trh.GetStartCwnd(), trh.GetSsthresh(), k, ByteScale(trh)));
+    }
+    
+    double TricklesShieh::ByteScale(const TricklesShiehHeader &trh) const {
+        if (!trh.HasOption(TricklesShiehHeader::OPT_BYTES) || !trh.GetRequestBytes() || !trh.GetUnitBytes()) return(1.0);
+        return((double)trh.GetUnitBytes()/trh.GetRequestBytes());
+    }
+    
+    uint16_t TricklesShieh::WindowAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        if (trh.HasOption(TricklesShiehHeader::OPT_DRAIN)) {
+            int64_t from = trh.GetDrainFrom();
+            int64_t n = k-(trh.GetTcpBase()-1);
+            if (n<2*std::max<int64_t>(from-trh.GetStartCwnd(), 0)) return(from-std::max<int64_t>(n, 0)/2);
+            return(CwndAt(th, LawEpoch(trh), k));
+        }
+        return(CwndAt(th, trh, k));
+    }
+    
+    TricklesShiehHeader TricklesShieh::LawEpoch(const TricklesShiehHeader &trh) const {
+        if (!trh.HasOption(TricklesShiehHeader::OPT_DRAIN)) return(trh);
+        // После снижения окна эпоха варианта начинается с окна startCwnd
+        TricklesShiehHeader law = trh;
+        law.ClearOption(TricklesShiehHeader::OPT_DRAIN);
+        law.SetTcpBase(trh.GetTcpBase()-1+2*std::max<int32_t>(trh.GetDrainFrom()-trh.GetStartCwnd(), 0));
+        return(law);
+    }
+    
+    SequenceNumber32 TricklesShieh::EcnRearm(const TricklesShiehHeader &trh) const {
+        // После снижения окна отметки CE в течение еще одного окна вызваны старой очередью
+        if (!trh.HasOption(TricklesShiehHeader::OPT_DRAIN)) return(trh.GetTcpBase());
+        return(LawEpoch(trh).GetTcpBase()+SequenceNumber32(trh.GetStartCwnd()));
+    }
+    
+    void TricklesShieh::ReactToEcn(const TricklesHeader &th, TricklesShiehHeader &trh) const {
+        SequenceNumber32 m = th.GetTrickleNumber();
+        uint16_t cwnd = WindowAt(th, trh, m-1);
+        NS_LOG_DEBUG("ECN-Echo: window " << cwnd << " is reduced from trickle " << m);
+        // Снижение такое же, как при быстрой повторной передаче, но без потерь: окно уменьшается постепенно
+        ReduceCwnd(FAST_RETRANSMIT, th, trh, cwnd);
+        StartDrain(th, trh, cwnd);
+    }
+    
+    void TricklesShieh::StartDrain(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        if (trh.GetStartCwnd()>cwnd) trh.SetStartCwnd(cwnd);
+        if (trh.GetStartCwnd()<1) trh.SetStartCwnd(1);
+        trh.SetTcpBase(th.GetTrickleNumber());
+        trh.SetDrainFrom(cwnd);
+        trh.SetOption(TricklesShiehHeader::OPT_REBASE);
+    }
+    
+    void TricklesShieh::ReactToHyStart(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        uint16_t current = WindowAt(th, trh, th.GetTrickleNumber()-1);
+        // За время доставки запроса окно выросло - возвращаемся к окну в момент обнаружения
+        uint16_t target = std::max<uint16_t>(std::min(cwnd, current), 1);
+        NS_LOG_DEBUG("HyStart: slow start ends at trickle " << th.GetTrickleNumber() << " window " << current << "->" << target);
+        ExitSlowStart(th, trh, target);
+        StartDrain(th, trh, current);
+    }
+    
+    bool TricklesShieh::InSlowStart(const TricklesShiehHeader &trh, SequenceNumber32 k) const {
+        if (trh.HasOption(TricklesShiehHeader::OPT_DRAIN)) return(false);
+        SequenceNumber32 A = SequenceNumber32(trh.GetTcpBase().GetValue()-trh.GetStartCwnd()+trh.GetSsthresh());
+        return(k<A);
+    }
+    
+    void TricklesShieh::ExitSlowStart(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        trh.SetStartCwnd(cwnd);
+        trh.SetSsthresh(cwnd);
+    }
+    
+    void TricklesShieh::HyStartSample(const TricklesHeader &th, TricklesShiehHeader &trh) {
+        Time now = Simulator::Now();
+        Time rtt = th.GetRTT();
+        // Раунд заканчивается, когда приходит продолжение, порожденное запросом этого раунда
+        if (th.GetParentNumber()>=m_hsRoundFirst) {
+            m_hsRoundFirst = th.GetTrickleNumber();
+            m_hsRoundStart = now;
+            m_hsLastAck = now;
+            m_hsCurRtt = Time(0);
+            m_hsSamples = 0;
+        }
+        if (!rtt.IsZero()) {
+            if (m_hsMinRtt.IsZero() || (rtt<m_hsMinRtt)) m_hsMinRtt = rtt;
+            if (m_hsSamples<m_hyStartMinSamples) {
+                if (m_hsCurRtt.IsZero() || (rtt<m_hsCurRtt)) m_hsCurRtt = rtt;
+                m_hsSamples++;
+            }
+        }
+        // Разрыв больше AckDelta завершает цепочку до конца раунда
+        bool train = (now-m_hsLastAck<=m_hyStartAckDelta);
+        if (train) m_hsLastAck = now;
+        // Запрос уже отправлен; повторяем, если ответ не пришел за 2 RTT
+        if (!m_hsSentAt.IsZero() && (now-m_hsSentAt<=m_rtt->GetEstimate()*2)) return;
+        uint16_t cwnd = WindowAt(th, trh, th.GetTrickleNumber());
+        if ((cwnd<m_hyStartLowWindow) || m_hsMinRtt.IsZero()) return;
+        
+        // Ack train: продолжения идут плотно дольше половины минимального RTT
+        bool found = train && (now-m_hsRoundStart>=m_hsMinRtt/2);
+        // Delay increase: минимальное RTT первых отсчетов раунда выросло больше чем на eta
+        if (m_hsSamples>=m_hyStartMinSamples) {
+            Time eta = std::min(std::max(m_hsMinRtt/8, MilliSeconds(4)), MilliSeconds(16));
+            if (m_hsCurRtt>=m_hsMinRtt+eta) found = true;
+        }
+        if (found) {
+            NS_LOG_DEBUG("HyStart exit at trickle " << th.GetTrickleNumber() << " cwnd=" << cwnd << " minRTT=" << m_hsMinRtt << " roundRTT=" << m_hsCurRtt);
+            trh.SetHyStartCwnd(cwnd);
+            m_hsSentAt = now;
+        }
+    }
+    
+    void TricklesShieh::ReduceCwnd(Recovery_t reason, const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const {
+        trh.ClearOption(TricklesShiehHeader::OPT_DRAIN);
+        if (reason == RTO_TIMEOUT) {
+            trh.SetStartCwnd(ShiehInitialCwnd);
+        } else {
+            trh.SetStartCwnd(cwnd/2);
+        }
+        trh.SetSsthresh(cwnd/2);
+    }
+    
+    void TricklesShieh::UpdateEpoch(const TricklesHeader &th, TricklesShiehHeader &trh, SequenceNumber32 k) const {
+    }
+    
+    void TricklesShieh::TagPacing(Ptr<Packet> packet, const TricklesHeader &th, uint16_t cwnd, uint16_t index) const {
+        // Окно cwnd продолжений должно растянуться на RTT: index-е продолжение запроса отправляется на index/cwnd RTT позже первого
+        if (th.GetRTT().IsZero() || !cwnd || !index) return;
+        TricklesPacingTag tag;
+        tag.SetDelay(NanoSeconds(th.GetRTT().GetNanoSeconds()*index/cwnd));
+        packet->AddPacketTag(tag);
+    }
+    
+    void TricklesShieh::ApplyEpoch(TricklesShiehHeader &trh) const {
+        trh = m_epoch;
+        trh.SetTcpBase(m_tcpBase);
+        trh.SetStartCwnd(m_cwnd);
+        trh.SetSsthresh(m_ssthresh);
+        // Размер запроса фиксируется первым запросом соединения
+        if (m_byteCounting && !trh.HasOption(TricklesShiehHeader::OPT_BYTES)) trh.SetRequestBytes(m_segSize);
+    }
+    
+    bool TricklesShieh::GetPeerHost(Address &host) const {
+        // В многопутевом режиме у соединения нет одного сервера
+        if (GetNPaths()) return(false);
+        if (m_endPoint != 0) {
+            host = m_endPoint->GetPeerAddress();
+            return(true);
+        }
+        if (m_endPoint6 != 0) {
+            host = m_endPoint6->GetPeerAddress();
+            return(true);
+        }
+        return(false);
+    }
+    
+    void TricklesShieh::SeedFromPath() {
+        Address host;
+        Time srtt;
+        uint32_t cwnd, ssthresh;
+        m_pathSaveAt = SequenceNumber32(0);
+        if (!m_trickles || !GetPeerHost(host) || !m_trickles->LookupPathState(host, srtt, cwnd, ssthresh)) return;
+        NS_LOG_DEBUG("Path cache: RTT=" << srtt << " cwnd=" << cwnd << " ssthresh=" << ssthresh);
+        if (!srtt.IsZero()) m_rtt->Measurement(srtt);
+        // Начальные запросы идут с окном startCwnd, поэтому оно не может превышать ssthresh
+        m_ssthresh = std::min<uint32_t>(std::max<uint32_t>(ssthresh, m_cwnd), 0xffff);
+        m_cwnd = std::max<uint32_t>(m_cwnd, std::min<uint32_t>(cwnd, m_ssthresh));
+    }
+    
+    void TricklesShieh::SavePath(const TricklesHeader &th, const TricklesShiehHeader &trh) {
+        Address host;
+        if (!m_trickles || !GetPeerHost(host)) return;
+        uint16_t cwnd = WindowAt(th, trh, th.GetTrickleNumber());
+        m_trickles->SavePathState(host, m_rtt->GetEstimate(), cwnd, trh.GetSsthresh());
+        m_pathSaveAt = th.GetTrickleNumber()+SequenceNumber32(std::max<uint16_t>(cwnd, 1));
+    }
+    
+    uint32_t TricklesShieh::RequestSize(const TricklesShiehHeader &tsh) const {
+        if (tsh.HasOption(TricklesShiehHeader::OPT_BYTES) && tsh.GetRequestBytes()) return(tsh.GetRequestBytes());
+        return(m_segSize);
+    }
+    
+    uint16_t TricklesShieh::tcpCwnd(SequenceNumber32 tcpBase, uint16_t cwnd, uint16_t ssthresh, SequenceNumber32 k, double scale) const {
         
         SequenceNumber32 A = SequenceNumber32(tcpBase.GetValue()-cwnd+ssthresh);
         NS_LOG_FUNCTION (this << "tcpBase=" << tcpBase << " startCwnd=" << cwnd << " ssthresh=" << ssthresh << " k=" << k << " A=" << A);
@@ -361,8 +658,10 @@ std::clog << "\n";
         if (k<=(A+SequenceNumber32(ssthresh))) {
             result = ssthresh;
         } else {
-            double zero = 0.5+sqrt(0.25+ssthresh*ssthresh-ssthresh+2.0*(k-A));
-            NS_ASSERT(fabs(((zero-1.0)*zero-(ssthresh-1.0)*ssthresh)/2.0-(k-A))<0.001);
+            // Каждая струйка увеличивает окно на scale/cwnd
+            double n = scale*(k-A);
+            double zero = 0.5+sqrt(0.25+ssthresh*ssthresh-ssthresh+2.0*n);
+            NS_ASSERT(fabs(((zero-1.0)*zero-(ssthresh-1.0)*ssthresh)/2.0-n)<0.001);
             result = ceil(zero);
         }
 
@@ -374,31 +673,32 @@ std::clog << "\n";
     void TricklesShieh::DelayPacket(Ptr<Packet> packet) {
         //NS_LOG_FUNCTION (this);
         TricklesHeader trh;
-        NS_ASSERT(packet->PeekHeader(trh));
         TricklesShiehHeader tsh;
         packet->RemoveHeader(trh);
-        NS_ASSERT(packet->PeekHeader(tsh));
+        packet->PeekHeader(tsh);
         packet->AddHeader(trh);
-        NS_ASSERT(packet->PeekHeader(trh));
         if (m_delayed.find(trh.GetTrickleNumber()) == m_delayed.end()) {
-            m_delayed[trh.GetTrickleNumber()]=packet;
+            // Размер запоминается сейчас, пока заголовки уже разобраны
+            DelayedRequest &r = m_delayed[trh.GetTrickleNumber()];
+            r.packet = packet;
+            r.size = RequestSize(tsh);
         }
     }
     
     void TricklesShieh::TrySendDelayed(bool fastrx) {
         //NS_LOG_FUNCTION (this);
-        std::map<SequenceNumber32, Ptr<Packet> >::iterator it = m_delayed.begin();
-        uint32_t newReqSize = 0;
+        std::map<SequenceNumber32, DelayedRequest>::iterator it = m_delayed.begin();
         // In-order packet transmission
         while (it != m_delayed.end()) {
-            if ((m_reqDataSize-newReqSize)<m_segSize) break;
-            Ptr<Packet> p = it->second;
+            Ptr<Packet> p = it->second.packet;
+            // Send() already debits m_reqDataSize for every request
+            uint32_t reqSize = NextRequestSize(it->second.size);
+            if (!reqSize) break;
             TricklesHeader th;
             p->PeekHeader(th);
             if ((fastrx) || (th.GetTrickleNumber()<m_RcvdRequests.firstLoss())) {
                 p->RemoveHeader(th);
-                th.SetRequestSize(m_segSize);
-                newReqSize += m_segSize;
+                th.SetRequestSize(reqSize);
                 th.SetSacks(m_RcvdRequests);
                 it = m_delayed.erase(it);
                 p->AddHeader(th);
@@ -411,13 +711,16 @@ std::clog << "\n";
     
     void TricklesShieh::ReTxTimeout() {
         NS_LOG_FUNCTION(this);
-        if ((m_retxEvent.IsExpired()) && (m_RcvdRequests.numBlocks()>1)) {
+        // С резервными серверами молчание сервера тоже считается тайм-аутом, даже без пропусков в струйках, но только если клиент ждет ответа
+        bool silent = !m_replicas.empty() && IsPeerSilent() && HasOutstandingRequests();
+        if ((m_retxEvent.IsExpired()) && ((m_RcvdRequests.numBlocks()>1) || silent)) {
             m_retries++;
+            if (m_failoverRetries && !m_replicas.empty() && (++m_rtoStreak%m_failoverRetries == 0)) Failover();
+            TraceRetransmission(RTO_TIMEOUT);
             TricklesHeader trh;
             trh.SetPacketType(REQUEST);
             SackConstIterator i = m_RcvdRequests.firstBlock();
             trh.SetTrickleNumber(i->second);
-            trh.SetRequestSize(m_segSize);
             trh.SetRecovery(RTO_TIMEOUT);
             trh.SetTSVal(GetCurTSVal());
             trh.SetTSEcr(SequenceNumber32(0));
@@ -425,9 +728,8 @@ std::clog << "\n";
             trh.SetFirstLoss(i->second);
             trh.SetSacks(m_RcvdRequests);
             TricklesShiehHeader tsh;
-            tsh.SetTcpBase(m_tcpBase);
-            tsh.SetStartCwnd(m_cwnd);
-            tsh.SetSsthresh(m_ssthresh);
+            ApplyEpoch(tsh);
+            trh.SetRequestSize(RequestSize(tsh));
             Ptr<Packet> p = Create<Packet> ();
             p->AddHeader(tsh);
             p->AddHeader(trh);
@@ -437,6 +739,58 @@ std::clog << "\n";
         }
     }
     
+    void TricklesShieh::TraceRetransmission(Recovery_t reason) {
+        m_retransmissionTrace(reason);
+        if (!m_RcvdRequests.numBlocks()) return;
+        SackConstIterator i = m_RcvdRequests.firstBlock();
+        if (m_RcvdRequests.numBlocks()<2) {
+            m_retxTricklesTrace(i->second, i->second+1);
+            return;
+        }
+        SackConstIterator next = i;
+        for (next++; !m_RcvdRequests.isEnd(next); i = next++) {
+            m_retxTricklesTrace(i->second, next->first);
+        }
+    }
+    
+    uint32_t TricklesShieh::GetStateSize (void) const {
+        uint32_t size = TricklesSocketBase::GetStateSize()+sizeof(*this)-sizeof(TricklesSocketBase);
+        for (std::map<SequenceNumber32, DelayedRequest>::const_iterator i = m_delayed.begin(); i != m_delayed.end(); i++) {
+            size += i->second.packet->GetSize()+sizeof(SequenceNumber32)+sizeof(DelayedRequest)+32;
+        }
+        return(size);
+    }
+    
+    TricklesEvent TricklesShieh::IncomingEvent(const TricklesHeader &th, const TricklesShiehHeader &tsh) const {
+        TricklesEvent e;
+        e.time = Simulator::Now().GetNanoSeconds();
+        e.type = TricklesEvent::INCOMING;
+        e.trickle = th.GetTrickleNumber().GetValue();
+        e.parent = th.GetParentNumber().GetValue();
+        e.tcpBase = tsh.GetTcpBase().GetValue();
+        e.size = th.GetRequestSize();
+        e.cwnd = tsh.GetStartCwnd();
+        e.ssthresh = tsh.GetSsthresh();
+        e.blocks = th.GetSacks().numBlocks();
+        e.flags = (th.GetPacketType()<<4) | th.IsRecovery();
+        return(e);
+    }
+    
+    TricklesEvent TricklesShieh::StateEvent() const {
+        TricklesEvent e;
+        e.time = Simulator::Now().GetNanoSeconds();
+        e.type = TricklesEvent::STATE;
+        e.trickle = m_tcpBase.Get().GetValue();
+        e.parent = m_RcvdRequests.numBlocks()?m_RcvdRequests.firstBlock()->first.GetValue():0;
+        e.tcpBase = m_tcpBase.Get().GetValue();
+        e.size = m_reqDataSize;
+        e.cwnd = std::min<uint32_t>(m_cwnd, 0xffff);
+        e.ssthresh = std::min<uint32_t>(m_ssthresh, 0xffff);
+        e.blocks = m_RcvdRequests.numBlocks();
+        e.flags = std::min<uint16_t>(m_retries, 0xff);
+        return(e);
+    }
+    
     /*void TricklesShieh::PrintState() {
         // TricklesSocketBase::PrintState();
         std::clog << "TCPBase: " << m_tcpBase << "; StartCwnd: " << m_cwnd << "; StartSSthresh: " << m_ssthresh << "; Delayed size: " << m_delayed.size();
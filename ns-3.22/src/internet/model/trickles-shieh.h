@@ -25,6 +25,7 @@
 #include <queue>
 #include "ns3/callback.h"
 #include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
 #include "ns3/socket.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
@@ -35,6 +36,8 @@
 #include "tcp-rx-buffer.h"
 #include "rtt-estimator.h"
 #include "trickles-socket-base.h"
+#include "trickles-shieh-header.h"
+#include "trickles-event-log.h"
 
 namespace ns3 {
     
@@ -63,26 +66,234 @@ namespace ns3 {
         TricklesShieh ();
         TricklesShieh(const TricklesShieh &sock);
         virtual ~TricklesShieh ();
+        /**
+         * \brief Signature of the ServerCwnd trace source
+         */
+        typedef void (* WindowCallback)(uint16_t cwnd);
+        /**
+         * \brief Signature of the KilledTrickle trace source
+         */
+        typedef void (* TrickleCallback)(SequenceNumber32 trickle);
+        /**
+         * \brief State size of the base class plus the delayed requests
+         */
+        virtual uint32_t GetStateSize (void) const;
         
     protected:
         virtual void ProcessTricklesPacket(Ptr<Packet> packet, TricklesHeader &th);
         virtual void NewRequest();
+        /**
+         * \brief Congestion window the server assigns to trickle k
+         *
+         * The window must be a pure function of the continuation fields and k,
+         * otherwise concurrent trickles would produce duplicate or missing
+         * trickle numbers. Variants override it to change the growth law.
+         */
+        virtual uint16_t CwndAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        /**
+         * \brief Update the continuation after a congestion signal
+         * \param reason FAST_RETRANSMIT or RTO_TIMEOUT
+         * \param cwnd window at the moment the congestion was detected
+         *
+         * Sets startCwnd and ssthresh (and any variant-specific fields) of trh.
+         */
+        virtual void ReduceCwnd(Recovery_t reason, const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
+        /**
+         * \brief Start a new window epoch without a loss
+         * \param th request header; its trickle number is already the first continuation to be emitted
+         * \param trh continuation fields the request carried, rewritten in place
+         * \param k number of the request being processed
+         *
+         * Called for every request that emits continuations in normal operation.
+         * A variant that changes trh here must set OPT_REBASE, keep the window at
+         * th.GetTrickleNumber()-1 unchanged and do so for exactly one request per
+         * epoch; the client then moves the remaining trickles to the new epoch.
+         */
+        virtual void UpdateEpoch(const TricklesHeader &th, TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        /**
+         * \brief Is trickle k in the slow start of the epoch trh
+         *
+         * Only slow start may be ended by HyStart. Variants with their own
+         * slow start exit return false.
+         */
+        virtual bool InSlowStart(const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        /**
+         * \brief Leave slow start at window cwnd
+         *
+         * Sets startCwnd and ssthresh (and any variant-specific fields) of trh so
+         * that the window stays cwnd and then grows as in congestion avoidance.
+         */
+        virtual void ExitSlowStart(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
+        /**
+         * \brief Window of the original protocol
+         * \param scale congestion avoidance growth per RTT (trickles), see ByteScale()
+         */
+        uint16_t tcpCwnd(SequenceNumber32 tcpBase, uint16_t cwnd, uint16_t ssthresh, SequenceNumber32 k, double scale=1.0) const;
+        /**
+         * \brief Number of trickles that make up one server segment
+         *
+         * With OPT_BYTES the window grows by one server segment per RTT in
+         * congestion avoidance whatever the request size, so flows with small
+         * requests grow faster in trickles and the same in bytes. Slow start is
+         * not scaled: one trickle per trickle doubles the window every RTT, which
+         * is the same growth in trickles and in bytes. Returns 1 without OPT_BYTES.
+         */
+        double ByteScale(const TricklesShiehHeader &trh) const;
+        /**
+         * \brief Window of trickle k including a pending ECN reduction
+         *
+         * While an OPT_DRAIN reduction is in progress the window decreases by one
+         * every two trickles, afterwards CwndAt() is applied to LawEpoch(trh).
+         */
+        uint16_t WindowAt(const TricklesHeader &th, const TricklesShiehHeader &trh, SequenceNumber32 k) const;
+        /**
+         * \brief Continuation fields CwndAt() sees once the reduction is over
+         */
+        TricklesShiehHeader LawEpoch(const TricklesShiehHeader &trh) const;
+        /**
+         * \brief Attach the send delay of the index-th continuation a request releases (see ns3::TricklesPacingTag)
+         * \param th header of the first continuation of the request, carries the RTT sample
+         * \param cwnd window at the request
+         *
+         * The delay is index*RTT/cwnd, computed from the request alone.
+         */
+        void TagPacing(Ptr<Packet> packet, const TricklesHeader &th, uint16_t cwnd, uint16_t index) const;
+        /**
+         * \brief End slow start on the request of the client (OPT_HYSTART)
+         */
+        void ReactToHyStart(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
+        /**
+         * \brief Client side HyStart: look for delay increase and ack train in continuation th
+         */
+        void HyStartSample(const TricklesHeader &th, TricklesShiehHeader &trh);
     private:
+        /**
+         * \brief First trickle that may trigger another ECN reduction
+         */
+        SequenceNumber32 EcnRearm(const TricklesShiehHeader &trh) const;
+        /**
+         * \brief Start a gradual window reduction after an ECN-Echo
+         */
+        void ReactToEcn(const TricklesHeader &th, TricklesShiehHeader &trh) const;
+        /**
+         * \brief Start a gradual window reduction from the current window down to trh.GetStartCwnd()
+         */
+        void StartDrain(const TricklesHeader &th, TricklesShiehHeader &trh, uint16_t cwnd) const;
         void TrySendDelayed(bool fastrx=false);
         void ProcessShiehContinuation(Ptr<Packet> packet, TricklesHeader th, TricklesShiehHeader trh);
         void ProcessShiehRequest(Ptr<Packet> packet, TricklesHeader th, TricklesShiehHeader trh);
-        uint16_t tcpCwnd(SequenceNumber32 tcpBase, uint16_t cwnd, uint16_t ssthresh, SequenceNumber32 k) const;
         void DelayPacket(Ptr<Packet> packet);
         void ReTxTimeout();
-        uint32_t GetStartCwnd() const { return m_cwnd; };
-        void SetStartCwnd(uint32_t i) { NS_ASSERT(i>=1); m_cwnd = i; };
-        uint32_t GetStartSsthresh() const { return m_ssthresh; };
-        void SetStartSsthresh(uint32_t i) { m_ssthresh = i; };
-        SequenceNumber32 m_tcpBase;
-        uint32_t m_cwnd;
-        uint32_t m_ssthresh;
-        std::map<SequenceNumber32, Ptr<Packet> > m_delayed;
+        /**
+         * \brief Сообщить о повторном запросе струек (трассировки Retransmission и RetransmittedTrickles)
+         *
+         * Сообщаются все пропуски в полученных струйках, а без пропусков - первая ожидаемая струйка.
+         */
+        void TraceRetransmission(Recovery_t reason);
+        /**
+         * \brief Присоединиться к идущему потоку группы: перейти к струйке и эпохе первого полученного продолжения
+         */
+        void JoinGroup(const TricklesHeader &th, const TricklesShiehHeader &tsh);
+        void ApplyEpoch(TricklesShiehHeader &trh) const;
+        /**
+         * \brief Start a new connection from the node's path cache (see ns3::TricklesL4Protocol::LookupPathState)
+         *
+         * Raises the window and ssthresh of the connection above StartCwnd and StartSsthresh,
+         * the attributes themselves are not changed.
+         */
+        void SeedFromPath();
+        /**
+         * \brief Store the current RTT and window in the node's path cache (once per window)
+         */
+        void SavePath(const TricklesHeader &th, const TricklesShiehHeader &trh);
+        /**
+         * \brief Address of the remote host, without the port
+         */
+        bool GetPeerHost(Address &host) const;
+        /**
+         * \brief Size of a request of epoch tsh: the request size of the epoch with OPT_BYTES, m_segSize otherwise
+         */
+        uint32_t RequestSize(const TricklesShiehHeader &tsh) const;
+        /**
+         * \brief Event log records of an incoming packet and of the client state after it
+         */
+        TricklesEvent IncomingEvent(const TricklesHeader &th, const TricklesShiehHeader &tsh) const;
+        TricklesEvent StateEvent() const;
+        uint32_t GetStartCwnd() const { return m_initialCwnd; };
+        void SetStartCwnd(uint32_t i) { NS_ASSERT(i>=1); m_initialCwnd = i; m_cwnd = i; };
+        uint32_t GetStartSsthresh() const { return m_initialSsthresh; };
+        void SetStartSsthresh(uint32_t i) { m_initialSsthresh = i; m_ssthresh = i; };
+        /**
+         * Окно и порог медленного старта, с которых начинается соединение (атрибуты StartCwnd и StartSsthresh)
+         */
+        uint32_t m_initialCwnd;
+        uint32_t m_initialSsthresh;
+        /**
+         * Client state of the current epoch: first trickle, start window and ssthresh (trace sources TcpBase, EpochCwnd, SlowStartThreshold)
+         */
+        TracedValue<SequenceNumber32> m_tcpBase;
+        TracedValue<uint32_t> m_cwnd;
+        TracedValue<uint32_t> m_ssthresh;
+        /**
+         * Window of the last in-order continuation, WindowAt() of its trickle (trace source CongestionWindow)
+         */
+        TracedValue<uint32_t> m_window;
+        /**
+         * Window the server computed for a continuation (trace source ServerCwnd)
+         */
+        TracedCallback<uint16_t> m_serverCwndTrace;
+        /**
+         * Trickle the server ended during fast recovery to shrink the window (trace source KilledTrickle)
+         */
+        TracedCallback<SequenceNumber32> m_killedTrace;
+        /**
+         * Дополнительные поля текущей эпохи (параметры вариантов протокола)
+         */
+        TricklesShiehHeader m_epoch;
+        /**
+         * Первое продолжение, отметку CE которого можно передать серверу
+         */
+        SequenceNumber32 m_eceRearm;
+        /**
+         * Время отправки последнего ECN-Echo
+         */
+        Time m_eceSentAt;
+        bool m_byteCounting;
+        bool m_hyStart;
+        uint32_t m_hyStartLowWindow;
+        Time m_hyStartAckDelta;
+        uint32_t m_hyStartMinSamples;
+        /**
+         * Состояние HyStart на клиенте: начало текущего раунда (первая струйка и время),
+         * время последнего продолжения в цепочке, минимальное RTT за все время и за раунд
+         */
+        SequenceNumber32 m_hsRoundFirst;
+        Time m_hsRoundStart;
+        Time m_hsLastAck;
+        Time m_hsMinRtt;
+        Time m_hsCurRtt;
+        uint32_t m_hsSamples;
+        /**
+         * Время отправки запроса на выход из медленного старта (ноль - не отправлялся)
+         */
+        Time m_hsSentAt;
+        /**
+         * Струйка, по приходу которой состояние пути снова сохраняется в кэш узла
+         */
+        SequenceNumber32 m_pathSaveAt;
+        /**
+         * Запрос, ожидающий отправки, и размер данных, который он запросит
+         */
+        struct DelayedRequest {
+            Ptr<Packet> packet;
+            uint32_t size;
+        };
+        std::map<SequenceNumber32, DelayedRequest> m_delayed;
         EventId m_retxEvent;
+        /**
+         * Клиент группового режима уже получил продолжение группы
+         */
+        bool m_groupJoined;
     };
     
 } // namespace ns3
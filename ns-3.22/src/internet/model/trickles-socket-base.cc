@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <queue>
+#include <algorithm>
 #include "ns3/log.h"
 #include "ns3/assert.h"
 #include "ns3/node.h"
@@ -34,6 +35,8 @@
 #include "ns3/ipv6-routing-protocol.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/ipv4-packet-info-tag.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
 #include "trickles-socket-factory.h"
 #include "trickles-socket-base.h"
 #include "trickles-l4-protocol.h"
@@ -45,11 +48,17 @@
 #include "tcp-rx-buffer.h"
 #include "rtt-estimator.h"
 #include <limits>
+#include <cmath>
 
 NS_LOG_COMPONENT_DEFINE ("TricklesSocketBase");
 
 namespace ns3 {
     
+    /**
+     * Число запросов пути в окне оценки потерь
+     */
+    static const uint32_t PathLossWindow = 32;
+    
     NS_OBJECT_ENSURE_REGISTERED (TricklesSocketBase);
     
     // Add attributes generic to all TricklesSockets to base class TricklesSocket
@@ -66,6 +75,53 @@ namespace ns3 {
                        CallbackValue (),
                        MakeCallbackAccessor (&TricklesSocketBase::m_icmpCallback6),
                        MakeCallbackChecker ())
+        .AddAttribute ("Ecn", "Mark continuations ECN-capable and reduce the window on ECN-Echo.",
+                       BooleanValue (false),
+                       MakeBooleanAccessor (&TricklesSocketBase::m_ecn),
+                       MakeBooleanChecker ())
+        .AddTraceSource ("RxData", "Data received by the client.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_rxDataTrace),
+                         "ns3::TricklesSocketBase::BytesCallback")
+        .AddTraceSource ("RttSample", "RTT sample carried by a continuation.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_rttSampleTrace),
+                         "ns3::TricklesSocketBase::TimeCallback")
+        .AddTraceSource ("SackHoles", "Number of holes in the received trickles after a continuation.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_sackHolesTrace),
+                         "ns3::TricklesSocketBase::BytesCallback")
+        .AddTraceSource ("Retransmission", "Trickles requested again by the client (Recovery_t reason).",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_retransmissionTrace),
+                         "ns3::TricklesSocketBase::RecoveryCallback")
+        .AddTraceSource ("RetransmittedTrickles", "Range [from, to) of missing trickles a retransmission requests again.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_retxTricklesTrace),
+                         "ns3::TricklesSocketBase::TrickleRangeCallback")
+        .AddTraceSource ("Recovery", "The client entered an epoch the server started after losses (Recovery_t reason).",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_recoveryTrace),
+                         "ns3::TricklesSocketBase::RecoveryCallback")
+        .AddTraceSource ("Retries", "Number of consecutive retransmission timeouts.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_retries),
+                         "ns3::TracedValue::Uint16Callback")
+        .AddAttribute ("TimestampGranularity", "Tick of the timestamp clock, the resolution of RTT samples. Must be the same at both ends.",
+                       TimeValue (MilliSeconds (5)),
+                       MakeTimeAccessor (&TricklesSocketBase::m_tsgranularity),
+                       MakeTimeChecker ())
+        .AddAttribute ("MinRto", "Lower bound of the client retransmission timeout.",
+                       TimeValue (Seconds (1.0)),
+                       MakeTimeAccessor (&TricklesSocketBase::m_minRto),
+                       MakeTimeChecker ())
+        .AddAttribute ("FailoverRetries", "Consecutive retransmission timeouts before the client switches to the next replica (0 disables failover).",
+                       UintegerValue (3),
+                       MakeUintegerAccessor (&TricklesSocketBase::m_failoverRetries),
+                       MakeUintegerChecker<uint16_t> ())
+        .AddAttribute ("GroupWindow", "Number of recently multicast trickles a group server remembers to drop repeated requests.",
+                       UintegerValue (4096),
+                       MakeUintegerAccessor (&TricklesSocketBase::m_groupWindow),
+                       MakeUintegerChecker<uint32_t> (1))
+        .AddTraceSource ("Failover", "The client switched to another replica.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_failoverTrace),
+                         "ns3::TricklesSocketBase::FailoverCallback")
+        .AddTraceSource ("RecoveryGap", "Time without continuations until the replica switched to answered.",
+                         MakeTraceSourceAccessor (&TricklesSocketBase::m_recoveryGapTrace),
+                         "ns3::TricklesSocketBase::TimeCallback")
         ;
         return tid;
     }
@@ -82,8 +138,23 @@ namespace ns3 {
     m_segSize(0),
     m_tsecr (SequenceNumber32(0)),
     m_retries(0),
+    m_ecn(false),
+    m_minRto(Seconds(1.0)),
+    m_nextReplica(0),
+    m_failoverRetries(3),
+    m_rtoStreak(0),
+    m_rxPendingRequests(0),
+    m_failedOver(false),
+    m_failovers(0),
+    m_gaps(0),
+    m_groupWindow(4096),
+    m_groupRequests(0),
+    m_aggregatedRequests(0),
+    m_repairRequests(0),
     m_shutdownSend(false),
-    m_shutdownRecv(false)
+    m_shutdownRecv(false),
+    m_fetchId(0),
+    m_nextFetch(0)
     {
         NS_LOG_FUNCTION_NOARGS ();
         m_tsstart = Simulator::Now();
@@ -104,10 +175,27 @@ namespace ns3 {
     m_tsstart(sock.m_tsstart),
     m_tsgranularity(sock.m_tsgranularity),
     m_tsecr(sock.m_tsecr),
-    m_retries(sock.m_retries),
+    m_retries(sock.m_retries.Get()),
+    m_ecn(sock.m_ecn),
+    m_minRto(sock.m_minRto),
+    m_replicas(sock.m_replicas),
+    m_nextReplica(0),
+    m_failoverRetries(sock.m_failoverRetries),
+    m_rtoStreak(0),
+    m_rxPendingRequests(0),
+    m_failedOver(false),
+    m_failovers(0),
+    m_gaps(0),
+    m_group(sock.m_group),
+    m_groupWindow(sock.m_groupWindow),
+    m_groupRequests(0),
+    m_aggregatedRequests(0),
+    m_repairRequests(0),
     m_errno(sock.m_errno),
     m_shutdownSend(sock.m_shutdownSend),
-    m_shutdownRecv(sock.m_shutdownRecv) {
+    m_shutdownRecv(sock.m_shutdownRecv),
+    m_fetchId(0),
+    m_nextFetch(0) {
         NS_LOG_FUNCTION (this);
         NS_LOG_LOGIC ("Invoked the copy constructor");
         // Copy the rtt estimator if it is set
@@ -426,6 +514,7 @@ namespace ns3 {
         
         // Re-initialize parameters in case this socket is being reused after CLOSE
         m_rtt->Reset ();
+        m_lastRxAt = Simulator::Now ();
         
         return 0;
     }
@@ -445,27 +534,47 @@ namespace ns3 {
         NS_LOG_FUNCTION (this << p << flags);
         TricklesHeader th;
         if (!p->RemoveHeader(th)) return 0;
-        if (m_reqDataSize) {
-            m_reqDataSize -= (th.IsRecovery()==NO_RECOVERY)?th.GetRequestSize():0;
-        }
         if (th.GetPacketType()==REQUEST) {
+            // Запрос строится из полученного продолжения, метка которого - адрес его отправителя. Запрос же уходит текущему серверу (после ::Failover - реплике) или пути, выбранному ::SelectPath
+            SocketAddressTag from;
+            p->RemovePacketTag(from);
             th.SetSacks(m_RcvdRequests);
+            // Данные загрузок RequestRange не учитываются в m_reqDataSize
+            bool fetch = th.GetRequestSize() && StampRequest(th);
+            if (!fetch && (th.IsRecovery()==NO_RECOVERY)) {
+                m_reqDataSize -= std::min<uint32_t>(m_reqDataSize, th.GetRequestSize());
+            }
+            if (th.GetRequestSize()) m_rxPendingRequests++;
         }
         th.SetTSEcr(m_tsecr);
+        if ((th.GetPacketType()==REQUEST) && !m_paths.empty()) {
+            uint32_t i = SelectPath();
+            Path &path = m_paths[i];
+            path.sent++;
+            PathRequest &r = m_pathRequests[th.GetTrickleNumber()];
+            r.path = i;
+            r.sentAt = Simulator::Now();
+            th.SetTSEcr(path.tsecr);
+            SocketAddressTag tag;
+            tag.SetAddress(path.address);
+            p->AddPacketTag(tag);
+        }
         th.SetTSVal(GetCurTSVal());
         p->AddHeader(th);
+        // Продолжения сервера помечаются как ECT(0)
+        bool ect = m_ecn && (th.GetPacketType()==CONTINUATION);
         // Update transport continuation if data is sent
-        if (IsManualIpTos ())
+        if (IsManualIpTos () || (ect && m_endPoint))
         {
             SocketIpTosTag ipTosTag;
-            ipTosTag.SetTos (GetIpTos ());
+            ipTosTag.SetTos ((IsManualIpTos ()?GetIpTos ():0) | (ect?0x02:0));
             p->AddPacketTag (ipTosTag);
         }
         
-        if (IsManualIpv6Tclass ())
+        if (IsManualIpv6Tclass () || (ect && m_endPoint6))
         {
             SocketIpv6TclassTag ipTclassTag;
-            ipTclassTag.SetTclass (GetIpv6Tclass ());
+            ipTclassTag.SetTclass ((IsManualIpv6Tclass ()?GetIpv6Tclass ():0) | (ect?0x02:0));
             p->AddPacketTag (ipTclassTag);
         }
         
@@ -611,7 +720,11 @@ namespace ns3 {
         SocketAddressTag tag;
         if ((outPacket != 0) && (outPacket->GetSize () != 0) && (!outPacket->PeekPacketTag(tag)))
         {
-            if (m_endPoint != 0)
+            if (!m_paths.empty())
+            {
+                tag.SetAddress (m_paths[0].address);
+            }
+            else if (m_endPoint != 0)
             {
                 tag.SetAddress (InetSocketAddress (m_endPoint->GetPeerAddress (), m_endPoint->GetPeerPort ()));
             }
@@ -739,7 +852,7 @@ namespace ns3 {
         SocketAddressTag tag;
         tag.SetAddress(fromAddress);
         packet->AddPacketTag(tag);
-        DoForwardUp(packet, fromAddress, toAddress, port);
+        DoForwardUp(packet, fromAddress, toAddress, port, header.GetEcn() == Ipv4Header::ECN_CE);
     }
     
     void
@@ -751,7 +864,7 @@ namespace ns3 {
         SocketAddressTag tag;
         tag.SetAddress(fromAddress);
         packet->AddPacketTag(tag);
-        DoForwardUp(packet, fromAddress, toAddress, port);
+        DoForwardUp(packet, fromAddress, toAddress, port, (header.GetTrafficClass() & 0x3) == 0x3);
     }
     
     /* void
@@ -782,10 +895,12 @@ namespace ns3 {
      }
      */
     
-    void TricklesSocketBase::DoForwardUp(Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port) {
+    void TricklesSocketBase::DoForwardUp(Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port, bool ce) {
         TricklesHeader tricklesHeader;
         TcpHeader tcpHeader;
         if ((!packet->RemoveHeader(tcpHeader)) || (!packet->RemoveHeader(tricklesHeader))) return;
+        // Отметка CE на продолжении превращается в ECN-Echo запроса, который из него получится
+        if (tricklesHeader.GetPacketType()==CONTINUATION) tricklesHeader.SetEce(ce);
         // if new packet incoming - fork socket
         //        if ((m_endPoint->GetPeerAddress() == Ipv4Address::GetAny()) || (m_endPoint->GetPeerPort() == 0)) {
         //            Ptr<TricklesSocketBase> newSock = Fork ();
@@ -892,7 +1007,36 @@ namespace ns3 {
             //SequenceNumber32 from = m_RcvdRequests.firstBlock()->first;
             SequenceNumber32 to = m_RcvdRequests.firstBlock()->second;
             m_RcvdRequests.AddBlock(th.GetTrickleNumber(), th.GetTrickleNumber()+1);
+            if (m_failedOver) {
+                // Первое продолжение после переключения на реплику
+                Time gap = Simulator::Now()-m_gapStart;
+                m_failedOver = false;
+                m_gaps++;
+                m_gapSum += gap;
+                m_gapMax = Max(m_gapMax, gap);
+                m_recoveryGapTrace(gap);
+            }
+            m_lastRxAt = Simulator::Now();
+            m_rtoStreak = 0;
+            m_rxPendingRequests = 0;
+            SocketAddressTag from;
+            if (!m_paths.empty() && packet->PeekPacketTag(from)) {
+                uint32_t i = FindPath(from.GetAddress());
+                if (i<m_paths.size()) {
+                    Path &path = m_paths[i];
+                    path.received++;
+                    path.tsecr = th.GetTSVal();
+                    if (!th.GetRTT().IsZero()) path.srtt = path.srtt.IsZero()?th.GetRTT():(path.srtt*7+th.GetRTT())/8;
+                    UpdatePathLoss(i, th.GetParentNumber());
+                }
+            }
 
+            if (packet->GetSize()) m_rxDataTrace(packet->GetSize());
+            // Продолжение загрузки без данных означает, что объект кончился раньше
+            if (th.HasObject()) {
+                DeliverObjectData(th, packet);
+                packet->RemoveAtEnd(packet->GetSize());
+            } else
             if (packet->GetSize()) {
                 // Очередную порцию данных мы добавляем вперед в буфер, несмотря на возможные потери - это очень оптимистично, но сейчас это сделано чтобы не усложнять и так непростой код
                 Ptr<Packet> datapacket = Create<Packet>(packet->GetSize());
@@ -907,14 +1051,20 @@ namespace ns3 {
             th.SetTSEcr(m_tsecr);
             th.SetTSVal(GetCurTSVal());
             th.SetPacketType(REQUEST);
-            m_rtt->Measurement(th.GetRTT());
+            if (!th.GetRTT().IsZero()) {
+                m_rtt->Measurement(th.GetRTT());
+                m_rttSampleTrace(th.GetRTT());
+            }
+            m_sackHolesTrace(m_RcvdRequests.numBlocks()-1);
             if (m_rxBuffer.Available()) NotifyDataRecv();
         } else
             // Server processing
             if (th.GetPacketType()==REQUEST) {
                 SequenceNumber32 tsval = GetCurTSVal();
                 //std::clog << "TSVal = " << tsval << " TSEcr = " << th.GetTSEcr() << " in ms=" << (tsval-th.GetTSEcr())*m_tsgranularity.GetMilliSeconds() << "\n";
-                th.SetRTT(MilliSeconds((tsval-th.GetTSEcr())*m_tsgranularity.GetMilliSeconds()));
+                // Нулевое TSEcr означает, что клиент еще не получал от нас отметок времени: замера RTT нет
+                if (th.GetTSEcr() == SequenceNumber32(0)) th.SetRTT(Time(0));
+                else th.SetRTT(NanoSeconds((tsval-th.GetTSEcr())*m_tsgranularity.GetNanoSeconds()));
                 th.SetTSVal(tsval);
                 m_tsecr = th.GetTSVal();
                 th.SetTSEcr(m_tsecr);
@@ -925,7 +1075,7 @@ namespace ns3 {
     }
     
     SequenceNumber32 TricklesSocketBase::GetCurTSVal() const {
-        return(SequenceNumber32(((Simulator::Now()-m_tsstart).GetMilliSeconds()/(m_tsgranularity.GetMilliSeconds()))));
+        return(SequenceNumber32(((Simulator::Now()-m_tsstart).GetNanoSeconds()/(m_tsgranularity.GetNanoSeconds()))));
     }
     
     void TricklesSocketBase::QueueToServerApp(Ptr<Packet> packet) {
@@ -934,11 +1084,412 @@ namespace ns3 {
     }
     
     void TricklesSocketBase::CancelAllTimers() {
-        
+        m_fetchEvent.Cancel();
+    }
+    
+    int TricklesSocketBase::RequestRange (uint32_t objectId, uint64_t offset, uint64_t length, FetchCallback callback) {
+        NS_LOG_FUNCTION (this << objectId << offset << length);
+        if (!length) {
+            m_errno = ERROR_INVAL;
+            return -1;
+        }
+        Fetch f;
+        f.objectId = objectId;
+        f.offset = offset;
+        f.length = length;
+        f.next = 0;
+        f.received = 0;
+        f.callback = callback;
+        m_fetches[m_fetchId++] = f;
+        NewRequest();
+        return 0;
+    }
+    
+    uint32_t TricklesSocketBase::GetPendingFetches (void) const {
+        return(m_fetches.size());
+    }
+    
+    uint32_t TricklesSocketBase::GetStateSize (void) const {
+        // Узел std::map/std::list оценивается в 32 байта служебных данных
+        uint32_t size = sizeof(*this)+m_rxBuffer.Size();
+        size += m_RcvdRequests.numBlocks()*(2*sizeof(SequenceNumber32)+32);
+        size += m_replicas.size()*sizeof(Address)+m_paths.size()*sizeof(Path);
+        size += m_pathRequests.size()*(sizeof(SequenceNumber32)+sizeof(PathRequest)+32);
+        size += m_groupServed.size()*(2*sizeof(SequenceNumber32)+32);
+        for (std::list<Ptr<Packet> >::const_iterator i = m_rqQueue.begin(); i != m_rqQueue.end(); i++) {
+            size += (*i)->GetSize()+32;
+        }
+        for (std::map<uint32_t, Fetch>::const_iterator f = m_fetches.begin(); f != m_fetches.end(); f++) {
+            size += sizeof(Fetch)+32+f->second.inflight.size()*(sizeof(uint64_t)+sizeof(FetchChunk)+32);
+        }
+        size += m_sentChunks.size()*sizeof(SentChunk);
+        return(size);
+    }
+    
+    bool TricklesSocketBase::NextFetchChunk (std::map<uint32_t, Fetch>::iterator &f, uint64_t &rel, uint32_t &size, bool &retry) {
+        Time expired = Simulator::Now()-GetRto()*2;
+        // Данные, ответ на которые потерялся, не восстанавливаются протоколом - запрашиваем их заново
+        while (!m_sentChunks.empty() && (m_sentChunks.front().sentAt<expired)) {
+            const SentChunk &s = m_sentChunks.front();
+            f = m_fetches.find(s.fetch);
+            if (f != m_fetches.end()) {
+                std::map<uint64_t, FetchChunk>::iterator c = f->second.inflight.find(s.rel);
+                if ((c != f->second.inflight.end()) && (c->second.sentAt == s.sentAt)) {
+                    rel = s.rel;
+                    size = std::min(size, c->second.size);
+                    retry = true;
+                    return(true);
+                }
+            }
+            // Часть уже получена или запрошена повторно
+            m_sentChunks.pop_front();
+        }
+        for (f = m_fetches.lower_bound(m_nextFetch); f != m_fetches.end(); f++) {
+            if (f->second.next<f->second.length) {
+                m_nextFetch = f->first;
+                rel = f->second.next;
+                size = std::min<uint64_t>(size, f->second.length-f->second.next);
+                retry = false;
+                return(true);
+            }
+        }
+        m_nextFetch = m_fetchId;
+        return(false);
+    }
+    
+    uint32_t TricklesSocketBase::NextRequestSize (uint32_t size) {
+        std::map<uint32_t, Fetch>::iterator f;
+        uint64_t rel;
+        uint32_t chunk = size;
+        bool retry;
+        if (NextFetchChunk(f, rel, chunk, retry)) return(chunk);
+        return((m_reqDataSize>=size)?size:0);
+    }
+    
+    bool TricklesSocketBase::StampRequest (TricklesHeader &th) {
+        std::map<uint32_t, Fetch>::iterator f;
+        uint64_t rel;
+        uint32_t size = th.GetRequestSize();
+        bool retry;
+        if (!NextFetchChunk(f, rel, size, retry)) {
+            th.ClearObject();
+            return(false);
+        }
+        Fetch &fetch = f->second;
+        if (retry) {
+            // Повторно запрашиваемая часть - первая в очереди
+            m_sentChunks.pop_front();
+            FetchChunk c = fetch.inflight[rel];
+            fetch.inflight.erase(rel);
+            if (c.size>size) {
+                // Остаток сохраняет время отправки и остается просроченным
+                c.size -= size;
+                fetch.inflight[rel+size] = c;
+                SentChunk rest;
+                rest.fetch = f->first;
+                rest.rel = rel+size;
+                rest.sentAt = c.sentAt;
+                m_sentChunks.push_front(rest);
+            }
+        } else {
+            fetch.next += size;
+        }
+        FetchChunk c;
+        c.size = size;
+        c.sentAt = Simulator::Now();
+        fetch.inflight[rel] = c;
+        SentChunk s;
+        s.fetch = f->first;
+        s.rel = rel;
+        s.sentAt = c.sentAt;
+        m_sentChunks.push_back(s);
+        if (!m_fetchEvent.IsRunning()) {
+            m_fetchEvent = Simulator::Schedule(GetRto()*2, &TricklesSocketBase::FetchTimeout, this);
+        }
+        th.SetRequestSize(size);
+        th.SetObject(fetch.objectId, fetch.offset+rel);
+        return(true);
+    }
+    
+    void TricklesSocketBase::FetchTimeout (void) {
+        NS_LOG_FUNCTION (this);
+        // Без новых данных запросы не отправляются - даем клиенту отправить отложенный запрос за просроченной частью
+        NewRequest();
+        // Удаляем из начала очереди полученные части
+        std::map<uint32_t, Fetch>::iterator f;
+        uint64_t rel;
+        uint32_t size = 0;
+        bool retry;
+        NextFetchChunk(f, rel, size, retry);
+        if (!m_sentChunks.empty() && !m_fetchEvent.IsRunning()) {
+            Time at = std::max(m_sentChunks.front().sentAt+GetRto()*2, Simulator::Now()+GetRto());
+            m_fetchEvent = Simulator::Schedule(at-Simulator::Now(), &TricklesSocketBase::FetchTimeout, this);
+        }
+    }
+    
+    void TricklesSocketBase::SetObjectDataCallback (ObjectDataCallback callback) {
+        m_objectDataCallback = callback;
+    }
+    
+    void TricklesSocketBase::DeliverObjectData (const TricklesHeader &th, Ptr<const Packet> data) {
+        uint32_t size = data->GetSize();
+        for (std::map<uint32_t, Fetch>::iterator i = m_fetches.begin(); i != m_fetches.end(); i++) {
+            Fetch *f = &i->second;
+            if ((f->objectId != th.GetObjectId()) || (th.GetObjectOffset()<f->offset) || (th.GetObjectOffset()-f->offset>=f->length)) continue;
+            std::map<uint64_t, FetchChunk>::iterator c = f->inflight.find(th.GetObjectOffset()-f->offset);
+            // Повторно запрошенная часть пришла дважды
+            if (c == f->inflight.end()) return;
+            if (size && !m_objectDataCallback.IsNull()) m_objectDataCallback(this, th.GetObjectId(), th.GetObjectOffset(), data);
+            f->received += std::min(size, c->second.size);
+            f->inflight.erase(c);
+            if ((f->next==f->length) && f->inflight.empty()) {
+                Fetch done = *f;
+                m_fetches.erase(i);
+                if (m_fetches.empty()) {
+                    m_sentChunks.clear();
+                    m_fetchEvent.Cancel();
+                }
+                NS_LOG_LOGIC("Object " << done.objectId << " range " << done.offset << "+" << done.length << " fetched, " << done.received << " bytes");
+                if (!done.callback.IsNull()) done.callback(this, done.objectId, done.offset, done.received);
+            }
+            return;
+        }
+    }
+    
+    void TricklesSocketBase::AddReplica (const Address &address) {
+        NS_LOG_FUNCTION (this << address);
+        m_replicas.push_back(address);
+    }
+    
+    uint32_t TricklesSocketBase::GetFailovers (void) const {
+        return(m_failovers);
+    }
+    
+    Time TricklesSocketBase::GetMeanRecoveryGap (void) const {
+        return(m_gaps?m_gapSum/m_gaps:Time(0));
+    }
+    
+    Time TricklesSocketBase::GetMaxRecoveryGap (void) const {
+        return(m_gapMax);
+    }
+    
+    bool TricklesSocketBase::IsPeerSilent (void) const {
+        return(Simulator::Now()-m_lastRxAt>=GetRto());
+    }
+    
+    bool TricklesSocketBase::HasOutstandingRequests (void) const {
+        return((m_reqDataSize>0) || !m_fetches.empty() || (m_rxPendingRequests>0));
+    }
+    
+    bool TricklesSocketBase::Failover (void) {
+        if (m_replicas.empty() || !m_paths.empty()) return(false);
+        Address current;
+        if (m_endPoint != 0) current = InetSocketAddress (m_endPoint->GetPeerAddress (), m_endPoint->GetPeerPort ());
+        else if (m_endPoint6 != 0) current = Inet6SocketAddress (m_endPoint6->GetPeerAddress (), m_endPoint6->GetPeerPort ());
+        else return(false);
+        // При первом переключении исходный сервер замыкает список
+        if (std::find(m_replicas.begin(), m_replicas.end(), current) == m_replicas.end()) m_replicas.push_back(current);
+        Address next = m_replicas[m_nextReplica++ % m_replicas.size()];
+        if (next == current) next = m_replicas[m_nextReplica++ % m_replicas.size()];
+        if ((m_endPoint != 0) && InetSocketAddress::IsMatchingType (next)) {
+            InetSocketAddress transport = InetSocketAddress::ConvertFrom (next);
+            m_endPoint->SetPeer (transport.GetIpv4 (), transport.GetPort ());
+            if (SetupEndpoint () != 0) NS_LOG_LOGIC ("No route to replica " << transport.GetIpv4 ());
+        } else
+        if ((m_endPoint6 != 0) && Inet6SocketAddress::IsMatchingType (next)) {
+            Inet6SocketAddress transport = Inet6SocketAddress::ConvertFrom (next);
+            m_endPoint6->SetPeer (transport.GetIpv6 (), transport.GetPort ());
+            if (SetupEndpoint6 () != 0) NS_LOG_LOGIC ("No route to replica " << transport.GetIpv6 ());
+        } else return(false);
+        // Перерыв отсчитывается от последнего продолжения, даже если реплики сменились несколько раз
+        if (!m_failedOver) {
+            m_failedOver = true;
+            m_gapStart = m_lastRxAt;
+        }
+        // Метка времени прежнего сервера не имеет смысла для часов реплики
+        m_tsecr = SequenceNumber32(0);
+        m_failovers++;
+        NS_LOG_LOGIC ("Failover to replica " << next);
+        m_failoverTrace(next);
+        return(true);
+    }
+    
+    int TricklesSocketBase::AddPath (const Address &address) {
+        NS_LOG_FUNCTION (this << address);
+        if ((m_endPoint6 != 0) || !InetSocketAddress::IsMatchingType (address)) {
+            m_errno = ERROR_OPNOTSUPP;
+            return -1;
+        }
+        if (m_paths.empty()) {
+            if ((m_endPoint == 0) || (m_endPoint->GetPeerPort () == 0)) {
+                m_errno = ERROR_NOTCONN;
+                return -1;
+            }
+            // Путь 0 - адрес соединения. Конечная точка принимает продолжения с любого адреса, а адрес клиента выбирается маршрутом каждого пути
+            Path path;
+            path.address = InetSocketAddress (m_endPoint->GetPeerAddress (), m_endPoint->GetPeerPort ());
+            m_paths.push_back(path);
+            m_endPoint->SetPeer (Ipv4Address::GetAny (), 0);
+            m_endPoint->SetLocalAddress (Ipv4Address::GetAny ());
+        }
+        Path path;
+        path.address = address;
+        m_paths.push_back(path);
+        for (std::vector<Path>::iterator i = m_paths.begin(); i != m_paths.end(); i++) {
+            i->tsecr = SequenceNumber32(0);
+            i->srtt = Time(0);
+            i->loss = 0;
+            i->credit = 0;
+            i->sent = i->received = 0;
+            i->winAnswered = i->winLost = 0;
+        }
+        m_pathRequests.clear();
+        UpdatePathWeights();
+        return 0;
+    }
+    
+    uint32_t TricklesSocketBase::GetNPaths (void) const {
+        return(m_paths.size());
+    }
+    
+    double TricklesSocketBase::GetPathWeight (uint32_t path) const {
+        NS_ASSERT(path<m_paths.size());
+        return(m_paths[path].weight);
+    }
+    
+    Time TricklesSocketBase::GetPathRtt (uint32_t path) const {
+        NS_ASSERT(path<m_paths.size());
+        return(m_paths[path].srtt);
+    }
+    
+    double TricklesSocketBase::GetPathLoss (uint32_t path) const {
+        NS_ASSERT(path<m_paths.size());
+        return(m_paths[path].loss);
+    }
+    
+    uint32_t TricklesSocketBase::GetPathSent (uint32_t path) const {
+        NS_ASSERT(path<m_paths.size());
+        return(m_paths[path].sent);
+    }
+    
+    uint32_t TricklesSocketBase::GetPathReceived (uint32_t path) const {
+        NS_ASSERT(path<m_paths.size());
+        return(m_paths[path].received);
+    }
+    
+    uint32_t TricklesSocketBase::SelectPath (void) {
+        // Плавное взвешенное чередование: путь с наибольшей накопленной долей, доли в сумме дают 1
+        uint32_t best = 0;
+        for (uint32_t i = 0; i<m_paths.size(); i++) {
+            m_paths[i].credit += m_paths[i].weight;
+            if (m_paths[i].credit>m_paths[best].credit) best = i;
+        }
+        m_paths[best].credit -= 1.0;
+        return(best);
+    }
+    
+    void TricklesSocketBase::UpdatePathWeights (void) {
+        // Пропускная способность TCP ~ 1/(RTT*sqrt(p)); у путей без замеров RTT - оценка соединения
+        double sum = 0;
+        for (std::vector<Path>::iterator i = m_paths.begin(); i != m_paths.end(); i++) {
+            double rtt = (i->srtt.IsZero()?m_rtt->GetEstimate():i->srtt).GetSeconds();
+            i->weight = 1.0/(std::max(rtt, 0.001)*sqrt(std::max(i->loss, 0.001)));
+            sum += i->weight;
+        }
+        for (std::vector<Path>::iterator i = m_paths.begin(); i != m_paths.end(); i++) i->weight /= sum;
+    }
+    
+    void TricklesSocketBase::UpdatePathLoss (uint32_t path, SequenceNumber32 parent) {
+        std::map<SequenceNumber32, PathRequest>::iterator answered = m_pathRequests.find(parent);
+        // Продолжения, добавленные ростом окна, отвечают на уже учтенный запрос
+        if ((answered == m_pathRequests.end()) || (answered->second.path != path)) return;
+        m_paths[path].winAnswered++;
+        Time timeout = Simulator::Now()-GetRto();
+        bool update = false;
+        for (std::map<SequenceNumber32, PathRequest>::iterator i = m_pathRequests.begin(); i != answered; ) {
+            if ((i->second.path == path) || (i->second.sentAt<=timeout)) {
+                m_paths[i->second.path].winLost++;
+                m_pathRequests.erase(i++);
+            } else i++;
+        }
+        m_pathRequests.erase(answered);
+        for (std::vector<Path>::iterator i = m_paths.begin(); i != m_paths.end(); i++) {
+            if (i->winAnswered+i->winLost<PathLossWindow) continue;
+            double lost = double(i->winLost)/(i->winAnswered+i->winLost);
+            i->loss = (i->loss*3+lost)/4;
+            i->winAnswered = 0;
+            i->winLost = 0;
+            update = true;
+        }
+        if (update) UpdatePathWeights();
+    }
+    
+    uint32_t TricklesSocketBase::FindPath (const Address &from) const {
+        uint32_t i;
+        for (i = 0; i<m_paths.size(); i++) {
+            if (m_paths[i].address == from) break;
+        }
+        return(i);
+    }
+    
+    int TricklesSocketBase::SetGroup (const Address &group) {
+        NS_LOG_FUNCTION (this << group);
+        if ((m_endPoint6 != 0) || Inet6SocketAddress::IsMatchingType (group)) {
+            m_errno = ERROR_OPNOTSUPP;
+            return -1;
+        }
+        if (!InetSocketAddress::IsMatchingType (group) || !InetSocketAddress::ConvertFrom (group).GetIpv4 ().IsMulticast ()) {
+            m_errno = ERROR_INVAL;
+            return -1;
+        }
+        m_group = group;
+        // Клиент принимает продолжения, адресованные и ему, и группе
+        if ((m_endPoint != 0) && (m_endPoint->GetPeerPort () != 0)) m_endPoint->SetLocalAddress (Ipv4Address::GetAny ());
+        return 0;
+    }
+    
+    Address TricklesSocketBase::GetGroup (void) const {
+        return(m_group);
+    }
+    
+    uint32_t TricklesSocketBase::GetGroupRequests (void) const {
+        return(m_groupRequests);
+    }
+    
+    uint32_t TricklesSocketBase::GetAggregatedRequests (void) const {
+        return(m_aggregatedRequests);
+    }
+    
+    uint32_t TricklesSocketBase::GetRepairRequests (void) const {
+        return(m_repairRequests);
+    }
+    
+    bool TricklesSocketBase::FilterGroupRequest (Ptr<Packet> packet, TricklesHeader &th, SequenceNumber32 epoch) {
+        if (m_group.IsInvalid() || (th.GetPacketType() != REQUEST)) return(true);
+        if ((th.IsRecovery() != NO_RECOVERY) || (th.GetSacks().numBlocks()>1)) {
+            // Потери отдельного клиента восстанавливаются только для него
+            m_repairRequests++;
+            return(true);
+        }
+        if (!m_groupServed.insert(std::make_pair(epoch, th.GetTrickleNumber())).second) {
+            NS_LOG_LOGIC ("Trickle " << th.GetTrickleNumber() << " of epoch " << epoch << " already sent to the group");
+            m_aggregatedRequests++;
+            return(false);
+        }
+        while (m_groupServed.size()>m_groupWindow) m_groupServed.erase(m_groupServed.begin());
+        m_groupRequests++;
+        // Нулевое TSEcr - без замера RTT; SACK без пропусков у всех участников одинаков
+        th.SetTSEcr(SequenceNumber32(0));
+        th.SetSacks(TricklesSack());
+        SocketAddressTag tag;
+        packet->RemovePacketTag(tag);
+        tag.SetAddress(m_group);
+        packet->AddPacketTag(tag);
+        return(true);
     }
     
     Time TricklesSocketBase::GetRto() const {
-        return(Max (m_rtt->GetEstimate () + m_rtt->GetVariation ()*4, Time::FromDouble (1,  Time::S)));
+        return(Max (m_rtt->GetEstimate () + m_rtt->GetVariation ()*4, m_minRto));
     }
     
     void TricklesSocketBase::PrintState() {
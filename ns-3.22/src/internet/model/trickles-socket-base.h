@@ -23,10 +23,17 @@
 
 #include <stdint.h>
 #include <queue>
+#include <deque>
+#include <map>
+#include <set>
+#include <list>
+#include <vector>
 #include "ns3/callback.h"
 #include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
 #include "ns3/socket.h"
 #include "ns3/ptr.h"
+#include "ns3/event-id.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-interface.h"
 #include "ns3/ipv6-address.h"
@@ -197,12 +204,132 @@ namespace ns3 {
         virtual Ptr<Packet> RecvFrom (uint32_t maxSize, uint32_t flags,
                                       Address &fromAddress);
         /**@}*/
+        /**
+         * \brief Обработчик завершения загрузки диапазона объекта: сокет, идентификатор объекта, смещение, число полученных байтов
+         *
+         * Полученных байтов меньше длины диапазона, если объект кончился раньше.
+         */
+        typedef Callback<void, Ptr<Socket>, uint32_t, uint64_t, uint64_t> FetchCallback;
+        /**
+         * \brief Запросить у сервера диапазон объекта
+         * \param objectId идентификатор объекта
+         * \param offset смещение первого байта диапазона в объекте
+         * \param length длина диапазона
+         * \param callback вызывается, когда получены все данные диапазона
+         * \returns 0 в случае успеха, -1 при нулевой длине
+         *
+         * В отличие от ::Recv с флагом QUEUE_RECV каждый запрос струйки содержит идентификатор объекта и смещение (см. ns3::TricklesHeader::SetObject), которые сервер возвращает в продолжении.
+         * Данные объекта не попадают в буфер m_rxBuffer, а учитываются в загрузке, к которой относятся.
+         *
+         * Одновременно может выполняться любое число загрузок; они обслуживаются в порядке вызова. Если данные части диапазона не пришли за 2 RTO, эта часть запрашивается повторно.
+         */
+        int RequestRange (uint32_t objectId, uint64_t offset, uint64_t length, FetchCallback callback);
+        /**
+         * \brief Число незавершенных загрузок, начатых ::RequestRange
+         */
+        uint32_t GetPendingFetches (void) const;
+        /**
+         * \brief Обработчик данных объекта: сокет, идентификатор объекта, смещение, данные
+         */
+        typedef Callback<void, Ptr<Socket>, uint32_t, uint64_t, Ptr<const Packet> > ObjectDataCallback;
+        /**
+         * \brief Установить обработчик, получающий данные каждой порции загрузки ::RequestRange
+         *
+         * Вызывается один раз для каждой запрошенной порции; дубликаты повторно запрошенных порций отбрасываются. Позволяет проверять содержимое (см. TricklesObjectStore::Verify).
+         */
+        void SetObjectDataCallback (ObjectDataCallback callback);
+        /**
+         * \brief Приблизительный объем памяти, занятой состоянием сокета (байты)
+         *
+         * Учитываются сам объект, данные в приемном буфере, блоки SACK, очередь запросов к серверному приложению и загрузки ::RequestRange. Используется для контроля роста состояния в тестах производительности.
+         */
+        virtual uint32_t GetStateSize (void) const;
+        /**
+         * \brief Добавить резервный сервер (реплику) клиента
+         * \param address адрес сервера, равноценного тому, с которым установлено соединение
+         *
+         * Если сервер не отвечает FailoverRetries тайм-аутов подряд, клиент переключается на следующую реплику списка (::Failover): неподтвержденные и все последующие запросы уходят ей с прежним продолжением. Реплики перебираются по кругу, исходный сервер становится последним в списке.
+         *
+         * Пока список пуст, поведение клиента не меняется.
+         */
+        void AddReplica (const Address &address);
+        /**
+         * \brief Число переключений на другую реплику
+         */
+        uint32_t GetFailovers (void) const;
+        /**@{*/
+        /**
+         * \brief Длительность перерыва при переключении: от последнего продолжения старого сервера до первого продолжения новой реплики
+         */
+        Time GetMeanRecoveryGap (void) const;
+        Time GetMaxRecoveryGap (void) const;
+        /**@}*/
+        /**
+         * \brief Добавить путь многопутевого режима клиента
+         * \param address адрес сервера (реплики или другого адреса того же сервера), через который идет путь
+         * \returns 0 в случае успеха, -1, если сокет не соединен (ERROR_NOTCONN) или соединен по IPv6 (ERROR_OPNOTSUPP)
+         *
+         * Запросы струек распределяются по путям: адресу, переданному в Connect (путь 0), и всем добавленным. Доля каждого пути пропорциональна 1/(RTT*sqrt(p)) (p - доля потерь, не меньше 0.001); RTT пути оценивается по продолжениям, пришедшим с его адреса, потери - по запросам пути, оставшимся без ответа. Сервер отвечает с того адреса, на который пришел запрос, и не хранит состояния, поэтому согласования между серверами не требуется. Окно перегрузки у всех путей общее.
+         *
+         * Данные продолжений собираются в общем приемном буфере (части загрузок ::RequestRange - по смещению в объекте).
+         *
+         * Клиентский адрес пути выбирается маршрутизацией узла, поэтому на узле с несколькими интерфейсами пути могут идти через разные интерфейсы. Поддерживается только IPv4. В многопутевом режиме ::Failover не используется: путь без ответов получает малую долю запросов.
+         */
+        int AddPath (const Address &address);
+        /**
+         * \brief Число путей (0 вне многопутевого режима)
+         */
+        uint32_t GetNPaths (void) const;
+        /**@{*/
+        /**
+         * \brief Состояние пути path: доля запросов, сглаженное RTT, оценка доли потерь, число отправленных запросов и полученных продолжений
+         */
+        double GetPathWeight (uint32_t path) const;
+        Time GetPathRtt (uint32_t path) const;
+        double GetPathLoss (uint32_t path) const;
+        uint32_t GetPathSent (uint32_t path) const;
+        uint32_t GetPathReceived (uint32_t path) const;
+        /**@}*/
+        /**
+         * \brief Групповой режим: один поток продолжений доставляется многим клиентам через групповую рассылку IP
+         * \param group групповой адрес IPv4 и порт, на который приходят продолжения группы
+         * \returns 0 в случае успеха, -1, если адрес не групповой (ERROR_INVAL) или сокет работает по IPv6 (ERROR_OPNOTSUPP)
+         *
+         * <b> Сервер </b> (вызывается для прослушивающего сокета). Запрос без потерь (NO_RECOVERY, без пропусков в SACK) считается запросом группы: на первый запрос струйки сервер отвечает продолжениями на адрес group, повторные запросы той же струйки от других клиентов отбрасываются. Так все получатели делят одно окно, а через канал сервера проходит одна копия данных. Запросы с потерями обслуживаются как обычно - продолжениями по одноадресной передаче тому клиенту, который их прислал.
+         *
+         * Для отбрасывания повторов сервер хранит эпохи и номера последних GroupWindow обслуженных струек - это единственное состояние группового режима. Продолжения группы не несут отметок времени и замеров RTT отдельного получателя, поэтому RTT получатели оценивают по продолжениям, полученным одноадресно.
+         *
+         * <b> Клиент </b> (вызывается после Connect; сокет должен быть привязан к порту group). Сокет принимает продолжения, адресованные группе. Клиент, присоединившийся к уже идущему потоку, переходит к струйкам первого полученного продолжения и его эпохе.
+         *
+         * Все клиенты сервера группового режима должны быть участниками группы: ответы на их запросы без потерь уходят на групповой адрес. Маршруты групповой рассылки задаются на узлах отдельно (Ipv4StaticRouting).
+         */
+        int SetGroup (const Address &group);
+        Address GetGroup (void) const;
+        /**@{*/
+        /**
+         * \brief Счетчики сервера группового режима: обслуженные запросы группы, отброшенные повторы, запросы с потерями, обслуженные одноадресно
+         */
+        uint32_t GetGroupRequests (void) const;
+        uint32_t GetAggregatedRequests (void) const;
+        uint32_t GetRepairRequests (void) const;
+        /**@}*/
+        /**
+         * \brief Сигнатуры источников трассировки клиента
+         */
+        typedef void (* BytesCallback)(uint32_t bytes);
+        typedef void (* TimeCallback)(Time rtt);
+        typedef void (* RecoveryCallback)(uint8_t reason);
+        typedef void (* TrickleRangeCallback)(SequenceNumber32 from, SequenceNumber32 to);
+        typedef void (* FailoverCallback)(const Address &replica);
         virtual int GetSockName (Address &address) const;
         virtual void BindToNetDevice (Ptr<NetDevice> netdevice);
 /*        virtual Ptr<TricklesSocketBase> Fork (void) = 0;
         void CompleteFork (Ptr<Packet> p, TricklesHeader th, const Address& fromAddress, const Address& toAddress); */
-        Time GetMinRto() const { return Seconds(0.2); }
     protected:
+        /**
+         * \brief RTT, которое несут первые запросы соединения, пока замеров нет (не связано с MinRto)
+         */
+        Time GetInitialRtt() const { return Seconds(0.2); }
         /**
          * \brief Задание размера буфера, в котором хранятся пришедшие от сервера данные
          *
@@ -233,7 +360,7 @@ namespace ns3 {
         /**
          * \brief Широковещательная передача запрещена
          *
-         * Пока в протоколе не разрешается широковещательная передача. Однако в перспективе возможна реализация чтобы серверная часть была распределенной.
+         * Широковещательная передача не поддерживается; доставку одного потока продолжений многим клиентам обеспечивает групповой режим (::SetGroup).
          */
         virtual bool     SetAllowBroadcast (bool allowBroadcast);
         virtual bool     GetAllowBroadcast (void) const;
@@ -248,9 +375,42 @@ namespace ns3 {
         void ForwardUp (Ptr<Packet> p, Ipv4Header header, uint16_t port,
                         Ptr<Ipv4Interface> incomingInterface);
         void ForwardUp6 (Ptr<Packet> p, Ipv6Header header, uint16_t port, Ptr<Ipv6Interface> incomingInterface);
-        virtual void DoForwardUp(Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port);
+        /**
+         * \param ce пакет пришел с отметкой ECN Congestion Experienced
+         */
+        virtual void DoForwardUp(Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port, bool ce = false);
     protected:
         virtual void PrintState();
+        /**
+         * \brief Размер следующего запроса струйки не больше size
+         * \returns 0, если запрашивать нечего
+         *
+         * Сначала дозапрашиваются части загрузок, ответ на которые не пришел, затем новые данные загрузок, затем данные, запрошенные через ::Recv.
+         */
+        uint32_t NextRequestSize (uint32_t size);
+        /**
+         * \brief Переключиться на следующую реплику из списка ::AddReplica
+         * \returns false, если список пуст или адрес реплики другого семейства
+         */
+        bool Failover (void);
+        /**
+         * \brief Сервер не присылал продолжений дольше RTO
+         */
+        bool IsPeerSilent (void) const;
+        /**
+         * \brief Клиент ждет ответа сервера
+         *
+         * Приложение запросило данные, которые еще не запрошены у сервера (::Recv или незавершенные загрузки), или запрос с данными отправлен после последнего продолжения. Молчание сервера у клиента без таких запросов не считается отказом.
+         */
+        bool HasOutstandingRequests (void) const;
+        /**
+         * \brief Обработка запроса сервером группового режима
+         * \param epoch первая струйка эпохи запроса: одинаковые номера струек разных эпох (например, у получателя после восстановления) - разные запросы
+         * \returns false, если запрос повторяет уже обслуженный запрос группы и должен быть отброшен
+         *
+         * У запроса группы адрес ответа (SocketAddressTag) заменяется групповым адресом, а отметка времени, SACK и замер RTT первого запросившего получателя убираются: продолжение получат все участники группы.
+         */
+        bool FilterGroupRequest (Ptr<Packet> packet, TricklesHeader &th, SequenceNumber32 epoch);
         void IncreaseMultiplier() { m_retries++; }
         void ResetMultiplier() { m_retries = 0; }
         Time GetRto() const;
@@ -327,7 +487,7 @@ namespace ns3 {
         Time m_tsstart;
         
         /**
-         * \brief Время (в миллисекундах), за которое часы m_tsclock делают один тик. Необходимо для реализации временных меток
+         * \brief Время, за которое часы m_tsclock делают один тик (атрибут TimestampGranularity). Необходимо для реализации временных меток
          */
         Time m_tsgranularity;
         
@@ -336,9 +496,62 @@ namespace ns3 {
          */
         SequenceNumber32 m_tsecr;
         /**
-         * \brief Количество повторных передач подряд
+         * \brief Количество повторных передач подряд (источник трассировки Retries)
+         */
+        TracedValue<uint16_t> m_retries;
+        /**
+         * \brief Использовать ECN: сервер помечает продолжения как ECT(0) и снижает окно по ECN-Echo
+         */
+        bool m_ecn;
+        /**
+         * \brief Нижняя граница тайм-аута повторной передачи
+         */
+        Time m_minRto;
+        /**@{*/
+        /**
+         * \brief Источники трассировки клиента для ns3::TricklesStatsCollector
+         *
+         * RxData - получены данные (байты), RttSample - замер RTT, SackHoles - число пропусков в m_RcvdRequests после очередного продолжения, Retransmission - повторный запрос струек (FAST_RETRANSMIT, RTO_TIMEOUT), RetransmittedTrickles - повторно запрашиваемые струйки [from, to) (по одному вызову на каждый пропуск; одна и та же струйка может сообщаться при каждом повторном запросе), Recovery - переход в эпоху, начатую сервером после потерь.
+         */
+        TracedCallback<uint32_t> m_rxDataTrace;
+        TracedCallback<Time> m_rttSampleTrace;
+        TracedCallback<uint32_t> m_sackHolesTrace;
+        TracedCallback<uint8_t> m_retransmissionTrace;
+        TracedCallback<SequenceNumber32, SequenceNumber32> m_retxTricklesTrace;
+        TracedCallback<uint8_t> m_recoveryTrace;
+        /**@}*/
+        /**@{*/
+        /**
+         * \brief Резервные серверы клиента и статистика переключений
+         *
+         * m_failoverRetries - число тайм-аутов подряд до переключения (0 - не переключаться), m_rtoStreak - тайм-ауты после последнего продолжения (в отличие от m_retries не сбрасывается новыми запросами приложения), m_lastRxAt - время последнего продолжения, m_rxPendingRequests - запросы с данными, отправленные после последнего продолжения, m_gapStart - начало перерыва, если переключение еще не завершилось приходом продолжения.
+         */
+        std::vector<Address> m_replicas;
+        uint32_t m_nextReplica;
+        uint16_t m_failoverRetries;
+        uint32_t m_rtoStreak;
+        Time m_lastRxAt;
+        uint32_t m_rxPendingRequests;
+        bool m_failedOver;
+        Time m_gapStart;
+        uint32_t m_failovers;
+        uint32_t m_gaps;
+        Time m_gapSum;
+        Time m_gapMax;
+        TracedCallback<const Address &> m_failoverTrace;
+        TracedCallback<Time> m_recoveryGapTrace;
+        /**@}*/
+        /**@{*/
+        /**
+         * \brief Групповой режим (::SetGroup): адрес группы (неопределенный вне режима), эпохи и номера струек, уже разосланных группе, и счетчики сервера
          */
-        uint16_t m_retries;
+        Address m_group;
+        uint32_t m_groupWindow;
+        std::set<std::pair<SequenceNumber32, SequenceNumber32> > m_groupServed;
+        uint32_t m_groupRequests;
+        uint32_t m_aggregatedRequests;
+        uint32_t m_repairRequests;
+        /**@}*/
         
         enum SocketErrno m_errno;
         bool m_shutdownSend;
@@ -348,6 +561,144 @@ namespace ns3 {
         Callback<void, Ipv4Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback;
         Callback<void, Ipv6Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback6;
         
+    private:
+        /**
+         * \brief Путь многопутевого режима
+         */
+        struct Path {
+            Address address;
+            /**
+             * Последняя метка времени сервера этого пути: у реплик разные часы
+             */
+            SequenceNumber32 tsecr;
+            Time srtt;
+            double loss;
+            double weight;
+            /**
+             * Накопленная доля для равномерного чередования путей
+             */
+            double credit;
+            uint32_t sent;
+            uint32_t received;
+            /**
+             * Отвеченные и пропущенные запросы текущего окна оценки потерь
+             */
+            uint32_t winAnswered;
+            uint32_t winLost;
+        };
+        /**
+         * \brief Запрос многопутевого режима, ответ на который еще не пришел
+         */
+        struct PathRequest {
+            uint32_t path;
+            Time sentAt;
+        };
+        /**
+         * \brief Выбрать путь для очередного запроса
+         */
+        uint32_t SelectPath (void);
+        void UpdatePathWeights (void);
+        /**
+         * \brief Учесть продолжение с родительской струйкой parent, пришедшее по пути path
+         *
+         * Сервер отвечает на запрос по тому же пути, поэтому ответы одного пути приходят в порядке запросов. Запрос пути, на который нет ответа, когда уже пришел ответ на более поздний запрос того же пути, - дыра в струйках пути. Запросы других путей без ответа дольше RTO тоже считаются потерянными. Доля потерь пути - доля дыр среди запросов окна из PathLossWindow запросов; продолжения, добавленные ростом окна, на нее не влияют.
+         */
+        void UpdatePathLoss (uint32_t path, SequenceNumber32 parent);
+        /**
+         * \brief Путь, которому принадлежит адрес from (m_paths.size(), если такого нет)
+         */
+        uint32_t FindPath (const Address &from) const;
+        /**
+         * \brief Пути многопутевого режима (пусто - обычный режим)
+         */
+        std::vector<Path> m_paths;
+        /**
+         * \brief Запросы без ответа по номеру струйки, на которую они отвечают
+         */
+        std::map<SequenceNumber32, PathRequest> m_pathRequests;
+        /**
+         * \brief Часть диапазона, запрошенная, но еще не полученная
+         */
+        struct FetchChunk {
+            uint32_t size;
+            Time sentAt;
+        };
+        /**
+         * \brief Загрузка диапазона объекта
+         */
+        struct Fetch {
+            uint32_t objectId;
+            uint64_t offset;
+            uint64_t length;
+            /**
+             * Смещение (от начала диапазона) первого еще не запрошенного байта
+             */
+            uint64_t next;
+            uint64_t received;
+            /**
+             * Запрошенные части по смещению от начала диапазона
+             */
+            std::map<uint64_t, FetchChunk> inflight;
+            FetchCallback callback;
+        };
+        /**
+         * \brief Запрошенная часть в очереди отправленных частей
+         */
+        struct SentChunk {
+            uint32_t fetch;
+            uint64_t rel;
+            Time sentAt;
+        };
+        /**
+         * \brief Найти часть загрузки для следующего запроса
+         * \param f загрузка
+         * \param rel смещение части от начала диапазона
+         * \param size размер части, не больше исходного значения
+         * \param retry часть запрашивается повторно
+         * \returns false, если запрашивать нечего
+         *
+         * Просроченная часть всегда находится в начале ::m_sentChunks, новая - в загрузке ::m_nextFetch,
+         * поэтому поиск не зависит от числа запрошенных частей.
+         */
+        bool NextFetchChunk (std::map<uint32_t, Fetch>::iterator &f, uint64_t &rel, uint32_t &size, bool &retry);
+        /**
+         * \brief Записать в запрос th объект и смещение очередной части загрузки
+         */
+        bool StampRequest (TricklesHeader &th);
+        /**
+         * \brief Учесть данные объекта, пришедшие в продолжении th
+         */
+        void DeliverObjectData (const TricklesHeader &th, Ptr<const Packet> data);
+        /**
+         * \brief Запросить просроченные части, даже если новых данных запрашивать не нужно
+         */
+        void FetchTimeout (void);
+        /**
+         * \brief Незавершенные загрузки по номеру, номера растут в порядке вызова ::RequestRange
+         */
+        std::map<uint32_t, Fetch> m_fetches;
+        /**
+         * \brief Номер следующей загрузки
+         */
+        uint32_t m_fetchId;
+        /**
+         * \brief Первая загрузка, у которой могут остаться незапрошенные данные
+         */
+        uint32_t m_nextFetch;
+        /**
+         * \brief Запрошенные части в порядке отправки (время отправки не убывает)
+         *
+         * Полученные и повторно запрошенные части удаляются из очереди, когда оказываются в ее начале.
+         */
+        std::deque<SentChunk> m_sentChunks;
+        /**
+         * \brief Срок повторного запроса первой части ::m_sentChunks
+         */
+        EventId m_fetchEvent;
+        /**
+         * \brief Обработчик данных объекта
+         */
+        ObjectDataCallback m_objectDataCallback;
     };
     
 } // namespace ns3
@@ -0,0 +1,223 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/string.h"
+#include "ns3/nstime.h"
+#include "ns3/object-vector.h"
+#include "ns3/callback.h"
+#include "trickles-l4-protocol.h"
+#include "trickles-socket-base.h"
+#include "trickles-stats-collector.h"
+
+NS_LOG_COMPONENT_DEFINE ("TricklesStatsCollector");
+
+namespace ns3 {
+    
+    NS_OBJECT_ENSURE_REGISTERED (TricklesStatsCollector);
+    
+    TypeId
+    TricklesStatsCollector::GetTypeId (void)
+    {
+        static TypeId tid = TypeId ("ns3::TricklesStatsCollector")
+        .SetParent<Object> ()
+        .AddConstructor<TricklesStatsCollector> ()
+        .AddAttribute ("BinWidth", "Width of the time bins the statistics are aggregated over.",
+                       TimeValue (Seconds (1.0)),
+                       MakeTimeAccessor (&TricklesStatsCollector::m_binWidth),
+                       MakeTimeChecker ())
+        .AddAttribute ("Interval", "Period of writing finished bins to the file (zero writes everything at the end).",
+                       TimeValue (Seconds (0)),
+                       MakeTimeAccessor (&TricklesStatsCollector::m_interval),
+                       MakeTimeChecker ())
+        .AddAttribute ("FileName", "Name of the CSV file.",
+                       StringValue ("trickles-stats.csv"),
+                       MakeStringAccessor (&TricklesStatsCollector::m_fileName),
+                       MakeStringChecker ())
+        ;
+        return tid;
+    }
+    
+    TricklesStatsCollector::Bin::Bin ()
+    : bytes (0),
+    rttSum (0),
+    rttSamples (0),
+    retxTrickles (0),
+    recoveries (0),
+    sackHolesMax (0)
+    {
+    }
+    
+    TricklesStatsCollector::Flow::Flow ()
+    : node (0),
+    retxHigh (0)
+    {
+    }
+    
+    TricklesStatsCollector::TricklesStatsCollector ()
+    : m_started (false)
+    {
+        NS_LOG_FUNCTION (this);
+    }
+    
+    TricklesStatsCollector::~TricklesStatsCollector ()
+    {
+        NS_LOG_FUNCTION (this);
+    }
+    
+    void TricklesStatsCollector::DoDispose (void)
+    {
+        NS_LOG_FUNCTION (this);
+        m_flushEvent.Cancel();
+        // Уничтожение до Simulator::Destroy: последний интервал записывается сейчас
+        if (m_destroyEvent.IsRunning()) {
+            m_destroyEvent.Cancel();
+            Flush(true);
+        }
+        for (std::map<uint32_t, Flow>::iterator f = m_flows.begin(); f != m_flows.end(); f++) {
+            Connect(f->first, false);
+        }
+        for (std::vector<Ptr<TricklesL4Protocol> >::iterator i = m_protocols.begin(); i != m_protocols.end(); i++) {
+            (*i)->TraceDisconnectWithoutContext("NewSocket", MakeCallback(&TricklesStatsCollector::NewSocket, this));
+        }
+        m_protocols.clear();
+        if (m_out.is_open()) m_out.close();
+        m_flows.clear();
+        Object::DoDispose ();
+    }
+    
+    void TricklesStatsCollector::Install (Ptr<Node> node)
+    {
+        NS_LOG_FUNCTION (this << node);
+        Ptr<TricklesL4Protocol> trickles = node->GetObject<TricklesL4Protocol>();
+        NS_ASSERT_MSG (trickles, "Trickles is not installed on node " << node->GetId());
+        ObjectVectorValue sockets;
+        trickles->GetAttribute("SocketList", sockets);
+        for (ObjectVectorValue::Iterator i = sockets.Begin(); i != sockets.End(); i++) {
+            Attach(DynamicCast<TricklesSocketBase>(i->second));
+        }
+        trickles->TraceConnectWithoutContext("NewSocket", MakeCallback(&TricklesStatsCollector::NewSocket, this));
+        m_protocols.push_back(trickles);
+    }
+    
+    void TricklesStatsCollector::NewSocket (Ptr<Socket> socket)
+    {
+        Attach(DynamicCast<TricklesSocketBase>(socket));
+    }
+    
+    uint32_t TricklesStatsCollector::Attach (Ptr<TricklesSocketBase> socket)
+    {
+        NS_LOG_FUNCTION (this << socket);
+        uint32_t flow = m_flows.size();
+        m_flows[flow].socket = socket;
+        m_flows[flow].node = socket->GetNode()?socket->GetNode()->GetId():0;
+        Connect(flow, true);
+        if (!m_started) {
+            m_started = true;
+            if (!m_interval.IsZero()) m_flushEvent = Simulator::Schedule(m_interval, &TricklesStatsCollector::PeriodicFlush, this);
+            // Событие держит сборщик до записи последнего интервала
+            m_destroyEvent = Simulator::ScheduleDestroy(&TricklesStatsCollector::Flush, Ptr<TricklesStatsCollector>(this), true);
+        }
+        return(flow);
+    }
+    
+    void TricklesStatsCollector::Connect (uint32_t flow, bool connect)
+    {
+        // Обработчики сравниваются по функции и привязанным аргументам, поэтому отключаются такими же
+        typedef bool (ObjectBase::*TraceOp)(std::string, const CallbackBase &);
+        TraceOp op = connect?&ObjectBase::TraceConnectWithoutContext:&ObjectBase::TraceDisconnectWithoutContext;
+        Ptr<TricklesSocketBase> socket = m_flows[flow].socket;
+        ((*socket).*op)("RxData", MakeBoundCallback(&TricklesStatsCollector::RxData, this, flow));
+        ((*socket).*op)("RttSample", MakeBoundCallback(&TricklesStatsCollector::RttSample, this, flow));
+        ((*socket).*op)("SackHoles", MakeBoundCallback(&TricklesStatsCollector::SackHoles, this, flow));
+        ((*socket).*op)("RetransmittedTrickles", MakeBoundCallback(&TricklesStatsCollector::RetransmittedTrickles, this, flow));
+        ((*socket).*op)("Recovery", MakeBoundCallback(&TricklesStatsCollector::Recovery, this, flow));
+    }
+    
+    TricklesStatsCollector::Bin &TricklesStatsCollector::Current (uint32_t flow)
+    {
+        return(m_flows[flow].bins[Simulator::Now().GetInteger()/m_binWidth.GetInteger()]);
+    }
+    
+    void TricklesStatsCollector::RxData (TricklesStatsCollector *collector, uint32_t flow, uint32_t bytes)
+    {
+        collector->Current(flow).bytes += bytes;
+    }
+    
+    void TricklesStatsCollector::RttSample (TricklesStatsCollector *collector, uint32_t flow, Time rtt)
+    {
+        Bin &b = collector->Current(flow);
+        b.rttSum += rtt.GetSeconds();
+        b.rttSamples++;
+    }
+    
+    void TricklesStatsCollector::SackHoles (TricklesStatsCollector *collector, uint32_t flow, uint32_t holes)
+    {
+        Bin &b = collector->Current(flow);
+        if (holes>b.sackHolesMax) b.sackHolesMax = holes;
+    }
+    
+    void TricklesStatsCollector::RetransmittedTrickles (TricklesStatsCollector *collector, uint32_t flow, SequenceNumber32 from, SequenceNumber32 to)
+    {
+        Flow &f = collector->m_flows[flow];
+        // Повторный запрос той же струйки не учитывается
+        if (from<f.retxHigh) from = f.retxHigh;
+        if (to<=from) return;
+        collector->Current(flow).retxTrickles += to-from;
+        f.retxHigh = to;
+    }
+    
+    void TricklesStatsCollector::Recovery (TricklesStatsCollector *collector, uint32_t flow, uint8_t reason)
+    {
+        collector->Current(flow).recoveries++;
+    }
+    
+    void TricklesStatsCollector::PeriodicFlush (void)
+    {
+        Flush();
+        m_flushEvent = Simulator::Schedule(m_interval, &TricklesStatsCollector::PeriodicFlush, this);
+    }
+    
+    void TricklesStatsCollector::Flush (bool final)
+    {
+        NS_LOG_FUNCTION (this << final);
+        if (!m_out.is_open()) {
+            m_out.open(m_fileName.c_str());
+            m_out << "flow,node,bin_start,bytes,goodput_bps,rtt_mean_ms,rtt_samples,retx_trickles,recoveries,sack_holes_max\n";
+        }
+        int64_t current = Simulator::Now().GetInteger()/m_binWidth.GetInteger();
+        double width = m_binWidth.GetSeconds();
+        for (std::map<uint32_t, Flow>::iterator f = m_flows.begin(); f != m_flows.end(); f++) {
+            std::map<int64_t, Bin>::iterator b = f->second.bins.begin();
+            // Интервал, в который еще приходят события, записывается только в конце
+            while ((b != f->second.bins.end()) && (final || (b->first<current))) {
+                const Bin &v = b->second;
+                m_out << f->first << "," << f->second.node << "," << b->first*width << ","
+                << v.bytes << "," << v.bytes*8.0/width << ","
+                << (v.rttSamples?v.rttSum*1000/v.rttSamples:0) << "," << v.rttSamples << ","
+                << v.retxTrickles << "," << v.recoveries << "," << v.sackHolesMax << "\n";
+                f->second.bins.erase(b++);
+            }
+        }
+        m_out.flush();
+    }
+}
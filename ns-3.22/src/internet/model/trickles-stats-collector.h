@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#ifndef TRICKLES_STATS_COLLECTOR_H
+#define TRICKLES_STATS_COLLECTOR_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/sequence-number.h"
+
+namespace ns3 {
+    class Node;
+    class Socket;
+    class TricklesSocketBase;
+    class TricklesL4Protocol;
+    
+    /**
+     * \ingroup tricklestp
+     * \class TricklesStatsCollector
+     *
+     * \brief Сборщик статистики по потокам Trickles
+     *
+     * Подключается к источникам трассировки клиентских сокетов (RxData, RttSample, SackHoles, RetransmittedTrickles, Recovery) и накапливает для каждого потока значения по интервалам длины BinWidth: принятые байты, среднее RTT, число повторно запрошенных струек (каждая струйка учитывается один раз, сколько бы раз ее ни запрашивали), число восстановлений, наибольшее число пропусков SACK. Результат записывается в CSV-файл FileName: каждые Interval секунд (если Interval не равен нулю) и при завершении моделирования.
+     *
+     * Сборщик заменяет разбор ASCII-трассировки: в памяти хранятся только незаписанные интервалы.
+     *
+     * Сборщик остается в памяти до завершения моделирования, чтобы записать последний интервал (Simulator::Destroy). При уничтожении (Dispose) раньше этого он записывает накопленное и отключается от сокетов и протоколов.
+     */
+    class TricklesStatsCollector : public Object
+    {
+    public:
+        static TypeId GetTypeId (void);
+        TricklesStatsCollector ();
+        virtual ~TricklesStatsCollector ();
+        
+        /**
+         * \brief Собирать статистику всех сокетов Trickles узла
+         *
+         * Подключаются уже созданные сокеты и все сокеты, которые будут созданы позже (трассировка NewSocket протокола).
+         */
+        void Install (Ptr<Node> node);
+        /**
+         * \brief Собирать статистику сокета
+         *
+         * \returns номер потока в файле статистики
+         */
+        uint32_t Attach (Ptr<TricklesSocketBase> socket);
+        /**
+         * \brief Записать накопленные интервалы в файл
+         *
+         * Текущий (незавершенный) интервал записывается, только если final равен true.
+         */
+        void Flush (bool final = false);
+        
+    protected:
+        virtual void DoDispose (void);
+        
+    private:
+        /**
+         * \brief Значения потока за один интервал
+         */
+        struct Bin {
+            Bin ();
+            uint64_t bytes;
+            double rttSum;
+            uint32_t rttSamples;
+            uint32_t retxTrickles;
+            uint32_t recoveries;
+            uint32_t sackHolesMax;
+        };
+        /**
+         * \brief Поток (клиентский сокет)
+         */
+        struct Flow {
+            Flow ();
+            Ptr<TricklesSocketBase> socket;
+            uint32_t node;
+            /**
+             * \brief Струйки ниже retxHigh уже учтены как повторно запрошенные
+             *
+             * Пропуски в полученных струйках не появляются ниже уже принятых струек, поэтому достаточно одной границы.
+             */
+            SequenceNumber32 retxHigh;
+            std::map<int64_t, Bin> bins;
+        };
+        
+        Bin &Current (uint32_t flow);
+        void NewSocket (Ptr<Socket> socket);
+        /**
+         * \brief Подключить (connect равен true) или отключить обработчики трассировки потока flow
+         */
+        void Connect (uint32_t flow, bool connect);
+        /**@{*/
+        /**
+         * \brief Обработчики трассировки сокета, привязанные к сборщику и номеру потока
+         */
+        static void RxData (TricklesStatsCollector *collector, uint32_t flow, uint32_t bytes);
+        static void RttSample (TricklesStatsCollector *collector, uint32_t flow, Time rtt);
+        static void SackHoles (TricklesStatsCollector *collector, uint32_t flow, uint32_t holes);
+        static void RetransmittedTrickles (TricklesStatsCollector *collector, uint32_t flow, SequenceNumber32 from, SequenceNumber32 to);
+        static void Recovery (TricklesStatsCollector *collector, uint32_t flow, uint8_t reason);
+        /**@}*/
+        void PeriodicFlush (void);
+        
+        Time m_binWidth;
+        Time m_interval;
+        std::string m_fileName;
+        std::ofstream m_out;
+        std::map<uint32_t, Flow> m_flows;
+        EventId m_flushEvent;
+        EventId m_destroyEvent;
+        /**
+         * \brief Протоколы узлов, к трассировке NewSocket которых подключен сборщик
+         */
+        std::vector<Ptr<TricklesL4Protocol> > m_protocols;
+        bool m_started;
+    };
+}
+
+#endif /* TRICKLES_STATS_COLLECTOR_H */
@@ -78,7 +78,8 @@ TricklesHeaderSimpleTest::DoRun (void)
         trh.SetTrickleNumber(i+1);
         uint16_t m_segSize = 1000;
         trh.SetRequestSize(m_segSize);
-        trh.SetRecovery(NO_RECOVERY);
+        trh.SetRecovery((i%3)?NO_RECOVERY:RTO_TIMEOUT);
+        trh.SetEce((i%2)==0);
         trh.SetTSVal(SequenceNumber32(0));
         trh.SetTSEcr(SequenceNumber32(0));
         trh.SetRTT(Seconds(0.0));
@@ -100,6 +101,8 @@ TricklesHeaderSimpleTest::DoRun (void)
         NS_TEST_ASSERT_EQUAL (trh.GetTrickleNumber(), SequenceNumber32(i+1));
         NS_TEST_ASSERT_EQUAL (trh.GetPacketType(), REQUEST);
         NS_TEST_ASSERT_EQUAL (trh.GetFirstLoss(), SequenceNumber32(0));
+        NS_TEST_ASSERT_EQUAL (trh.IsRecovery(), (i%3)?NO_RECOVERY:RTO_TIMEOUT);
+        NS_TEST_ASSERT_EQUAL (trh.GetEce(), (i%2)==0);
         sack = trh.GetSacks();
         NS_TEST_ASSERT_EQUAL(sack.numBlocks(), 1);
         SackConstIterator j = sack.firstBlock();
@@ -108,7 +111,113 @@ TricklesHeaderSimpleTest::DoRun (void)
         NS_TEST_ASSERT_EQUAL(tsh.GetTcpBase(), SequenceNumber32(0));
         NS_TEST_ASSERT_EQUAL(tsh.GetStartCwnd(), i);
         NS_TEST_ASSERT_EQUAL(tsh.GetSsthresh(), 4);
+        NS_TEST_ASSERT_EQUAL(trh.HasObject(), false);
     }
+    
+    TricklesHeader oth;
+    oth.SetPacketType(REQUEST);
+    oth.SetTrickleNumber(SequenceNumber32(7));
+    oth.SetRequestSize(500);
+    uint32_t plainSize = oth.GetSerializedSize();
+    oth.SetObject(12, 0x100000000ULL+3000);
+    NS_TEST_ASSERT_EQUAL(oth.GetSerializedSize(), plainSize+12);
+    Ptr<Packet> p = Create<Packet> (100);
+    p->AddHeader(oth);
+    TricklesHeader orcvd;
+    NS_TEST_ASSERT_MSG_EQ(((p->RemoveHeader(orcvd))!=0), true, "Header not found");
+    NS_TEST_ASSERT_EQUAL(p->GetSize(), 100);
+    NS_TEST_ASSERT_EQUAL(orcvd.HasObject(), true);
+    NS_TEST_ASSERT_EQUAL(orcvd.GetObjectId(), 12);
+    NS_TEST_ASSERT_EQUAL(orcvd.GetObjectOffset(), 0x100000000ULL+3000);
+    NS_TEST_ASSERT_EQUAL(orcvd.GetRequestSize(), 500);
+    orcvd.ClearObject();
+    NS_TEST_ASSERT_EQUAL(orcvd.GetSerializedSize(), plainSize);
+}
+
+
+class TricklesShiehHeaderOptionsTest : public TestCase
+{
+public:
+  virtual void DoRun (void);
+  TricklesShiehHeaderOptionsTest ();
+};
+
+TricklesShiehHeaderOptionsTest::TricklesShiehHeaderOptionsTest ()
+  : TestCase ("Trickles Shieh header options test")
+{
+}
+
+void
+TricklesShiehHeaderOptionsTest::DoRun (void)
+{
+    TricklesShiehHeader plain;
+    plain.SetTcpBase(SequenceNumber32(10));
+    plain.SetStartCwnd(5);
+    plain.SetSsthresh(8);
+    NS_TEST_ASSERT_EQUAL(plain.GetSerializedSize(), 9);
+    NS_TEST_ASSERT_EQUAL(plain.HasOption(TricklesShiehHeader::OPT_CUBIC), false);
+
+    TricklesShiehHeader tsh = plain;
+    tsh.SetWMax(300);
+    tsh.SetEpochRtt(MilliSeconds(120));
+    NS_TEST_ASSERT_EQUAL(tsh.HasOption(TricklesShiehHeader::OPT_CUBIC), true);
+    Ptr<Packet> p = Create<Packet> (100);
+    p->AddHeader(tsh);
+    TricklesShiehHeader rcvd;
+    NS_TEST_ASSERT_MSG_EQ(((p->RemoveHeader(rcvd))!=0), true, "Header not found");
+    NS_TEST_ASSERT_EQUAL(p->GetSize(), 100);
+    NS_TEST_ASSERT_EQUAL(rcvd.GetTcpBase(), SequenceNumber32(10));
+    NS_TEST_ASSERT_EQUAL(rcvd.GetStartCwnd(), 5);
+    NS_TEST_ASSERT_EQUAL(rcvd.GetSsthresh(), 8);
+    NS_TEST_ASSERT_EQUAL(rcvd.HasOption(TricklesShiehHeader::OPT_CUBIC), true);
+    NS_TEST_ASSERT_EQUAL(rcvd.GetWMax(), 300);
+    NS_TEST_ASSERT_EQUAL(rcvd.GetEpochRtt(), MilliSeconds(120));
+
+    TricklesShiehHeader dsh = plain;
+    dsh.SetBaseRtt(MicroSeconds(40250));
+    dsh.SetSlowStartDone(true);
+    dsh.SetOption(TricklesShiehHeader::OPT_REBASE);
+    NS_TEST_ASSERT_EQUAL(dsh.GetSerializedSize(), 15);
+    p = Create<Packet> (100);
+    p->AddHeader(dsh);
+    TricklesShiehHeader drcvd;
+    NS_TEST_ASSERT_MSG_EQ(((p->RemoveHeader(drcvd))!=0), true, "Header not found");
+    NS_TEST_ASSERT_EQUAL(p->GetSize(), 100);
+    NS_TEST_ASSERT_EQUAL(drcvd.HasOption(TricklesShiehHeader::OPT_CUBIC), false);
+    NS_TEST_ASSERT_EQUAL(drcvd.HasOption(TricklesShiehHeader::OPT_REBASE), true);
+    NS_TEST_ASSERT_EQUAL(drcvd.GetBaseRtt(), MicroSeconds(40250));
+    NS_TEST_ASSERT_EQUAL(drcvd.IsSlowStartDone(), true);
+    drcvd.SetDrainFrom(20);
+    NS_TEST_ASSERT_EQUAL(drcvd.GetSerializedSize(), 17);
+    drcvd.ClearOption(TricklesShiehHeader::OPT_DRAIN);
+    drcvd.ClearOption(TricklesShiehHeader::OPT_REBASE);
+    NS_TEST_ASSERT_EQUAL(drcvd.GetSerializedSize(), 15);
+    NS_TEST_ASSERT_EQUAL(drcvd.HasOption(TricklesShiehHeader::OPT_REBASE), false);
+    
+    TricklesShiehHeader hsh = plain;
+    hsh.SetHyStartCwnd(42);
+    NS_TEST_ASSERT_EQUAL(hsh.GetSerializedSize(), 12);
+    p = Create<Packet> (100);
+    p->AddHeader(hsh);
+    TricklesShiehHeader hrcvd;
+    NS_TEST_ASSERT_MSG_EQ(((p->RemoveHeader(hrcvd))!=0), true, "Header not found");
+    NS_TEST_ASSERT_EQUAL(p->GetSize(), 100);
+    NS_TEST_ASSERT_EQUAL(hrcvd.HasOption(TricklesShiehHeader::OPT_HYSTART), true);
+    NS_TEST_ASSERT_EQUAL(hrcvd.GetHyStartCwnd(), 42);
+    NS_TEST_ASSERT_EQUAL(hrcvd.GetSsthresh(), 8);
+    
+    TricklesShiehHeader bsh = plain;
+    bsh.SetRequestBytes(200);
+    bsh.SetUnitBytes(1400);
+    NS_TEST_ASSERT_EQUAL(bsh.GetSerializedSize(), 14);
+    p = Create<Packet> (100);
+    p->AddHeader(bsh);
+    TricklesShiehHeader brcvd;
+    NS_TEST_ASSERT_MSG_EQ(((p->RemoveHeader(brcvd))!=0), true, "Header not found");
+    NS_TEST_ASSERT_EQUAL(p->GetSize(), 100);
+    NS_TEST_ASSERT_EQUAL(brcvd.HasOption(TricklesShiehHeader::OPT_BYTES), true);
+    NS_TEST_ASSERT_EQUAL(brcvd.GetRequestBytes(), 200);
+    NS_TEST_ASSERT_EQUAL(brcvd.GetUnitBytes(), 1400);
 }
 
 
@@ -119,5 +228,6 @@ public:
   TricklesHeaderTestSuite () : TestSuite ("trickles-header", UNIT)
   {
     AddTestCase (new TricklesHeaderSimpleTest, TestCase::QUICK);
+    AddTestCase (new TricklesShiehHeaderOptionsTest, TestCase::QUICK);
   }
 } g_tricklesHeaderTestSuite;
@@ -0,0 +1,388 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/node.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/global-value.h"
+#include "ns3/nstime.h"
+
+#include "ns3/arp-l3-protocol.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/icmpv4-l4-protocol.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/ipv4-static-routing.h"
+#include "ns3/trickles-l4-protocol.h"
+#include "ns3/trickles-header.h"
+#include "ns3/trickles-shieh.h"
+#include "ns3/trickles-load-balancer.h"
+#include "ns3/tcp-header.h"
+
+#include <vector>
+
+NS_LOG_COMPONENT_DEFINE ("TricklesL4TestSuite");
+
+using namespace ns3;
+
+#define NS_TEST_ASSERT_EQUAL(a,b) NS_TEST_ASSERT_MSG_EQ (a,b, "foo")
+#define NS_TEST_ASSERT(a) NS_TEST_ASSERT_MSG_EQ (bool(a), true, "foo")
+
+/*
+ * Nodes with the Trickles protocol connected by a simple channel
+ */
+class TricklesL4TestCase : public TestCase
+{
+public:
+    TricklesL4TestCase (std::string name);
+protected:
+    Ptr<Node> CreateInternetNode (void);
+    Ptr<SimpleNetDevice> AddSimpleNetDevice (Ptr<Node> node, const char* ipaddr, const char* netmask);
+    void SetDefaultRoute (Ptr<Node> node, const char* gateway);
+    virtual void DoTeardown (void);
+};
+
+TricklesL4TestCase::TricklesL4TestCase (std::string name)
+: TestCase (name)
+{
+}
+
+void
+TricklesL4TestCase::DoTeardown (void)
+{
+    Simulator::Destroy ();
+}
+
+Ptr<Node>
+TricklesL4TestCase::CreateInternetNode ()
+{
+    Ptr<Node> node = CreateObject<Node> ();
+    //ARP
+    Ptr<ArpL3Protocol> arp = CreateObject<ArpL3Protocol> ();
+    node->AggregateObject (arp);
+    //IPV4
+    Ptr<Ipv4L3Protocol> ipv4 = CreateObject<Ipv4L3Protocol> ();
+    //Routing for Ipv4
+    Ptr<Ipv4ListRouting> ipv4Routing = CreateObject<Ipv4ListRouting> ();
+    ipv4->SetRoutingProtocol (ipv4Routing);
+    Ptr<Ipv4StaticRouting> ipv4staticRouting = CreateObject<Ipv4StaticRouting> ();
+    ipv4Routing->AddRoutingProtocol (ipv4staticRouting, 0);
+    node->AggregateObject (ipv4);
+    //ICMP
+    Ptr<Icmpv4L4Protocol> icmp = CreateObject<Icmpv4L4Protocol> ();
+    node->AggregateObject (icmp);
+    //UDP
+    Ptr<UdpL4Protocol> udp = CreateObject<UdpL4Protocol> ();
+    node->AggregateObject (udp);
+    //Trickles
+    Ptr<TricklesL4Protocol> trickles = CreateObject<TricklesL4Protocol> ();
+    node->AggregateObject (trickles);
+    return node;
+}
+
+Ptr<SimpleNetDevice>
+TricklesL4TestCase::AddSimpleNetDevice (Ptr<Node> node, const char* ipaddr, const char* netmask)
+{
+    Ptr<SimpleNetDevice> dev = CreateObject<SimpleNetDevice> ();
+    dev->SetAddress (Mac48Address::ConvertFrom (Mac48Address::Allocate ()));
+    node->AddDevice (dev);
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    uint32_t ndid = ipv4->AddInterface (dev);
+    Ipv4InterfaceAddress ipv4Addr = Ipv4InterfaceAddress (Ipv4Address (ipaddr), Ipv4Mask (netmask));
+    ipv4->AddAddress (ndid, ipv4Addr);
+    ipv4->SetUp (ndid);
+    return dev;
+}
+
+void
+TricklesL4TestCase::SetDefaultRoute (Ptr<Node> node, const char* gateway)
+{
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ());
+    int16_t priority;
+    Ptr<Ipv4StaticRouting> routing = DynamicCast<Ipv4StaticRouting> (list->GetRoutingProtocol (0, priority));
+    // The node has the loopback and one device
+    routing->SetDefaultRoute (Ipv4Address (gateway), 1);
+}
+
+class TricklesShiehPacingProbe : public TricklesShieh
+{
+public:
+    using TricklesShieh::TagPacing;
+};
+
+/*
+ * Continuations leave the node after the delay the server derived from the request,
+ * the protocol keeps no per-receiver state for that
+ */
+class TricklesPacingTest : public TricklesL4TestCase
+{
+public:
+    TricklesPacingTest ();
+private:
+    virtual void DoRun (void);
+    void SendTagged (Ptr<TricklesL4Protocol> trickles, Time delay, bool tagged);
+    void TxTrace (const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface);
+    std::vector<Time> m_tx;
+};
+
+TricklesPacingTest::TricklesPacingTest ()
+: TricklesL4TestCase ("Trickles continuation pacing")
+{
+}
+
+void
+TricklesPacingTest::SendTagged (Ptr<TricklesL4Protocol> trickles, Time delay, bool tagged)
+{
+    Ptr<Packet> p = Create<Packet> (100);
+    if (tagged) {
+        TricklesPacingTag tag;
+        tag.SetDelay (delay);
+        p->AddPacketTag (tag);
+    }
+    trickles->Send (p, Ipv4Address ("192.168.1.1"), Ipv4Address ("192.168.1.2"), 50000, 50001);
+}
+
+void
+TricklesPacingTest::TxTrace (const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface)
+{
+    if (h.GetDestination () == Ipv4Address ("192.168.1.2")) m_tx.push_back (Simulator::Now ());
+}
+
+void
+TricklesPacingTest::DoRun (void)
+{
+    // The delay of the index-th continuation of a request is index*RTT/cwnd
+    Ptr<TricklesShiehPacingProbe> shieh = CreateObject<TricklesShiehPacingProbe> ();
+    TricklesHeader th;
+    th.SetRTT (MilliSeconds (10));
+    Ptr<Packet> first = Create<Packet> ();
+    shieh->TagPacing (first, th, 5, 0);
+    TricklesPacingTag tag;
+    NS_TEST_ASSERT_MSG_EQ (first->PeekPacketTag (tag), false, "The first continuation of a request is not delayed");
+    Ptr<Packet> third = Create<Packet> ();
+    shieh->TagPacing (third, th, 5, 2);
+    NS_TEST_ASSERT_MSG_EQ (third->PeekPacketTag (tag), true, "Further continuations are delayed");
+    NS_TEST_ASSERT_EQUAL (tag.GetDelay (), MilliSeconds (4));
+
+    Ptr<Node> node0 = CreateInternetNode ();
+    Ptr<Node> node1 = CreateInternetNode ();
+    Ptr<SimpleNetDevice> dev0 = AddSimpleNetDevice (node0, "192.168.1.1", "255.255.255.0");
+    Ptr<SimpleNetDevice> dev1 = AddSimpleNetDevice (node1, "192.168.1.2", "255.255.255.0");
+    Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+    dev0->SetChannel (channel);
+    dev1->SetChannel (channel);
+    node0->GetObject<Ipv4> ()->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&TricklesPacingTest::TxTrace, this));
+    Ptr<TricklesL4Protocol> trickles = node0->GetObject<TricklesL4Protocol> ();
+
+    // Pacing on: the tagged packets wait for their delay, the order of sending does not matter
+    trickles->SetAttribute ("Pacing", BooleanValue (true));
+    Simulator::Schedule (Seconds (1), &TricklesPacingTest::SendTagged, this, trickles, MilliSeconds (4), true);
+    Simulator::Schedule (Seconds (1), &TricklesPacingTest::SendTagged, this, trickles, MilliSeconds (2), true);
+    Simulator::Schedule (Seconds (1), &TricklesPacingTest::SendTagged, this, trickles, Time (0), false);
+    Simulator::Schedule (Seconds (1), &TricklesPacingTest::SendTagged, this, trickles, MilliSeconds (300), true);
+    Simulator::Stop (Seconds (2));
+    Simulator::Run ();
+    NS_TEST_ASSERT_EQUAL (m_tx.size (), 4);
+    Time tol = MicroSeconds (100);
+    NS_TEST_ASSERT_MSG_EQ_TOL (m_tx[0], Seconds (1), tol, "An untagged packet is sent at once");
+    NS_TEST_ASSERT_MSG_EQ_TOL (m_tx[1], Seconds (1.002), tol, "Released after its delay");
+    NS_TEST_ASSERT_MSG_EQ_TOL (m_tx[2], Seconds (1.004), tol, "Released after its delay");
+    NS_TEST_ASSERT_MSG_EQ_TOL (m_tx[3], Seconds (1.3), tol, "A delay longer than the timer wheel");
+
+    // Pacing off: the tag is ignored
+    m_tx.clear ();
+    trickles->SetAttribute ("Pacing", BooleanValue (false));
+    Simulator::Schedule (Seconds (1), &TricklesPacingTest::SendTagged, this, trickles, MilliSeconds (4), true);
+    Simulator::Stop (Seconds (2));
+    Simulator::Run ();
+    NS_TEST_ASSERT_EQUAL (m_tx.size (), 1);
+    NS_TEST_ASSERT_MSG_EQ_TOL (m_tx[0], Seconds (3), tol, "Without pacing the tag is ignored");
+    Simulator::Destroy ();
+}
+
+/*
+ * The load balancer picks a replica by its policy, rewrites the addresses
+ * both ways and keeps the Trickles checksum valid for the new addresses
+ */
+class TricklesLoadBalancerTest : public TricklesL4TestCase
+{
+public:
+    TricklesLoadBalancerTest ();
+private:
+    virtual void DoRun (void);
+    virtual void DoTeardown (void);
+    void SendRequest (uint32_t trickle);
+    void SendResponse (uint32_t replica);
+    void Deliver (std::string context, const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface);
+    uint32_t Load0 (void) { return m_load[0]; }
+    uint32_t Load1 (void) { return m_load[1]; }
+    Ptr<Node> m_client;
+    std::vector<Ptr<Node> > m_replicas;
+    std::vector<uint32_t> m_received;
+    std::vector<uint32_t> m_load;
+    uint32_t m_clientReceived;
+    uint32_t m_badChecksums;
+};
+
+TricklesLoadBalancerTest::TricklesLoadBalancerTest ()
+: TricklesL4TestCase ("Trickles load balancer"),
+m_received (2, 0),
+m_load (2, 0),
+m_clientReceived (0),
+m_badChecksums (0)
+{
+}
+
+void
+TricklesLoadBalancerTest::SendRequest (uint32_t trickle)
+{
+    Ptr<Packet> p = Create<Packet> (100);
+    TricklesHeader th;
+    th.SetTrickleNumber (SequenceNumber32 (trickle));
+    p->AddHeader (th);
+    m_client->GetObject<TricklesL4Protocol> ()->Send (p, Ipv4Address ("10.1.1.2"), Ipv4Address ("10.255.255.1"), 50000, 50001);
+}
+
+void
+TricklesLoadBalancerTest::SendResponse (uint32_t replica)
+{
+    Ptr<Packet> p = Create<Packet> (100);
+    TricklesHeader th;
+    p->AddHeader (th);
+    Ipv4Address address = (replica == 0)?Ipv4Address ("10.1.2.2"):Ipv4Address ("10.1.2.3");
+    m_replicas[replica]->GetObject<TricklesL4Protocol> ()->Send (p, address, Ipv4Address ("10.1.1.2"), 50001, 50000);
+}
+
+void
+TricklesLoadBalancerTest::Deliver (std::string context, const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface)
+{
+    if (h.GetProtocol () != TricklesL4Protocol::PROT_NUMBER) return;
+    // The same check as TricklesL4Protocol::Receive
+    TcpHeader tcph;
+    tcph.EnableChecksums ();
+    tcph.InitializeChecksum (h.GetSource (), h.GetDestination (), TricklesL4Protocol::PROT_NUMBER);
+    p->PeekHeader (tcph);
+    if (!tcph.IsChecksumOk ()) m_badChecksums++;
+    if (context == "client") {
+        NS_TEST_EXPECT_MSG_EQ (h.GetSource (), Ipv4Address ("10.255.255.1"), "Responses come from the virtual address");
+        m_clientReceived++;
+        return;
+    }
+    uint32_t replica = (context == "0")?0:1;
+    NS_TEST_EXPECT_MSG_EQ (h.GetDestination (), (replica == 0)?Ipv4Address ("10.1.2.2"):Ipv4Address ("10.1.2.3"), "Requests are addressed to the replica");
+    NS_TEST_EXPECT_MSG_EQ (h.GetSource (), Ipv4Address ("10.1.1.2"), "The client address is kept");
+    m_received[replica]++;
+}
+
+void
+TricklesLoadBalancerTest::DoRun (void)
+{
+    // Without the checksum fix the replicas would drop every request
+    GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+
+    m_client = CreateInternetNode ();
+    Ptr<Node> router = CreateInternetNode ();
+    m_replicas.push_back (CreateInternetNode ());
+    m_replicas.push_back (CreateInternetNode ());
+    Ptr<SimpleChannel> front = CreateObject<SimpleChannel> ();
+    Ptr<SimpleChannel> back = CreateObject<SimpleChannel> ();
+    AddSimpleNetDevice (m_client, "10.1.1.2", "255.255.255.0")->SetChannel (front);
+    AddSimpleNetDevice (router, "10.1.1.1", "255.255.255.0")->SetChannel (front);
+    AddSimpleNetDevice (router, "10.1.2.1", "255.255.255.0")->SetChannel (back);
+    AddSimpleNetDevice (m_replicas[0], "10.1.2.2", "255.255.255.0")->SetChannel (back);
+    AddSimpleNetDevice (m_replicas[1], "10.1.2.3", "255.255.255.0")->SetChannel (back);
+    SetDefaultRoute (m_client, "10.1.1.1");
+    SetDefaultRoute (m_replicas[0], "10.1.2.1");
+    SetDefaultRoute (m_replicas[1], "10.1.2.1");
+    m_client->GetObject<Ipv4> ()->TraceConnect ("LocalDeliver", "client", MakeCallback (&TricklesLoadBalancerTest::Deliver, this));
+    m_replicas[0]->GetObject<Ipv4> ()->TraceConnect ("LocalDeliver", "0", MakeCallback (&TricklesLoadBalancerTest::Deliver, this));
+    m_replicas[1]->GetObject<Ipv4> ()->TraceConnect ("LocalDeliver", "1", MakeCallback (&TricklesLoadBalancerTest::Deliver, this));
+
+    Ptr<TricklesLoadBalancer> lb = CreateObject<TricklesLoadBalancer> ();
+    lb->SetAttribute ("VirtualAddress", Ipv4AddressValue (Ipv4Address ("10.255.255.1")));
+    lb->AddReplica (Ipv4Address ("10.1.2.2"), MakeCallback (&TricklesLoadBalancerTest::Load0, this));
+    lb->AddReplica (Ipv4Address ("10.1.2.3"), MakeCallback (&TricklesLoadBalancerTest::Load1, this));
+    lb->Install (router);
+
+    // Round robin alternates the replicas
+    lb->SetAttribute ("Policy", EnumValue (TricklesLoadBalancer::ROUND_ROBIN));
+    for (uint32_t i = 0; i < 4; i++) Simulator::Schedule (Seconds (1+i*0.1), &TricklesLoadBalancerTest::SendRequest, this, i);
+    Simulator::Stop (Seconds (2));
+    Simulator::Run ();
+    NS_TEST_ASSERT_EQUAL (m_received[0], 2);
+    NS_TEST_ASSERT_EQUAL (m_received[1], 2);
+    NS_TEST_ASSERT_EQUAL (lb->GetForwarded (0), 2);
+    NS_TEST_ASSERT_EQUAL (lb->GetForwarded (1), 2);
+
+    // Hash sends the same trickle to the same replica
+    lb->SetAttribute ("Policy", EnumValue (TricklesLoadBalancer::HASH));
+    m_received.assign (2, 0);
+    for (uint32_t i = 0; i < 3; i++) Simulator::Schedule (Seconds (0.1+i*0.1), &TricklesLoadBalancerTest::SendRequest, this, 7);
+    Simulator::Stop (Seconds (1));
+    Simulator::Run ();
+    NS_TEST_ASSERT_MSG_EQ (m_received[0]+m_received[1], 3, "Every request reaches a replica");
+    NS_TEST_ASSERT_MSG_EQ ((m_received[0] == 3) || (m_received[1] == 3), true, "One trickle is always served by one replica");
+
+    // Least queue follows the load the replicas report
+    lb->SetAttribute ("Policy", EnumValue (TricklesLoadBalancer::LEAST_QUEUE));
+    m_received.assign (2, 0);
+    m_load[0] = 5;
+    m_load[1] = 1;
+    for (uint32_t i = 0; i < 3; i++) Simulator::Schedule (Seconds (0.1+i*0.1), &TricklesLoadBalancerTest::SendRequest, this, i);
+    Simulator::Stop (Seconds (1));
+    Simulator::Run ();
+    NS_TEST_ASSERT_EQUAL (m_received[0], 0);
+    NS_TEST_ASSERT_EQUAL (m_received[1], 3);
+
+    // Continuations of both replicas reach the client from the virtual address
+    Simulator::Schedule (Seconds (0.1), &TricklesLoadBalancerTest::SendResponse, this, 0);
+    Simulator::Schedule (Seconds (0.2), &TricklesLoadBalancerTest::SendResponse, this, 1);
+    Simulator::Stop (Seconds (1));
+    Simulator::Run ();
+    NS_TEST_ASSERT_EQUAL (m_clientReceived, 2);
+    NS_TEST_ASSERT_MSG_EQ (m_badChecksums, 0, "Rewritten packets carry a valid checksum");
+}
+
+void
+TricklesLoadBalancerTest::DoTeardown (void)
+{
+    // Other suites run with checksums off
+    GlobalValue::Bind ("ChecksumEnabled", BooleanValue (false));
+    m_client = 0;
+    m_replicas.clear ();
+    TricklesL4TestCase::DoTeardown ();
+}
+
+static class TricklesL4TestSuite : public TestSuite
+{
+public:
+    TricklesL4TestSuite ()
+    : TestSuite ("trickles-l4", UNIT)
+    {
+        AddTestCase (new TricklesPacingTest (), TestCase::QUICK);
+        AddTestCase (new TricklesLoadBalancerTest (), TestCase::QUICK);
+    }
+} g_tricklesL4TestSuite;
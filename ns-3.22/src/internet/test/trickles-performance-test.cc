@@ -0,0 +1,340 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include "ns3/test.h"
+#include "ns3/socket-factory.h"
+#include "ns3/trickles-socket-factory.h"
+#include "ns3/simulator.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/drop-tail-queue.h"
+#include "ns3/error-model.h"
+#include "ns3/config.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/pointer.h"
+#include "ns3/data-rate.h"
+#include "ns3/ipv4-static-routing.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/node.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/arp-l3-protocol.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/icmpv4-l4-protocol.h"
+#include "ns3/trickles-l4-protocol.h"
+#include "ns3/trickles-header.h"
+#include "ns3/trickles-socket-base.h"
+
+NS_LOG_COMPONENT_DEFINE ("TricklesPerformanceTestSuite");
+
+using namespace ns3;
+
+/**
+ * \brief Передача по двухточечному каналу с контролем производительности
+ *
+ * Клиент TricklesShieh запрашивает данные у эхо-сервера в течение duration секунд. Измеряются
+ * - полезная пропускная способность как доля скорости канала;
+ * - число пакетных событий IP (отправка и доставка на обоих узлах) на переданный мегабайт;
+ * - наибольший объем состояния сокетов (TricklesSocketBase::GetStateSize).
+ *
+ * Пороги заданы заранее: полезная пропускная способность - не меньше GoodputFraction от ожидаемой (скорость канала, а при потерях - не больше оценки Мэтиса 1.22*MSS/(RTT*sqrt(p)) с RTT, включающим полную очередь), событий на мегабайт - не больше EventsPerMbBudget (без потерь на сегмент приходится 4 события: запрос и продолжение, каждое отправлено и доставлено), состояние - не больше StateBudget.
+ *
+ * Дополнительно опыт сравнивается с базовыми значениями, если они записаны в файле каталога данных набора (по одному файлу на опыт, см. #BaselineName): пропускная способность не должна упасть больше чем на UtilizationTolerance, события и состояние - вырасти больше чем на EventsTolerance и StateTolerance. Базовые значения записываются командой test.py --suite=trickles-performance --update-data на заведомо исправной версии: измерения каждого запуска пишутся в файл CreateTempDirFilename(), который с --update-data находится в каталоге данных.
+ */
+class TricklesPerformanceTestCase : public TestCase
+{
+public:
+    TricklesPerformanceTestCase (std::string rate, Time delay, double loss);
+    static const double GoodputFraction;
+    static const double EventsPerMbBudget;
+    static const uint32_t StateBudget;
+    static const double UtilizationTolerance;
+    static const double EventsTolerance;
+    static const double StateTolerance;
+private:
+    virtual void DoRun (void);
+    Ptr<Node> CreateInternetNode (void);
+    Ptr<SimpleNetDevice> AddSimpleNetDevice (Ptr<Node> node, const char* ipaddr, const char* netmask);
+    void ServerHandleRecv (Ptr<Socket> sock);
+    void ClientHandleRecv (Ptr<Socket> sock);
+    void CountPacket (const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface);
+    void SampleState (void);
+    void RequestData (uint32_t size);
+    static std::string Name (std::string rate, Time delay, double loss);
+    /**
+     * \brief Имя файла базовых значений опыта
+     */
+    std::string BaselineName (void) const;
+
+    std::string m_rateName;
+    DataRate m_rate;
+    Time m_delay;
+    double m_loss;
+    Ptr<Socket> m_server;
+    Ptr<Socket> m_client;
+    uint64_t m_clientRx;
+    uint64_t m_packets;
+    uint32_t m_peakState;
+};
+
+const double TricklesPerformanceTestCase::GoodputFraction = 0.5;
+const double TricklesPerformanceTestCase::EventsPerMbBudget = 6000;
+const uint32_t TricklesPerformanceTestCase::StateBudget = 256*1024;
+const double TricklesPerformanceTestCase::UtilizationTolerance = 0.05;
+const double TricklesPerformanceTestCase::EventsTolerance = 0.1;
+const double TricklesPerformanceTestCase::StateTolerance = 0.25;
+
+TricklesPerformanceTestCase::TricklesPerformanceTestCase (std::string rate, Time delay, double loss)
+: TestCase (Name (rate, delay, loss)),
+m_rateName (rate),
+m_rate (rate),
+m_delay (delay),
+m_loss (loss),
+m_clientRx (0),
+m_packets (0),
+m_peakState (0)
+{
+}
+
+std::string
+TricklesPerformanceTestCase::Name (std::string rate, Time delay, double loss)
+{
+    std::ostringstream oss;
+    oss << "Trickles transfer " << rate << ", one-way delay " << delay.GetMilliSeconds () << "ms, loss " << loss;
+    return oss.str ();
+}
+
+std::string
+TricklesPerformanceTestCase::BaselineName (void) const
+{
+    std::ostringstream oss;
+    oss << "trickles-performance-" << m_rateName << "-" << m_delay.GetMilliSeconds () << "ms-" << m_loss << ".txt";
+    return oss.str ();
+}
+
+Ptr<Node>
+TricklesPerformanceTestCase::CreateInternetNode ()
+{
+    Ptr<Node> node = CreateObject<Node> ();
+    //ARP
+    Ptr<ArpL3Protocol> arp = CreateObject<ArpL3Protocol> ();
+    node->AggregateObject (arp);
+    //IPV4
+    Ptr<Ipv4L3Protocol> ipv4 = CreateObject<Ipv4L3Protocol> ();
+    //Routing for Ipv4
+    Ptr<Ipv4ListRouting> ipv4Routing = CreateObject<Ipv4ListRouting> ();
+    ipv4->SetRoutingProtocol (ipv4Routing);
+    Ptr<Ipv4StaticRouting> ipv4staticRouting = CreateObject<Ipv4StaticRouting> ();
+    ipv4Routing->AddRoutingProtocol (ipv4staticRouting, 0);
+    node->AggregateObject (ipv4);
+    //ICMP
+    Ptr<Icmpv4L4Protocol> icmp = CreateObject<Icmpv4L4Protocol> ();
+    node->AggregateObject (icmp);
+    //Trickles
+    Ptr<TricklesL4Protocol> trickles = CreateObject<TricklesL4Protocol> ();
+    node->AggregateObject (trickles);
+    return node;
+}
+
+Ptr<SimpleNetDevice>
+TricklesPerformanceTestCase::AddSimpleNetDevice (Ptr<Node> node, const char* ipaddr, const char* netmask)
+{
+    Ptr<SimpleNetDevice> dev = CreateObject<SimpleNetDevice> ();
+    dev->SetAddress (Mac48Address::ConvertFrom (Mac48Address::Allocate ()));
+    dev->SetAttribute ("DataRate", DataRateValue (m_rate));
+    node->AddDevice (dev);
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    uint32_t ndid = ipv4->AddInterface (dev);
+    Ipv4InterfaceAddress ipv4Addr = Ipv4InterfaceAddress (Ipv4Address (ipaddr), Ipv4Mask (netmask));
+    ipv4->AddAddress (ndid, ipv4Addr);
+    ipv4->SetUp (ndid);
+    ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&TricklesPerformanceTestCase::CountPacket, this));
+    ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeCallback (&TricklesPerformanceTestCase::CountPacket, this));
+    return dev;
+}
+
+void
+TricklesPerformanceTestCase::ServerHandleRecv (Ptr<Socket> sock)
+{
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = sock->RecvFrom (from)))
+    {
+        TricklesHeader tricklesHeader;
+        if (!packet->PeekHeader (tricklesHeader)) continue;
+        if (tricklesHeader.GetPacketType () == CONTINUATION) {
+            packet->AddAtEnd (Create<Packet> (tricklesHeader.GetRequestSize ()));
+            sock->SendTo (packet, 0, from);
+        }
+    }
+}
+
+void
+TricklesPerformanceTestCase::ClientHandleRecv (Ptr<Socket> sock)
+{
+    Ptr<Packet> packet;
+    Address from;
+    while ((sock->GetRxAvailable () > 0) && (packet = sock->RecvFrom (from)))
+    {
+        m_clientRx += packet->GetSize ();
+    }
+}
+
+void
+TricklesPerformanceTestCase::CountPacket (const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface)
+{
+    m_packets++;
+}
+
+void
+TricklesPerformanceTestCase::RequestData (uint32_t size)
+{
+    m_client->Recv (size, TricklesSocketBase::QUEUE_RECV);
+}
+
+void
+TricklesPerformanceTestCase::SampleState (void)
+{
+    uint32_t state = DynamicCast<TricklesSocketBase> (m_server)->GetStateSize ()+DynamicCast<TricklesSocketBase> (m_client)->GetStateSize ();
+    if (state > m_peakState) m_peakState = state;
+    Simulator::Schedule (MilliSeconds (10), &TricklesPerformanceTestCase::SampleState, this);
+}
+
+void
+TricklesPerformanceTestCase::DoRun (void)
+{
+    const char* netmask = "255.255.255.0";
+    const char* ipaddr0 = "192.168.1.1";
+    const char* ipaddr1 = "192.168.1.2";
+    const uint32_t segment = 1000;
+    const double start = 1.0;
+    const double duration = 60.0;
+    Config::SetDefault ("ns3::TricklesL4Protocol::SocketType", StringValue ("ns3::TricklesShieh"));
+    Config::SetDefault ("ns3::TricklesSocket::SegmentSize", UintegerValue (segment));
+
+    Ptr<Node> node0 = CreateInternetNode ();
+    Ptr<Node> node1 = CreateInternetNode ();
+    Ptr<SimpleNetDevice> dev0 = AddSimpleNetDevice (node0, ipaddr0, netmask);
+    Ptr<SimpleNetDevice> dev1 = AddSimpleNetDevice (node1, ipaddr1, netmask);
+
+    Ptr<SimpleChannel> channel = CreateObject<SimpleChannel> ();
+    channel->SetAttribute ("Delay", TimeValue (m_delay));
+    dev0->SetChannel (channel);
+    dev1->SetChannel (channel);
+
+    // Очередь сервера - один BDP, но не меньше 10 пакетов
+    uint32_t bdp = m_rate.GetBitRate ()*2*m_delay.GetSeconds ()/(8*segment);
+    PointerValue queue;
+    dev0->GetAttribute ("TxQueue", queue);
+    queue.Get<Queue> ()->SetAttribute ("MaxPackets", UintegerValue (std::max<uint32_t> (bdp, 10)));
+
+    if (m_loss > 0) {
+        Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
+        em->SetAttribute ("ErrorUnit", StringValue ("ERROR_UNIT_PACKET"));
+        em->SetAttribute ("ErrorRate", DoubleValue (m_loss));
+        em->AssignStreams (1);
+        dev1->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+    }
+
+    Ptr<SocketFactory> sockFactory0 = node0->GetObject<TricklesSocketFactory> ();
+    Ptr<SocketFactory> sockFactory1 = node1->GetObject<TricklesSocketFactory> ();
+    m_server = sockFactory0->CreateSocket ();
+    m_client = sockFactory1->CreateSocket ();
+
+    uint16_t port = 50000;
+    m_server->Bind (InetSocketAddress (Ipv4Address::GetAny (), port));
+    m_server->Listen ();
+    m_server->SetRecvCallback (MakeCallback (&TricklesPerformanceTestCase::ServerHandleRecv, this));
+    m_client->SetRecvCallback (MakeCallback (&TricklesPerformanceTestCase::ClientHandleRecv, this));
+    m_client->Connect (InetSocketAddress (Ipv4Address (ipaddr0), port));
+
+    // Запрос заведомо больше, чем канал передаст за время опыта
+    uint64_t request = std::min<uint64_t> (m_rate.GetBitRate ()/8*duration*2, 0xffff0000);
+    Simulator::Schedule (Seconds (start), &TricklesPerformanceTestCase::RequestData, this, (uint32_t)request);
+    Simulator::Schedule (Seconds (start), &TricklesPerformanceTestCase::SampleState, this);
+    Simulator::Stop (Seconds (start+duration));
+    Simulator::Run ();
+
+    m_server = 0;
+    m_client = 0;
+    Simulator::Destroy ();
+
+    double utilization = m_clientRx*8.0/(m_rate.GetBitRate ()*duration);
+    double megabytes = m_clientRx/1e6;
+    NS_TEST_ASSERT_MSG_GT (m_clientRx, 0, "No data delivered");
+    double eventsPerMb = m_packets/megabytes;
+    NS_LOG_INFO (GetName () << ": utilization " << utilization << ", events/MB " << eventsPerMb << ", peak state " << m_peakState);
+
+    // С --update-data файл попадает в каталог данных и становится базовым
+    std::ofstream measured (CreateTempDirFilename (BaselineName ()).c_str ());
+    measured.precision (9);
+    measured << utilization << " " << eventsPerMb << " " << m_peakState << std::endl;
+    measured.close ();
+
+    // Ожидаемая доля канала: при потерях окно ограничено оценкой Мэтиса, RTT - с полной очередью
+    double expected = 1.0;
+    if (m_loss > 0) {
+        double rtt = 4*m_delay.GetSeconds ();
+        expected = std::min (1.0, 1.22*segment*8/(rtt*std::sqrt (m_loss))/m_rate.GetBitRate ());
+    }
+    NS_TEST_ASSERT_MSG_GT (utilization, expected*GoodputFraction, "Goodput " << utilization*100 << "% of the link is below the budget " << expected*GoodputFraction*100 << "%");
+    NS_TEST_ASSERT_MSG_LT (eventsPerMb, EventsPerMbBudget, "Packet events per delivered MB " << eventsPerMb << " are over the budget " << EventsPerMbBudget);
+    NS_TEST_ASSERT_MSG_LT (m_peakState, StateBudget, "Peak socket state " << m_peakState << " is over the budget " << StateBudget);
+
+    std::ifstream baseline (CreateDataDirFilename (BaselineName ()).c_str ());
+    double baseUtilization = 0, baseEventsPerMb = 0;
+    uint32_t basePeakState = 0;
+    baseline >> baseUtilization >> baseEventsPerMb >> basePeakState;
+    if (!baseline) {
+        NS_LOG_INFO (GetName () << ": no baseline " << BaselineName () << ", only the budgets are checked");
+        return;
+    }
+    NS_TEST_ASSERT_MSG_GT (utilization, baseUtilization*(1-UtilizationTolerance), "Goodput " << utilization*100 << "% of the link is below the baseline " << baseUtilization*100 << "%");
+    NS_TEST_ASSERT_MSG_LT (eventsPerMb, baseEventsPerMb*(1+EventsTolerance), "Packet events per delivered MB " << eventsPerMb << " are over the baseline " << baseEventsPerMb);
+    NS_TEST_ASSERT_MSG_LT (m_peakState, basePeakState*(1+StateTolerance), "Peak socket state " << m_peakState << " is over the baseline " << basePeakState);
+}
+
+static class TricklesPerformanceTestSuite : public TestSuite
+{
+public:
+    TricklesPerformanceTestSuite ()
+    : TestSuite ("trickles-performance", SYSTEM)
+    {
+        // Необязательные базовые значения лежат рядом с исходным текстом набора
+        SetDataDir (NS_TEST_SOURCEDIR);
+        const char *rates[] = { "1Mbps", "10Mbps" };
+        const uint32_t delays[] = { 10, 100 };
+        const double losses[] = { 0, 0.001, 0.01 };
+        for (uint32_t r = 0; r < 2; r++) {
+            for (uint32_t d = 0; d < 2; d++) {
+                for (uint32_t l = 0; l < 3; l++) {
+                    AddTestCase (new TricklesPerformanceTestCase (rates[r], MilliSeconds (delays[d]), losses[l]), TestCase::EXTENSIVE);
+                }
+            }
+        }
+    }
+
+} g_tricklesPerformanceTestSuite;
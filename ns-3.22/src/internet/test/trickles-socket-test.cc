@@ -0,0 +1,923 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/simple-channel.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/node.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/type-id.h"
+#include "ns3/socket-factory.h"
+#include "ns3/inet-socket-address.h"
+
+#include "ns3/arp-l3-protocol.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/icmpv4-l4-protocol.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/ipv4-static-routing.h"
+#include "ns3/tcp-header.h"
+#include "ns3/trickles-l4-protocol.h"
+#include "ns3/trickles-socket-factory.h"
+#include "ns3/trickles-header.h"
+#include "ns3/trickles-shieh-header.h"
+#include "ns3/trickles-shieh.h"
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <vector>
+
+NS_LOG_COMPONENT_DEFINE ("TricklesSocketTestSuite");
+
+using namespace ns3;
+
+#define NS_TEST_ASSERT_EQUAL(a,b) NS_TEST_ASSERT_MSG_EQ (a,b, "foo")
+#define NS_TEST_ASSERT(a) NS_TEST_ASSERT_MSG_EQ (bool(a), true, "foo")
+
+/*
+ * A server and several clients on one simple channel. The server echoes every
+ * continuation with RequestSize bytes of data after ServerDelay, the clients
+ * request segments of 1000 bytes and drain what they receive. Subclasses see the Trickles headers every client
+ * sends and receives.
+ */
+class TricklesSocketTestCase : public TestCase
+{
+public:
+    TricklesSocketTestCase (std::string name);
+protected:
+    /**
+     * Node 0 (10.1.1.1) is the server, clients are 10.1.1.2 and on
+     */
+    void SetupNetwork (uint32_t clients, TypeId clientType);
+    Ptr<Socket> CreateServer (uint16_t port, uint32_t node = 0);
+    /**
+     * The client is bound to localPort if it is not 0
+     */
+    Ptr<Socket> CreateClient (uint32_t client, uint16_t port, uint16_t localPort = 0);
+    /**
+     * Queue a request for bytes of data from the server
+     */
+    void Fetch (Ptr<Socket> sock, uint32_t bytes);
+    Ipv4Address GetAddress (uint32_t node) const;
+    virtual void ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    virtual void ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    virtual void DoTeardown (void);
+    std::vector<Ptr<Node> > m_nodes;
+    std::vector<uint64_t> m_clientRx;
+    Time m_serverDelay;
+    /**
+     * Destination of the packet ClientTx is called for
+     */
+    Ipv4Address m_txTo;
+private:
+    Ptr<Node> CreateInternetNode (TypeId socketType);
+    void AddSimpleNetDevice (Ptr<Node> node, Ipv4Address addr);
+    void ServerHandleRecv (Ptr<Socket> sock);
+    void ServerSend (Ptr<Socket> sock, Ptr<Packet> p, Address from);
+    void ClientHandleRecv (Ptr<Socket> sock);
+    void RxTrace (std::string context, const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface);
+    void TxTrace (std::string context, const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface);
+    Ptr<SimpleChannel> m_channel;
+    std::map<Ptr<Socket>, uint32_t> m_clients;
+};
+
+TricklesSocketTestCase::TricklesSocketTestCase (std::string name)
+: TestCase (name),
+m_serverDelay (MilliSeconds (5))
+{
+}
+
+void
+TricklesSocketTestCase::DoTeardown (void)
+{
+    m_nodes.clear ();
+    m_clients.clear ();
+    m_channel = 0;
+    Simulator::Destroy ();
+}
+
+Ipv4Address
+TricklesSocketTestCase::GetAddress (uint32_t node) const
+{
+    return (Ipv4Address (Ipv4Address ("10.1.1.1").Get () + node));
+}
+
+Ptr<Node>
+TricklesSocketTestCase::CreateInternetNode (TypeId socketType)
+{
+    Ptr<Node> node = CreateObject<Node> ();
+    //ARP
+    Ptr<ArpL3Protocol> arp = CreateObject<ArpL3Protocol> ();
+    node->AggregateObject (arp);
+    //IPV4
+    Ptr<Ipv4L3Protocol> ipv4 = CreateObject<Ipv4L3Protocol> ();
+    //Routing for Ipv4
+    Ptr<Ipv4ListRouting> ipv4Routing = CreateObject<Ipv4ListRouting> ();
+    ipv4->SetRoutingProtocol (ipv4Routing);
+    Ptr<Ipv4StaticRouting> ipv4staticRouting = CreateObject<Ipv4StaticRouting> ();
+    ipv4Routing->AddRoutingProtocol (ipv4staticRouting, 0);
+    node->AggregateObject (ipv4);
+    //ICMP
+    Ptr<Icmpv4L4Protocol> icmp = CreateObject<Icmpv4L4Protocol> ();
+    node->AggregateObject (icmp);
+    //UDP
+    Ptr<UdpL4Protocol> udp = CreateObject<UdpL4Protocol> ();
+    node->AggregateObject (udp);
+    //Trickles
+    Ptr<TricklesL4Protocol> trickles = CreateObject<TricklesL4Protocol> ();
+    trickles->SetAttribute ("SocketType", TypeIdValue (socketType));
+    node->AggregateObject (trickles);
+    return node;
+}
+
+void
+TricklesSocketTestCase::AddSimpleNetDevice (Ptr<Node> node, Ipv4Address addr)
+{
+    Ptr<SimpleNetDevice> dev = CreateObject<SimpleNetDevice> ();
+    dev->SetAddress (Mac48Address::ConvertFrom (Mac48Address::Allocate ()));
+    dev->SetChannel (m_channel);
+    node->AddDevice (dev);
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+    uint32_t ndid = ipv4->AddInterface (dev);
+    ipv4->AddAddress (ndid, Ipv4InterfaceAddress (addr, Ipv4Mask ("255.255.255.0")));
+    ipv4->SetUp (ndid);
+}
+
+void
+TricklesSocketTestCase::SetupNetwork (uint32_t clients, TypeId clientType)
+{
+    m_channel = CreateObject<SimpleChannel> ();
+    for (uint32_t i = 0; i<=clients; i++) {
+        Ptr<Node> node = CreateInternetNode (i?clientType:TricklesShieh::GetTypeId ());
+        AddSimpleNetDevice (node, GetAddress (i));
+        if (i) {
+            // The context of the traces is the number of the client
+            std::ostringstream oss;
+            oss << i;
+            Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+            ipv4->TraceConnect ("LocalDeliver", oss.str (), MakeCallback (&TricklesSocketTestCase::RxTrace, this));
+            ipv4->TraceConnect ("SendOutgoing", oss.str (), MakeCallback (&TricklesSocketTestCase::TxTrace, this));
+        }
+        m_nodes.push_back (node);
+    }
+    m_clientRx.assign (clients+1, 0);
+}
+
+Ptr<Socket>
+TricklesSocketTestCase::CreateServer (uint16_t port, uint32_t node)
+{
+    Ptr<Socket> sock = m_nodes[node]->GetObject<TricklesSocketFactory> ()->CreateSocket ();
+    sock->Bind (InetSocketAddress (Ipv4Address::GetAny (), port));
+    sock->Listen ();
+    sock->SetRecvCallback (MakeCallback (&TricklesSocketTestCase::ServerHandleRecv, this));
+    return (sock);
+}
+
+Ptr<Socket>
+TricklesSocketTestCase::CreateClient (uint32_t client, uint16_t port, uint16_t localPort)
+{
+    Ptr<Socket> sock = m_nodes[client]->GetObject<TricklesSocketFactory> ()->CreateSocket ();
+    sock->SetAttribute ("SegmentSize", UintegerValue (1000));
+    if (localPort) sock->Bind (InetSocketAddress (Ipv4Address::GetAny (), localPort));
+    sock->SetRecvCallback (MakeCallback (&TricklesSocketTestCase::ClientHandleRecv, this));
+    sock->Connect (InetSocketAddress (GetAddress (0), port));
+    m_clients[sock] = client;
+    return (sock);
+}
+
+void
+TricklesSocketTestCase::Fetch (Ptr<Socket> sock, uint32_t bytes)
+{
+    sock->Recv (bytes, TricklesSocketBase::QUEUE_RECV);
+}
+
+void
+TricklesSocketTestCase::ServerHandleRecv (Ptr<Socket> sock)
+{
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = sock->RecvFrom (from)))
+    {
+        if (packet->GetSize () == 0) break;
+        TricklesHeader th;
+        if (!packet->PeekHeader (th)) continue;
+        if (th.GetPacketType () == CONTINUATION) {
+            packet->AddAtEnd (Create<Packet> (th.GetRequestSize ()));
+            Simulator::Schedule (m_serverDelay, &TricklesSocketTestCase::ServerSend, this, sock, packet, from);
+        }
+    }
+}
+
+void
+TricklesSocketTestCase::ServerSend (Ptr<Socket> sock, Ptr<Packet> p, Address from)
+{
+    sock->SendTo (p, 0, from);
+}
+
+void
+TricklesSocketTestCase::ClientHandleRecv (Ptr<Socket> sock)
+{
+    uint32_t client = m_clients[sock];
+    Ptr<Packet> packet;
+    Address from;
+    while (sock->GetRxAvailable ()>0)
+    {
+        packet = sock->RecvFrom (from);
+        if ((packet == 0) || (packet->GetSize () == 0)) break;
+        m_clientRx[client] += packet->GetSize ();
+    }
+}
+
+void
+TricklesSocketTestCase::RxTrace (std::string context, const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface)
+{
+    Ptr<Packet> cp = p->Copy ();
+    TcpHeader tcp;
+    TricklesHeader th;
+    TricklesShiehHeader tsh;
+    if (!cp->RemoveHeader (tcp) || !cp->RemoveHeader (th) || !cp->RemoveHeader (tsh)) return;
+    ClientRx (atoi (context.c_str ()), th, tsh);
+}
+
+void
+TricklesSocketTestCase::TxTrace (std::string context, const Ipv4Header &h, Ptr<const Packet> p, uint32_t iface)
+{
+    Ptr<Packet> cp = p->Copy ();
+    TcpHeader tcp;
+    TricklesHeader th;
+    TricklesShiehHeader tsh;
+    if (!cp->RemoveHeader (tcp) || !cp->RemoveHeader (th) || !cp->RemoveHeader (tsh)) return;
+    m_txTo = h.GetDestination ();
+    ClientTx (atoi (context.c_str ()), th, tsh);
+}
+
+void
+TricklesSocketTestCase::ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+}
+
+void
+TricklesSocketTestCase::ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+}
+
+/*
+ * Client socket that sees a CE mark on one continuation. ns-3.22 has no
+ * queue that marks CE, so the mark is injected where the socket reads it
+ * from the IP header.
+ */
+class TricklesCeProbe : public TricklesShieh
+{
+public:
+    static TypeId GetTypeId (void);
+    TricklesCeProbe () : m_continuations (0) {}
+    /**
+     * Number of the continuation (counting from 1) that arrives marked, 0 - none
+     */
+    static uint32_t s_markAt;
+protected:
+    virtual void DoForwardUp (Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port, bool ce)
+    {
+        m_continuations++;
+        TricklesShieh::DoForwardUp (packet, fromAddress, toAddress, port, ce || (m_continuations==s_markAt));
+    }
+private:
+    uint32_t m_continuations;
+};
+
+uint32_t TricklesCeProbe::s_markAt = 0;
+
+NS_OBJECT_ENSURE_REGISTERED (TricklesCeProbe);
+
+TypeId
+TricklesCeProbe::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::TricklesCeProbe")
+    .SetParent<TricklesShieh> ()
+    .AddConstructor<TricklesCeProbe> ()
+    ;
+    return tid;
+}
+
+/*
+ * A CE mark on a continuation becomes an ECN-Echo in a request, and a server
+ * with Ecn answers it with a gradual window reduction (OPT_DRAIN)
+ */
+class TricklesEcnTest : public TricklesSocketTestCase
+{
+public:
+    TricklesEcnTest (uint32_t markAt, bool serverEcn);
+private:
+    virtual void DoRun (void);
+    virtual void ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    virtual void ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    uint32_t m_markAt;
+    bool m_serverEcn;
+    uint32_t m_eceSent;
+    uint32_t m_drainSeen;
+};
+
+static std::string
+EcnTestName (uint32_t markAt, bool serverEcn)
+{
+    std::ostringstream oss;
+    oss << "Trickles ECN: CE on continuation " << markAt << ", server Ecn " << serverEcn;
+    return oss.str ();
+}
+
+TricklesEcnTest::TricklesEcnTest (uint32_t markAt, bool serverEcn)
+: TricklesSocketTestCase (EcnTestName (markAt, serverEcn)),
+m_markAt (markAt),
+m_serverEcn (serverEcn),
+m_eceSent (0),
+m_drainSeen (0)
+{
+}
+
+void
+TricklesEcnTest::ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    if (tsh.HasOption (TricklesShiehHeader::OPT_DRAIN)) m_drainSeen++;
+}
+
+void
+TricklesEcnTest::ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    if (th.GetEce ()) m_eceSent++;
+}
+
+void
+TricklesEcnTest::DoRun (void)
+{
+    TricklesCeProbe::s_markAt = m_markAt;
+    SetupNetwork (1, TricklesCeProbe::GetTypeId ());
+    Ptr<Socket> server = CreateServer (50000);
+    server->SetAttribute ("Ecn", BooleanValue (m_serverEcn));
+    Ptr<Socket> client = CreateClient (1, 50000);
+    Simulator::Schedule (Seconds (1), &TricklesEcnTest::Fetch, this, client, 2000000);
+    Simulator::Stop (Seconds (5));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_MSG_EQ ((m_clientRx[1]>0), true, "No data was received");
+    if (!m_markAt) {
+        NS_TEST_ASSERT_MSG_EQ (m_eceSent, 0, "ECN-Echo without a CE mark");
+        NS_TEST_ASSERT_MSG_EQ (m_drainSeen, 0, "Window reduction without a CE mark");
+        return;
+    }
+    // Every continuation of the epoch after the mark carries the echo until the server reacts
+    NS_TEST_ASSERT_MSG_EQ ((m_eceSent>=1), true, "The CE mark was not echoed");
+    if (m_serverEcn) {
+        NS_TEST_ASSERT_MSG_EQ ((m_drainSeen>0), true, "The server did not reduce the window");
+    } else {
+        NS_TEST_ASSERT_MSG_EQ (m_drainSeen, 0, "A server without Ecn reduced the window");
+    }
+}
+
+/*
+ * With PathCache a second connection to the same host starts with the window
+ * the first one reached, the StartCwnd attribute stays as configured
+ */
+class TricklesPathCacheTest : public TricklesSocketTestCase
+{
+public:
+    TricklesPathCacheTest (bool cache);
+private:
+    virtual void DoRun (void);
+    virtual void ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    bool m_cache;
+    uint32_t m_burst;
+};
+
+TricklesPathCacheTest::TricklesPathCacheTest (bool cache)
+: TricklesSocketTestCase (cache?"Trickles path cache seeds a new connection":"Trickles path cache is off by default"),
+m_cache (cache),
+m_burst (0)
+{
+}
+
+void
+TricklesPathCacheTest::ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    // The first connection is idle by then, the requests are the initial window of the second one
+    if (Simulator::Now () == Seconds (3)) m_burst++;
+}
+
+void
+TricklesPathCacheTest::DoRun (void)
+{
+    SetupNetwork (1, TricklesShieh::GetTypeId ());
+    Ptr<TricklesL4Protocol> trickles = m_nodes[1]->GetObject<TricklesL4Protocol> ();
+    BooleanValue enabled;
+    trickles->GetAttribute ("PathCache", enabled);
+    NS_TEST_ASSERT_MSG_EQ (enabled.Get (), false, "The path cache is opt-in");
+    if (m_cache) {
+        trickles->SetAttribute ("PathCache", BooleanValue (true));
+        trickles->SetAttribute ("PathCacheHalfLife", TimeValue (Time (0)));
+    }
+    CreateServer (50000);
+    Ptr<Socket> first = CreateClient (1, 50000);
+    Ptr<Socket> second = CreateClient (1, 50000);
+    Simulator::Schedule (Seconds (1), &TricklesPathCacheTest::Fetch, this, first, 500000);
+    Simulator::Schedule (Seconds (3), &TricklesPathCacheTest::Fetch, this, second, 500000);
+    Simulator::Stop (Seconds (5));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_MSG_EQ ((m_clientRx[1]>=1000000), true, "Both transfers complete");
+    UintegerValue cwnd;
+    first->GetAttribute ("StartCwnd", cwnd);
+    NS_TEST_ASSERT_MSG_EQ (cwnd.Get (), 2, "The window of a connection does not change StartCwnd");
+    second->GetAttribute ("StartCwnd", cwnd);
+    NS_TEST_ASSERT_MSG_EQ (cwnd.Get (), 2, "Seeding does not change StartCwnd");
+    if (m_cache) {
+        NS_TEST_ASSERT_MSG_EQ ((m_burst>2), true, "The second connection starts with the cached window");
+    } else {
+        NS_TEST_ASSERT_MSG_EQ (m_burst, 2, "Without the cache the connection starts with StartCwnd");
+    }
+}
+
+/*
+ * Every request debits the budget queued by Recv(QUEUE_RECV) exactly once:
+ * the client receives what it asked for, no less and no more
+ */
+class TricklesRequestBudgetTest : public TricklesSocketTestCase
+{
+public:
+    TricklesRequestBudgetTest ();
+private:
+    virtual void DoRun (void);
+    virtual void ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    void Checkpoint (void);
+    uint32_t m_requested;
+    uint64_t m_rxAtCheckpoint;
+};
+
+TricklesRequestBudgetTest::TricklesRequestBudgetTest ()
+: TricklesSocketTestCase ("Trickles request budget is debited once per request"),
+m_requested (0),
+m_rxAtCheckpoint (0)
+{
+}
+
+void
+TricklesRequestBudgetTest::ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    m_requested += th.GetRequestSize ();
+}
+
+void
+TricklesRequestBudgetTest::Checkpoint (void)
+{
+    m_rxAtCheckpoint = m_clientRx[1];
+}
+
+void
+TricklesRequestBudgetTest::DoRun (void)
+{
+    SetupNetwork (1, TricklesShieh::GetTypeId ());
+    CreateServer (50000);
+    Ptr<Socket> client = CreateClient (1, 50000);
+    Simulator::Schedule (Seconds (1), &TricklesRequestBudgetTest::Fetch, this, client, 100000);
+    Simulator::Schedule (Seconds (2.9), &TricklesRequestBudgetTest::Checkpoint, this);
+    Simulator::Schedule (Seconds (3), &TricklesRequestBudgetTest::Fetch, this, client, 50000);
+    Simulator::Stop (Seconds (5));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_MSG_EQ (m_rxAtCheckpoint, 100000, "The first fetch is delivered in full");
+    NS_TEST_ASSERT_MSG_EQ (m_clientRx[1], 150000, "The second fetch adds exactly its size");
+    NS_TEST_ASSERT_MSG_EQ (m_requested, 150000, "Requests ask for the queued budget and nothing more");
+}
+
+/*
+ * Client socket that loses one continuation after the IP layer delivered it
+ */
+class TricklesDropProbe : public TricklesShieh
+{
+public:
+    static TypeId GetTypeId (void);
+    TricklesDropProbe () : m_continuations (0) {}
+    /**
+     * Number of the continuation (counting from 1) that is lost, 0 - none
+     */
+    static uint32_t s_dropAt;
+protected:
+    virtual void DoForwardUp (Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port, bool ce)
+    {
+        if (++m_continuations == s_dropAt) return;
+        TricklesShieh::DoForwardUp (packet, fromAddress, toAddress, port, ce);
+    }
+private:
+    uint32_t m_continuations;
+};
+
+uint32_t TricklesDropProbe::s_dropAt = 0;
+
+NS_OBJECT_ENSURE_REGISTERED (TricklesDropProbe);
+
+TypeId
+TricklesDropProbe::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::TricklesDropProbe")
+    .SetParent<TricklesShieh> ()
+    .AddConstructor<TricklesDropProbe> ()
+    ;
+    return tid;
+}
+
+/*
+ * RequestRange: every range is delivered once, completions are reported in
+ * order, a chunk whose continuation was lost is requested again
+ */
+class TricklesFetchTest : public TricklesSocketTestCase
+{
+public:
+    TricklesFetchTest (uint32_t dropAt);
+private:
+    virtual void DoRun (void);
+    virtual void ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    virtual void ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    void StartFetches (Ptr<Socket> sock);
+    void FetchDone (Ptr<Socket> sock, uint32_t objectId, uint64_t offset, uint64_t length);
+    void ObjectData (Ptr<Socket> sock, uint32_t objectId, uint64_t offset, Ptr<const Packet> data);
+    uint32_t m_dropAt;
+    uint32_t m_continuations;
+    /**
+     * Object offset of the lost continuation and how often it was requested
+     */
+    uint64_t m_lostOffset;
+    uint32_t m_lostRequests;
+    std::vector<uint32_t> m_done;
+    std::map<uint32_t, uint64_t> m_objectBytes;
+    std::map<uint64_t, uint32_t> m_deliveries;
+};
+
+TricklesFetchTest::TricklesFetchTest (uint32_t dropAt)
+: TricklesSocketTestCase (dropAt?"Trickles RequestRange requests a lost chunk again":"Trickles RequestRange completion"),
+m_dropAt (dropAt),
+m_continuations (0),
+m_lostOffset (0),
+m_lostRequests (0)
+{
+}
+
+void
+TricklesFetchTest::ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    if (++m_continuations == m_dropAt) m_lostOffset = th.GetObjectOffset ();
+}
+
+void
+TricklesFetchTest::ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    if (m_dropAt && (m_continuations>=m_dropAt) && th.HasObject () && (th.GetObjectOffset () == m_lostOffset)) m_lostRequests++;
+}
+
+void
+TricklesFetchTest::StartFetches (Ptr<Socket> sock)
+{
+    Ptr<TricklesSocketBase> trickles = DynamicCast<TricklesSocketBase> (sock);
+    trickles->SetObjectDataCallback (MakeCallback (&TricklesFetchTest::ObjectData, this));
+    NS_TEST_EXPECT_MSG_EQ (trickles->RequestRange (7, 1000000, 0, MakeCallback (&TricklesFetchTest::FetchDone, this)), -1, "An empty range is refused");
+    trickles->RequestRange (7, 1000000, 60000, MakeCallback (&TricklesFetchTest::FetchDone, this));
+    trickles->RequestRange (8, 0, 20500, MakeCallback (&TricklesFetchTest::FetchDone, this));
+    NS_TEST_EXPECT_MSG_EQ (trickles->GetPendingFetches (), 2, "Both fetches are pending");
+}
+
+void
+TricklesFetchTest::FetchDone (Ptr<Socket> sock, uint32_t objectId, uint64_t offset, uint64_t length)
+{
+    m_done.push_back (objectId);
+    NS_TEST_EXPECT_MSG_EQ (m_objectBytes[objectId], length, "The callback fires once the whole range arrived");
+    NS_TEST_EXPECT_MSG_EQ (offset, (objectId == 7)?1000000:0, "The callback reports the range");
+}
+
+void
+TricklesFetchTest::ObjectData (Ptr<Socket> sock, uint32_t objectId, uint64_t offset, Ptr<const Packet> data)
+{
+    m_objectBytes[objectId] += data->GetSize ();
+    m_deliveries[(uint64_t (objectId)<<40)+offset]++;
+}
+
+void
+TricklesFetchTest::DoRun (void)
+{
+    TricklesDropProbe::s_dropAt = m_dropAt;
+    SetupNetwork (1, TricklesDropProbe::GetTypeId ());
+    CreateServer (50000);
+    Ptr<Socket> client = CreateClient (1, 50000);
+    Simulator::Schedule (Seconds (1), &TricklesFetchTest::StartFetches, this, client);
+    Simulator::Stop (Seconds (20));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_EQUAL (m_done.size (), 2);
+    NS_TEST_ASSERT_MSG_EQ (m_done[0], 7, "Fetches complete in call order");
+    NS_TEST_ASSERT_EQUAL (m_done[1], 8);
+    NS_TEST_ASSERT_EQUAL (m_objectBytes[7], 60000);
+    NS_TEST_ASSERT_EQUAL (m_objectBytes[8], 20500);
+    NS_TEST_ASSERT_EQUAL (DynamicCast<TricklesSocketBase> (client)->GetPendingFetches (), 0);
+    NS_TEST_ASSERT_MSG_EQ (m_clientRx[1], 0, "Object data bypasses the receive buffer");
+    for (std::map<uint64_t, uint32_t>::const_iterator i = m_deliveries.begin (); i != m_deliveries.end (); i++) {
+        NS_TEST_ASSERT_MSG_EQ (i->second, 1, "Every chunk is delivered once");
+    }
+    if (m_dropAt) {
+        NS_TEST_ASSERT_MSG_EQ ((m_lostRequests>=1), true, "The lost chunk was requested again");
+    }
+}
+
+/*
+ * Failover: a client waiting for data switches to the replica after
+ * FailoverRetries timeouts, an idle client stays with the dead server
+ */
+class TricklesFailoverTest : public TricklesSocketTestCase
+{
+public:
+    TricklesFailoverTest (bool busy);
+private:
+    virtual void DoRun (void);
+    void Fail (void);
+    void Failover (const Address &replica);
+    void RecoveryGap (Time gap);
+    virtual void ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    bool m_busy;
+    Time m_failAt;
+    std::vector<Time> m_failovers;
+    Address m_replica;
+    bool m_recovered;
+    uint32_t m_replicaRequests;
+    uint32_t m_staleRequests;
+    uint32_t m_staleTsecr;
+};
+
+TricklesFailoverTest::TricklesFailoverTest (bool busy)
+: TricklesSocketTestCase (busy?"Trickles client fails over to the replica":"Idle Trickles client does not fail over"),
+m_busy (busy),
+m_recovered (false),
+m_replicaRequests (0),
+m_staleRequests (0),
+m_staleTsecr (0)
+{
+}
+
+void
+TricklesFailoverTest::Fail (void)
+{
+    // The server stops receiving requests
+    Ptr<Ipv4> ipv4 = m_nodes[0]->GetObject<Ipv4> ();
+    ipv4->SetDown (ipv4->GetInterfaceForAddress (GetAddress (0)));
+    m_failAt = Simulator::Now ();
+}
+
+void
+TricklesFailoverTest::Failover (const Address &replica)
+{
+    m_failovers.push_back (Simulator::Now ());
+    m_replica = replica;
+}
+
+void
+TricklesFailoverTest::RecoveryGap (Time gap)
+{
+    m_recovered = true;
+}
+
+void
+TricklesFailoverTest::ClientTx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    if (m_failovers.empty () || (th.GetPacketType () != REQUEST)) return;
+    // Requests delayed before the failover still hold continuations of the old server
+    if (m_txTo == GetAddress (0)) {
+        if (Simulator::Now () > m_failovers[0]) m_staleRequests++;
+        return;
+    }
+    if (m_txTo != GetAddress (2)) return;
+    m_replicaRequests++;
+    // Until the replica answers the client has no timestamp of its clock
+    if (!m_recovered && (th.GetTSEcr () != SequenceNumber32 (0))) m_staleTsecr++;
+}
+
+void
+TricklesFailoverTest::DoRun (void)
+{
+    // Node 2 is the replica
+    SetupNetwork (2, TricklesShieh::GetTypeId ());
+    CreateServer (50000);
+    CreateServer (50000, 2);
+    Ptr<Socket> client = CreateClient (1, 50000);
+    client->SetAttribute ("MinRto", TimeValue (MilliSeconds (200)));
+    client->TraceConnectWithoutContext ("Failover", MakeCallback (&TricklesFailoverTest::Failover, this));
+    client->TraceConnectWithoutContext ("RecoveryGap", MakeCallback (&TricklesFailoverTest::RecoveryGap, this));
+    DynamicCast<TricklesSocketBase> (client)->AddReplica (InetSocketAddress (GetAddress (2), 50000));
+    uint32_t bytes = m_busy?2000000:20000;
+    Simulator::Schedule (Seconds (1), &TricklesFailoverTest::Fetch, this, client, bytes);
+    Simulator::Schedule (Seconds (m_busy?1.02:2), &TricklesFailoverTest::Fail, this);
+    Simulator::Stop (Seconds (10));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_MSG_EQ (m_clientRx[1], bytes, "The client receives everything it requested");
+    if (!m_busy) {
+        NS_TEST_ASSERT_MSG_EQ (m_failovers.size (), 0, "A client without outstanding requests keeps its server");
+        return;
+    }
+    UintegerValue retries;
+    client->GetAttribute ("FailoverRetries", retries);
+    NS_TEST_ASSERT_MSG_GT (retries.Get (), 1, "A single timeout does not switch servers by default");
+    NS_TEST_ASSERT_MSG_EQ (m_failovers.size (), 1, "The client switches to the replica once");
+    NS_TEST_ASSERT_MSG_EQ (InetSocketAddress::ConvertFrom (m_replica).GetIpv4 (), GetAddress (2), "The replica takes over");
+    NS_TEST_ASSERT_MSG_GT (m_failovers[0]-m_failAt, MilliSeconds (200)*(retries.Get ()-1), "Failover waits for FailoverRetries timeouts");
+    NS_TEST_ASSERT_MSG_GT (m_replicaRequests, 0, "Requests reach the replica");
+    NS_TEST_ASSERT_MSG_EQ (m_staleRequests, 0, "Delayed requests follow the client to the replica");
+    NS_TEST_ASSERT_MSG_EQ (m_staleTsecr, 0, "The replica does not get timestamps of the old server");
+}
+
+/*
+ * Client socket that loses every s_dropEvery-th continuation from s_dropFrom
+ */
+class TricklesPathDropProbe : public TricklesShieh
+{
+public:
+    static TypeId GetTypeId (void);
+    TricklesPathDropProbe () : m_continuations (0) {}
+    static Ipv4Address s_dropFrom;
+    static uint32_t s_dropEvery;
+protected:
+    virtual void DoForwardUp (Ptr<Packet> packet, Address fromAddress, Address toAddress, uint16_t port, bool ce)
+    {
+        if (s_dropEvery && (InetSocketAddress::ConvertFrom (fromAddress).GetIpv4 () == s_dropFrom) && (++m_continuations%s_dropEvery == 0)) return;
+        TricklesShieh::DoForwardUp (packet, fromAddress, toAddress, port, ce);
+    }
+private:
+    uint32_t m_continuations;
+};
+
+Ipv4Address TricklesPathDropProbe::s_dropFrom;
+uint32_t TricklesPathDropProbe::s_dropEvery = 0;
+
+NS_OBJECT_ENSURE_REGISTERED (TricklesPathDropProbe);
+
+TypeId
+TricklesPathDropProbe::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::TricklesPathDropProbe")
+    .SetParent<TricklesShieh> ()
+    .AddConstructor<TricklesPathDropProbe> ()
+    ;
+    return tid;
+}
+
+/*
+ * Multipath: requests are spread by the path weights, a path that loses
+ * continuations gets a higher loss estimate and a smaller share of requests
+ */
+class TricklesMultipathTest : public TricklesSocketTestCase
+{
+public:
+    TricklesMultipathTest (uint32_t dropEvery);
+private:
+    virtual void DoRun (void);
+    uint32_t m_dropEvery;
+};
+
+TricklesMultipathTest::TricklesMultipathTest (uint32_t dropEvery)
+: TricklesSocketTestCase (dropEvery?"Trickles multipath moves requests off a lossy path":"Trickles multipath balances equal paths"),
+m_dropEvery (dropEvery)
+{
+}
+
+void
+TricklesMultipathTest::DoRun (void)
+{
+    // Path 0 is the server, path 1 is node 2
+    TricklesPathDropProbe::s_dropFrom = GetAddress (2);
+    TricklesPathDropProbe::s_dropEvery = m_dropEvery;
+    SetupNetwork (2, TricklesPathDropProbe::GetTypeId ());
+    CreateServer (50000);
+    CreateServer (50000, 2);
+    Ptr<Socket> client = CreateClient (1, 50000);
+    Ptr<TricklesSocketBase> trickles = DynamicCast<TricklesSocketBase> (client);
+    NS_TEST_ASSERT_EQUAL (trickles->AddPath (InetSocketAddress (GetAddress (2), 50000)), 0);
+    NS_TEST_ASSERT_EQUAL (trickles->GetNPaths (), 2);
+    NS_TEST_ASSERT_MSG_EQ_TOL (trickles->GetPathWeight (0), 0.5, 1e-9, "Paths without samples share requests equally");
+    NS_TEST_ASSERT_MSG_EQ_TOL (trickles->GetPathWeight (1), 0.5, 1e-9, "Paths without samples share requests equally");
+    Simulator::Schedule (Seconds (1), &TricklesMultipathTest::Fetch, this, client, 5000000);
+    Simulator::Stop (Seconds (20));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_MSG_EQ (m_clientRx[1], 5000000, "The client receives everything it requested");
+    NS_TEST_ASSERT_MSG_EQ_TOL (trickles->GetPathWeight (0)+trickles->GetPathWeight (1), 1.0, 1e-9, "Weights are normalized");
+    double sent0 = trickles->GetPathSent (0);
+    double sent1 = trickles->GetPathSent (1);
+    NS_TEST_ASSERT_MSG_GT (trickles->GetPathReceived (1), 0, "Both paths carry continuations");
+    if (!m_dropEvery) {
+        NS_TEST_ASSERT_MSG_EQ (trickles->GetPathLoss (0), 0, "A path without losses has no holes");
+        NS_TEST_ASSERT_MSG_EQ (trickles->GetPathLoss (1), 0, "A path without losses has no holes");
+        NS_TEST_ASSERT_MSG_EQ_TOL (sent1/(sent0+sent1), 0.5, 0.1, "Equal paths get equal shares");
+        return;
+    }
+    NS_TEST_ASSERT_MSG_GT (trickles->GetPathLoss (1), trickles->GetPathLoss (0), "Holes are counted on the lossy path");
+    NS_TEST_ASSERT_MSG_LT (trickles->GetPathLoss (1), 3.0/m_dropEvery, "The estimate follows the loss rate of the path");
+    NS_TEST_ASSERT_MSG_LT (trickles->GetPathWeight (1), trickles->GetPathWeight (0), "The lossy path gets a smaller weight");
+    NS_TEST_ASSERT_MSG_LT (sent1, sent0, "The lossy path gets fewer requests");
+}
+
+/*
+ * Group mode: receivers that lost a continuation are repaired by unicast and
+ * keep receiving the stream, their requests in the new epoch are not taken
+ * for repeats of the group requests
+ */
+class TricklesGroupTest : public TricklesSocketTestCase
+{
+public:
+    TricklesGroupTest ();
+private:
+    virtual void DoRun (void);
+    virtual void ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh);
+    std::vector<uint32_t> m_continuations;
+};
+
+TricklesGroupTest::TricklesGroupTest ()
+: TricklesSocketTestCase ("Trickles group receivers recover from losses")
+{
+}
+
+void
+TricklesGroupTest::ClientRx (uint32_t client, const TricklesHeader &th, const TricklesShiehHeader &tsh)
+{
+    m_continuations[client]++;
+}
+
+void
+TricklesGroupTest::DoRun (void)
+{
+    const uint32_t receivers = 3;
+    const uint32_t dropAt = 30;
+    Address group = InetSocketAddress (Ipv4Address ("225.1.2.3"), 50001);
+    TricklesDropProbe::s_dropAt = dropAt;
+    SetupNetwork (receivers, TricklesDropProbe::GetTypeId ());
+    m_continuations.assign (receivers+1, 0);
+    // Continuations of the group leave the server through its only interface
+    Ptr<Ipv4> ipv4 = m_nodes[0]->GetObject<Ipv4> ();
+    int16_t priority;
+    Ptr<Ipv4StaticRouting> routing = DynamicCast<Ipv4StaticRouting> (DynamicCast<Ipv4ListRouting> (ipv4->GetRoutingProtocol ())->GetRoutingProtocol (0, priority));
+    routing->AddNetworkRouteTo (Ipv4Address ("224.0.0.0"), Ipv4Mask ("240.0.0.0"), ipv4->GetInterfaceForAddress (GetAddress (0)));
+    Ptr<TricklesSocketBase> server = DynamicCast<TricklesSocketBase> (CreateServer (50000));
+    NS_TEST_ASSERT_EQUAL (server->SetGroup (group), 0);
+    for (uint32_t i = 1; i<=receivers; i++) {
+        Ptr<Socket> client = CreateClient (i, 50000, 50001);
+        NS_TEST_ASSERT_EQUAL (DynamicCast<TricklesSocketBase> (client)->SetGroup (group), 0);
+        // The last receiver joins the running stream and loses a different trickle
+        Simulator::Schedule (Seconds ((i<receivers)?1:1.2), &TricklesGroupTest::Fetch, this, client, 2000000);
+    }
+    Simulator::Stop (Seconds (20));
+    Simulator::Run ();
+
+    NS_TEST_ASSERT_MSG_GT (server->GetGroupRequests (), 0, "Requests are served to the group");
+    NS_TEST_ASSERT_MSG_GT (server->GetAggregatedRequests (), 0, "Repeated requests of the group are aggregated");
+    NS_TEST_ASSERT_MSG_GT (server->GetRepairRequests (), 0, "Lost continuations are repaired");
+    for (uint32_t i = 1; i<=receivers; i++) {
+        NS_TEST_ASSERT_MSG_GT (m_continuations[i], 10*dropAt, "A repaired receiver keeps receiving the stream");
+        NS_TEST_ASSERT_MSG_GT (m_clientRx[i], 1000000, "A repaired receiver keeps receiving data");
+    }
+}
+
+static class TricklesSocketTestSuite : public TestSuite
+{
+public:
+    TricklesSocketTestSuite ()
+    : TestSuite ("trickles-socket", UNIT)
+    {
+        AddTestCase (new TricklesEcnTest (0, true), TestCase::QUICK);
+        AddTestCase (new TricklesEcnTest (40, true), TestCase::QUICK);
+        AddTestCase (new TricklesEcnTest (40, false), TestCase::QUICK);
+        AddTestCase (new TricklesRequestBudgetTest (), TestCase::QUICK);
+        AddTestCase (new TricklesFetchTest (0), TestCase::QUICK);
+        AddTestCase (new TricklesFetchTest (30), TestCase::QUICK);
+        AddTestCase (new TricklesPathCacheTest (false), TestCase::QUICK);
+        AddTestCase (new TricklesPathCacheTest (true), TestCase::QUICK);
+        AddTestCase (new TricklesFailoverTest (true), TestCase::QUICK);
+        AddTestCase (new TricklesFailoverTest (false), TestCase::QUICK);
+        AddTestCase (new TricklesMultipathTest (0), TestCase::QUICK);
+        AddTestCase (new TricklesMultipathTest (10), TestCase::QUICK);
+        AddTestCase (new TricklesGroupTest (), TestCase::QUICK);
+    }
+} g_tricklesSocketTestSuite;
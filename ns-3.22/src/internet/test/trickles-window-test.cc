@@ -0,0 +1,305 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Dmitry Chalyy <chaly@uniyar.ac.ru>
+ */
+
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/uinteger.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/trickles-header.h"
+#include "ns3/trickles-shieh-header.h"
+#include "ns3/trickles-cubic.h"
+#include "ns3/trickles-ledbat.h"
+#include "ns3/trickles-shieh.h"
+
+using namespace ns3;
+
+#define NS_TEST_ASSERT_EQUAL(a,b) NS_TEST_ASSERT_MSG_EQ (a,b, "foo")
+#define NS_TEST_ASSERT(a) NS_TEST_ASSERT_MSG_EQ (bool(a), true, "foo")
+
+/*
+ * The window laws of the server are protected, the probes make them callable
+ */
+class TricklesCubicProbe : public TricklesCubic
+{
+public:
+    using TricklesCubic::CwndAt;
+    using TricklesCubic::ReduceCwnd;
+};
+
+class TricklesLedbatProbe : public TricklesLedbat
+{
+public:
+    using TricklesLedbat::UpdateEpoch;
+};
+
+class TricklesHyStartProbe : public TricklesShieh
+{
+public:
+    using TricklesShieh::HyStartSample;
+    using TricklesShieh::ReactToHyStart;
+    using TricklesShieh::WindowAt;
+};
+
+class TricklesCubicWindowTest : public TestCase
+{
+public:
+    virtual void DoRun (void);
+    TricklesCubicWindowTest ();
+};
+
+TricklesCubicWindowTest::TricklesCubicWindowTest ()
+: TestCase ("Trickles CUBIC window law")
+{
+}
+
+void
+TricklesCubicWindowTest::DoRun (void)
+{
+    Ptr<TricklesCubicProbe> cubic = CreateObject<TricklesCubicProbe> ();
+    cubic->SetAttribute ("C", DoubleValue (0.4));
+    cubic->SetAttribute ("Beta", DoubleValue (0.7));
+    TricklesHeader th;
+    th.SetRTT (MilliSeconds (30));
+
+    // Wmax=W0=10, RTT=1s: 1100 trickles after the epoch start t=10s and W=0.4*10^3+10
+    TricklesShiehHeader trh;
+    trh.SetTcpBase (SequenceNumber32 (100));
+    trh.SetStartCwnd (10);
+    trh.SetSsthresh (10);
+    trh.SetWMax (10);
+    trh.SetEpochRtt (Seconds (1));
+    NS_TEST_ASSERT_MSG_EQ_TOL (cubic->CwndAt (th, trh, SequenceNumber32 (100+1100)), 410, 1, "W(t) after 1100 trickles");
+    uint16_t last = 0;
+    for (uint32_t k = 100; k<5000; k++) {
+        uint16_t w = cubic->CwndAt (th, trh, SequenceNumber32 (k));
+        NS_TEST_ASSERT_MSG_EQ ((w>=last), true, "The window does not decrease within an epoch");
+        last = w;
+    }
+
+    // W0=70, Wmax=100: the plateau K=cbrt(75) is reached after 100*K-0.1*K^4 ~ 390 trickles
+    trh.SetStartCwnd (70);
+    trh.SetSsthresh (70);
+    trh.SetWMax (100);
+    NS_TEST_ASSERT_MSG_EQ_TOL (cubic->CwndAt (th, trh, SequenceNumber32 (100+390)), 100, 1, "W(K)=Wmax");
+    NS_TEST_ASSERT_MSG_EQ (cubic->CwndAt (th, trh, SequenceNumber32 (100)), 70, "The epoch starts at W0");
+
+    // Without OPT_CUBIC the window does not depend on the RTT sample of the request
+    TricklesShiehHeader fresh;
+    fresh.SetTcpBase (SequenceNumber32 (100));
+    fresh.SetStartCwnd (10);
+    fresh.SetSsthresh (10);
+    TricklesHeader slow;
+    slow.SetRTT (MilliSeconds (300));
+    for (uint32_t k = 100; k<2000; k += 37) {
+        NS_TEST_ASSERT_EQUAL (cubic->CwndAt (th, fresh, SequenceNumber32 (k)), cubic->CwndAt (slow, fresh, SequenceNumber32 (k)));
+    }
+
+    // Multiplicative decrease by Beta, fast convergence lowers Wmax below the loss window
+    TricklesShiehHeader loss;
+    loss.SetTcpBase (SequenceNumber32 (100));
+    loss.SetStartCwnd (10);
+    loss.SetSsthresh (10);
+    cubic->ReduceCwnd (FAST_RETRANSMIT, th, loss, 100);
+    NS_TEST_ASSERT_EQUAL (loss.GetStartCwnd (), 70);
+    NS_TEST_ASSERT_EQUAL (loss.GetSsthresh (), 70);
+    NS_TEST_ASSERT_EQUAL (loss.GetWMax (), 100);
+    loss.SetWMax (200);
+    cubic->ReduceCwnd (FAST_RETRANSMIT, th, loss, 100);
+    NS_TEST_ASSERT_EQUAL (loss.GetWMax (), 85);
+}
+
+class TricklesLedbatTargetTest : public TestCase
+{
+public:
+    virtual void DoRun (void);
+    TricklesLedbatTargetTest ();
+private:
+    /**
+     * Window of the next epoch the marker request of an epoch with window 10 starts
+     */
+    uint16_t NextWindow (Ptr<TricklesLedbatProbe> ledbat, Time base, Time rtt, bool ssDone, TricklesShiehHeader &trh);
+};
+
+TricklesLedbatTargetTest::TricklesLedbatTargetTest ()
+: TestCase ("Trickles LEDBAT response to the queuing delay")
+{
+}
+
+uint16_t
+TricklesLedbatTargetTest::NextWindow (Ptr<TricklesLedbatProbe> ledbat, Time base, Time rtt, bool ssDone, TricklesShiehHeader &trh)
+{
+    trh = TricklesShiehHeader ();
+    trh.SetTcpBase (SequenceNumber32 (100));
+    trh.SetStartCwnd (10);
+    trh.SetSsthresh (10);
+    trh.SetBaseRtt (base);
+    trh.SetSlowStartDone (ssDone);
+    // Request 109 is the first one a window after tcpBase, it emits continuations from 119
+    TricklesHeader th;
+    th.SetTrickleNumber (SequenceNumber32 (119));
+    th.SetRTT (rtt);
+    ledbat->UpdateEpoch (th, trh, SequenceNumber32 (109));
+    // The helper returns a value, so the checks must not return on failure
+    NS_TEST_EXPECT_MSG_EQ (trh.HasOption (TricklesShiehHeader::OPT_REBASE), true, "The marker request starts a new epoch");
+    NS_TEST_EXPECT_MSG_EQ (trh.GetTcpBase (), SequenceNumber32 (119), "The epoch starts at the first continuation");
+    NS_TEST_EXPECT_MSG_EQ (trh.GetStartCwnd (), 10, "The window at the epoch start is kept");
+    return (trh.GetSsthresh ());
+}
+
+void
+TricklesLedbatTargetTest::DoRun (void)
+{
+    Ptr<TricklesLedbatProbe> ledbat = CreateObject<TricklesLedbatProbe> ();
+    TricklesShiehHeader trh;
+
+    // Sub-millisecond path: base RTT 200us, target 1ms
+    ledbat->SetAttribute ("Target", TimeValue (MilliSeconds (1)));
+    NS_TEST_ASSERT_MSG_EQ (NextWindow (ledbat, MicroSeconds (200), MicroSeconds (700), true, trh), 11, "Queuing delay below the target grows the window");
+    NS_TEST_ASSERT_EQUAL (trh.GetBaseRtt (), MicroSeconds (200));
+    NS_TEST_ASSERT_MSG_EQ (NextWindow (ledbat, MicroSeconds (200), MicroSeconds (1500), true, trh), 9, "Queuing delay above the target shrinks the window");
+    NextWindow (ledbat, MicroSeconds (200), MicroSeconds (150), true, trh);
+    NS_TEST_ASSERT_MSG_EQ (trh.GetBaseRtt (), MicroSeconds (150), "A smaller RTT becomes the base RTT");
+
+    // Default target of 25ms
+    ledbat->SetAttribute ("Target", TimeValue (MilliSeconds (25)));
+    NS_TEST_ASSERT_EQUAL (NextWindow (ledbat, MilliSeconds (40), MilliSeconds (45), true, trh), 11);
+    NS_TEST_ASSERT_EQUAL (NextWindow (ledbat, MilliSeconds (40), MilliSeconds (90), true, trh), 9);
+    NS_TEST_ASSERT_MSG_EQ (NextWindow (ledbat, MilliSeconds (40), MilliSeconds (500), true, trh), 5, "The window at most halves per epoch");
+
+    // Slow start doubles the window until the queuing delay reaches 3/4 of the target
+    NS_TEST_ASSERT_EQUAL (NextWindow (ledbat, MilliSeconds (40), MilliSeconds (41), false, trh), 20);
+    NS_TEST_ASSERT_EQUAL (trh.IsSlowStartDone (), false);
+    NS_TEST_ASSERT_EQUAL (NextWindow (ledbat, MilliSeconds (40), MilliSeconds (60), false, trh), 11);
+    NS_TEST_ASSERT_EQUAL (trh.IsSlowStartDone (), true);
+}
+
+class TricklesHyStartTest : public TestCase
+{
+public:
+    virtual void DoRun (void);
+    TricklesHyStartTest ();
+private:
+    /**
+     * Feed continuation trickle (sent by request parent, RTT sample rtt) of a slow
+     * start epoch to the client, returns the window of the exit request or 0
+     */
+    uint16_t Sample (Ptr<TricklesHyStartProbe> shieh, uint32_t trickle, uint32_t parent, Time rtt);
+    void TrainSample (Ptr<TricklesHyStartProbe> shieh, uint32_t trickle);
+    Time m_trainExit;
+    uint16_t m_trainCwnd;
+};
+
+TricklesHyStartTest::TricklesHyStartTest ()
+: TestCase ("Trickles HyStart slow start exit")
+{
+}
+
+uint16_t
+TricklesHyStartTest::Sample (Ptr<TricklesHyStartProbe> shieh, uint32_t trickle, uint32_t parent, Time rtt)
+{
+    TricklesHeader th;
+    th.SetTrickleNumber (trickle);
+    th.SetParentNumber (parent);
+    th.SetRTT (rtt);
+    TricklesShiehHeader trh;
+    trh.SetTcpBase (SequenceNumber32 (100));
+    trh.SetStartCwnd (2);
+    trh.SetSsthresh (1000);
+    shieh->HyStartSample (th, trh);
+    return (trh.HasOption (TricklesShiehHeader::OPT_HYSTART)?trh.GetHyStartCwnd ():0);
+}
+
+void
+TricklesHyStartTest::TrainSample (Ptr<TricklesHyStartProbe> shieh, uint32_t trickle)
+{
+    // After the exit the client waits for the server, which needs the RTT estimator of a connected socket
+    if (m_trainCwnd) return;
+    m_trainCwnd = Sample (shieh, trickle, 110, MilliSeconds (20));
+    if (m_trainCwnd) m_trainExit = Simulator::Now ();
+}
+
+void
+TricklesHyStartTest::DoRun (void)
+{
+    BooleanValue enabled;
+    CreateObject<TricklesShieh> ()->GetAttribute ("HyStart", enabled);
+    NS_TEST_ASSERT_MSG_EQ (enabled.Get (), false, "HyStart is off by default");
+
+    // Delay increase: the first round sees 20ms, the second one 30ms > 20ms+4ms
+    Ptr<TricklesHyStartProbe> shieh = CreateObject<TricklesHyStartProbe> ();
+    for (uint32_t i = 0; i<8; i++) {
+        NS_TEST_ASSERT_MSG_EQ (Sample (shieh, 120+i, 110+i, MilliSeconds (20)), 0, "No exit without a delay increase");
+    }
+    for (uint32_t i = 0; i<7; i++) {
+        NS_TEST_ASSERT_MSG_EQ (Sample (shieh, 130+i, 120+i, MilliSeconds (30)), 0, "The round has too few samples");
+    }
+    // Slow start window at trickle 137 is 2+(137-100)
+    NS_TEST_ASSERT_MSG_EQ (Sample (shieh, 137, 127, MilliSeconds (30)), 39, "Exit at the window of the delay increase");
+
+    // Below HyStartLowWindow the increase is ignored
+    shieh = CreateObject<TricklesHyStartProbe> ();
+    shieh->SetAttribute ("HyStartLowWindow", UintegerValue (40));
+    for (uint32_t i = 0; i<8; i++) Sample (shieh, 120+i, 110+i, MilliSeconds (20));
+    for (uint32_t i = 0; i<8; i++) {
+        NS_TEST_ASSERT_MSG_EQ (Sample (shieh, 130+i, 120+i, MilliSeconds (30)), 0, "HyStart below the low window");
+    }
+
+    // Ack train: continuations 1ms apart for half of the minimal RTT of 20ms
+    shieh = CreateObject<TricklesHyStartProbe> ();
+    m_trainCwnd = 0;
+    for (uint32_t i = 0; i<20; i++) {
+        Simulator::Schedule (MilliSeconds (i), &TricklesHyStartTest::TrainSample, this, shieh, 120+i);
+    }
+    Simulator::Run ();
+    Simulator::Destroy ();
+    NS_TEST_ASSERT_MSG_EQ (m_trainExit, MilliSeconds (10), "Exit after an ack train of minRTT/2");
+    NS_TEST_ASSERT_EQUAL (m_trainCwnd, 2+130-100);
+
+    // The server ends slow start at the reported window and drains from the current one
+    TricklesHeader th;
+    th.SetTrickleNumber (160);
+    TricklesShiehHeader trh;
+    trh.SetTcpBase (SequenceNumber32 (100));
+    trh.SetStartCwnd (2);
+    trh.SetSsthresh (1000);
+    shieh->ReactToHyStart (th, trh, 48);
+    NS_TEST_ASSERT_EQUAL (trh.GetStartCwnd (), 48);
+    NS_TEST_ASSERT_EQUAL (trh.GetSsthresh (), 48);
+    NS_TEST_ASSERT_EQUAL (trh.GetTcpBase (), SequenceNumber32 (160));
+    NS_TEST_ASSERT_MSG_EQ (trh.HasOption (TricklesShiehHeader::OPT_DRAIN), true, "The window shrinks gradually");
+    NS_TEST_ASSERT_EQUAL (trh.GetDrainFrom (), 2+159-100);
+    NS_TEST_ASSERT_EQUAL (shieh->WindowAt (th, trh, SequenceNumber32 (160)), 61);
+    NS_TEST_ASSERT_EQUAL (shieh->WindowAt (th, trh, SequenceNumber32 (200)), 48);
+}
+
+static class TricklesWindowTestSuite : public TestSuite
+{
+public:
+    TricklesWindowTestSuite ()
+    : TestSuite ("trickles-window", UNIT)
+    {
+        AddTestCase (new TricklesCubicWindowTest (), TestCase::QUICK);
+        AddTestCase (new TricklesLedbatTargetTest (), TestCase::QUICK);
+        AddTestCase (new TricklesHyStartTest (), TestCase::QUICK);
+    }
+} g_tricklesWindowTestSuite;
@@ -0,0 +1,91 @@
+#! /usr/bin/env python
+# -*- Mode: python; py-indent-offset: 4; indent-tabs-mode: nil; coding: utf-8; -*-
+#
+# Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""Decode a Trickles event log written by TricklesEventLog::Dump.
+
+Prints one line per record, or CSV with --csv. The records of all nodes
+are merged in time order unless --node selects one node.
+
+Example:
+
+  ./waf --run "trickles-p2p --events=events.bin"
+  utils/trickles-events.py events.bin --node 1 | tail -100
+"""
+
+import optparse
+import struct
+import sys
+
+# Layout of struct TricklesEvent (src/internet/model/trickles-event-log.h)
+RECORD = struct.Struct('<qIIIIHHHBB')
+TYPES = {1: 'INCOMING', 2: 'STATE'}
+PACKET_TYPES = {0: 'REQUEST', 1: 'CONTINUATION'}
+RECOVERY = {0: 'NO_RECOVERY', 1: 'FAST_RETRANSMIT', 2: 'RTO_TIMEOUT'}
+
+
+def read_log(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'TREV':
+        sys.exit('%s is not a Trickles event log' % path)
+    version, size = struct.unpack_from('<II', data, 4)
+    if version != 1 or size != RECORD.size:
+        sys.exit('Unsupported event log version %d (record size %d)' % (version, size))
+    pos = 12
+    events = []
+    while pos + 8 <= len(data):
+        node, count = struct.unpack_from('<II', data, pos)
+        pos += 8
+        for _ in range(count):
+            events.append((node,) + RECORD.unpack_from(data, pos))
+            pos += size
+    return events
+
+
+def describe(e):
+    node, time, trickle, parent, base, size, cwnd, ssthresh, blocks, etype, flags = e
+    head = '%.9f node %d %s' % (time * 1e-9, node, TYPES.get(etype, etype))
+    if etype == 1:
+        return '%s %s trickle %d parent %d base %d cwnd %d ssthresh %d request %d sack blocks %d %s' % (
+            head, PACKET_TYPES.get(flags >> 4, flags >> 4), trickle, parent, base, cwnd, ssthresh, size,
+            blocks, RECOVERY.get(flags & 0xf, flags & 0xf))
+    return '%s base %d cwnd %d ssthresh %d first trickle %d sack blocks %d requested %d timeouts %d' % (
+        head, base, cwnd, ssthresh, parent, blocks, size, flags)
+
+
+def main(argv):
+    parser = optparse.OptionParser(usage='%prog [options] LOG', description=__doc__.split('\n\n')[0])
+    parser.add_option('--node', type='int', default=None, help='only records of this node')
+    parser.add_option('--csv', action='store_true', default=False, help='print CSV')
+    options, args = parser.parse_args(argv)
+    if len(args) != 1:
+        parser.error('one log file expected')
+    events = [e for e in read_log(args[0]) if options.node is None or e[0] == options.node]
+    events.sort(key=lambda e: e[1])
+    if options.csv:
+        print('node,time,type,trickle,parent,tcp_base,size,cwnd,ssthresh,sack_blocks,flags')
+    for e in events:
+        if options.csv:
+            print('%d,%.9f,%s,%d,%d,%d,%d,%d,%d,%d,%d' % ((e[0], e[1] * 1e-9, TYPES.get(e[9], e[9])) + e[2:9] + (e[10],)))
+        else:
+            print(describe(e))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,243 @@
+#! /usr/bin/env python
+# -*- Mode: python; py-indent-offset: 4; indent-tabs-mode: nil; coding: utf-8; -*-
+#
+# Copyright (c) 2014 P.G. Demidov Yaroslavl State University
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""Parallel parameter sweep over a scratch program.
+
+Every point of the grid is run once per seed (RngRun) as a separate
+process, up to --jobs at a time. The metrics a run prints as
+"Name: number ..." lines are appended to <out>/runs.jsonl as soon as the
+run ends, so an interrupted sweep continues where it stopped when started
+again with the same --out. <out>/summary.csv has the mean, the standard
+deviation and the 95% confidence interval of every metric over the seeds
+of each point.
+
+Example:
+
+  ./waf build
+  utils/trickles-sweep.py --program trickles-p2p --seeds 10 --out sweep \\
+      --param bandwidth=1Mbps,10Mbps --param delay=20,200 \\
+      --param protocol=trickles,newreno --fixed duration=60
+
+The grid may also be given as a JSON file with --grid:
+  {"bandwidth": ["1Mbps", "10Mbps"], "delay": [20, 200]}
+"""
+
+import glob
+import itertools
+import json
+import math
+import optparse
+import os
+import re
+import subprocess
+import sys
+import threading
+
+try:
+    import queue
+except ImportError:
+    import Queue as queue
+
+# Two-sided 95% Student t quantiles for 1..30 degrees of freedom
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+       2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+       2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+METRIC = re.compile(r'^\s*([A-Za-z][A-Za-z0-9 ()/_.-]*?)\s*:\s*([-+]?[0-9]*\.?[0-9]+(?:[eE][-+]?[0-9]+)?)')
+
+
+def find_binary(top, program):
+    candidates = glob.glob(os.path.join(top, 'build', 'scratch', '*%s*' % program))
+    candidates = [c for c in candidates if os.access(c, os.X_OK) and not os.path.isdir(c)]
+    exact = [c for c in candidates if os.path.basename(c) == program]
+    if exact:
+        return exact[0]
+    if len(candidates) == 1:
+        return candidates[0]
+    sys.exit('Cannot find the binary of %s in build/scratch; run ./waf build or use --binary' % program)
+
+
+def point_key(point, seed):
+    return ' '.join('--%s=%s' % (k, point[k]) for k in sorted(point)) + ' --RngRun=%d' % seed
+
+
+def parse_metrics(output):
+    metrics = {}
+    for line in output.splitlines():
+        m = METRIC.match(line)
+        if m:
+            name = re.sub(r'[^A-Za-z0-9]+', '_', m.group(1)).strip('_').lower()
+            metrics[name] = float(m.group(2))
+    return metrics
+
+
+def ci95(values):
+    n = len(values)
+    mean = sum(values) / n
+    if n < 2:
+        return mean, 0.0, 0.0
+    sd = math.sqrt(sum((v - mean) ** 2 for v in values) / (n - 1))
+    t = T95[n - 2] if n - 1 <= len(T95) else 1.96
+    return mean, sd, t * sd / math.sqrt(n)
+
+
+def run_worker(binary, top, out, keep, tasks, results, lock, env):
+    while True:
+        try:
+            point, seed = tasks.get_nowait()
+        except queue.Empty:
+            return
+        key = point_key(point, seed)
+        rundir = os.path.join(out, 'runs', re.sub(r'[^A-Za-z0-9=.,-]+', '_', key.replace('--', '')).strip('_'))
+        if not os.path.isdir(rundir):
+            os.makedirs(rundir)
+        args = [binary] + key.split(' ')
+        proc = subprocess.Popen(args, cwd=rundir, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        output = proc.communicate()[0].decode('utf-8', 'replace')
+        with open(os.path.join(rundir, 'stdout.txt'), 'w') as f:
+            f.write(output)
+        if not keep:
+            for name in os.listdir(rundir):
+                if name != 'stdout.txt':
+                    os.remove(os.path.join(rundir, name))
+        record = {'point': point, 'seed': seed, 'status': proc.returncode, 'metrics': parse_metrics(output)}
+        with lock:
+            # Writing the record marks the run as done
+            if proc.returncode == 0:
+                results.write(json.dumps(record, sort_keys=True) + '\n')
+                results.flush()
+            done = run_worker.done = getattr(run_worker, 'done', 0) + 1
+            sys.stdout.write('[%d/%d] %s%s\n' % (done, run_worker.total, key,
+                                                 '' if proc.returncode == 0 else ' FAILED (%d)' % proc.returncode))
+            sys.stdout.flush()
+        tasks.task_done()
+
+
+def summarize(out, params):
+    points = {}
+    with open(os.path.join(out, 'runs.jsonl')) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            record = json.loads(line)
+            key = tuple(str(record['point'][p]) for p in params)
+            points.setdefault(key, {})
+            for name, value in record['metrics'].items():
+                points[key].setdefault(name, []).append(value)
+    metrics = sorted(set(name for p in points.values() for name in p))
+    with open(os.path.join(out, 'summary.csv'), 'w') as f:
+        header = list(params) + ['seeds']
+        for name in metrics:
+            header += [name + '_mean', name + '_sd', name + '_ci95']
+        f.write(','.join(header) + '\n')
+        for key in sorted(points):
+            values = points[key]
+            row = list(key) + [str(max(len(v) for v in values.values()) if values else 0)]
+            for name in metrics:
+                if name in values:
+                    row += ['%.6g' % x for x in ci95(values[name])]
+                else:
+                    row += ['', '', '']
+            f.write(','.join(row) + '\n')
+
+
+def main(argv):
+    parser = optparse.OptionParser(usage='%prog [options]', description=__doc__.split('\n\n')[0])
+    parser.add_option('--program', default='trickles-p2p', help='scratch program to run')
+    parser.add_option('--binary', default=None, help='path to the program binary (found in build/scratch by default)')
+    parser.add_option('--param', action='append', default=[], help='name=v1,v2,... grid dimension (repeatable)')
+    parser.add_option('--grid', default=None, help='JSON file with the grid {"name": [values]}')
+    parser.add_option('--fixed', action='append', default=[], help='name=value passed to every run (repeatable)')
+    parser.add_option('--seeds', type='int', default=5, help='number of RngRun values per point')
+    parser.add_option('--first-seed', type='int', default=1, help='first RngRun value')
+    parser.add_option('--jobs', type='int', default=None, help='concurrent runs (number of cores by default)')
+    parser.add_option('--out', default='sweep', help='output directory; reused to resume')
+    parser.add_option('--keep', action='store_true', default=False, help='keep the files written by every run')
+    options, args = parser.parse_args(argv)
+
+    top = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    binary = os.path.abspath(options.binary) if options.binary else find_binary(top, options.program)
+
+    grid = {}
+    if options.grid:
+        with open(options.grid) as f:
+            grid.update(json.load(f))
+    for p in options.param:
+        name, values = p.split('=', 1)
+        grid[name] = values.split(',')
+    for p in options.fixed:
+        name, value = p.split('=', 1)
+        grid[name] = [value]
+    params = sorted(grid)
+
+    out = os.path.abspath(options.out)
+    if not os.path.isdir(out):
+        os.makedirs(out)
+    done = set()
+    runs = os.path.join(out, 'runs.jsonl')
+    if os.path.exists(runs):
+        with open(runs) as f:
+            for line in f:
+                line = line.strip()
+                if line:
+                    record = json.loads(line)
+                    done.add(point_key(record['point'], record['seed']))
+
+    tasks = queue.Queue()
+    total = 0
+    for values in itertools.product(*[grid[p] for p in params]):
+        point = dict(zip(params, [str(v) for v in values]))
+        for seed in range(options.first_seed, options.first_seed + options.seeds):
+            if point_key(point, seed) not in done:
+                tasks.put((point, seed))
+                total += 1
+    print('%d runs to do, %d already done' % (total, len(done)))
+    run_worker.total = total
+
+    env = dict(os.environ)
+    libdirs = [os.path.join(top, 'build'), os.path.join(top, 'build', 'lib')]
+    env['LD_LIBRARY_PATH'] = os.pathsep.join(libdirs + [env.get('LD_LIBRARY_PATH', '')])
+    env['DYLD_LIBRARY_PATH'] = env['LD_LIBRARY_PATH']
+
+    jobs = options.jobs
+    if not jobs:
+        import multiprocessing
+        jobs = multiprocessing.cpu_count()
+    lock = threading.Lock()
+    with open(runs, 'a') as results:
+        threads = [threading.Thread(target=run_worker, args=(binary, top, out, options.keep, tasks, results, lock, env))
+                   for _ in range(min(jobs, max(total, 1)))]
+        for t in threads:
+            t.daemon = True
+            t.start()
+        try:
+            while any(t.is_alive() for t in threads):
+                for t in threads:
+                    t.join(0.5)
+        except KeyboardInterrupt:
+            print('Interrupted; finished runs are kept in %s' % runs)
+            return 1
+
+    summarize(out, params)
+    print('Summary written to %s' % os.path.join(out, 'summary.csv'))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))